@@ -13,7 +13,6 @@
 
 using namespace raytracer;
 using namespace std;
-#define MAXBOUNDTIME 10
 #define MAXNUMSHAPE 2000000
 #define MAXNUMTEXTURE 20
 #define MAXNUMMODELS 20
@@ -35,11 +34,11 @@ void check_cuda(cudaError_t result, char const* const func, const char* const fi
 }
 
 
-__device__ Point3f Color(const Ray& r, Shape** world, curandState* local_rand_state) {
+__device__ Point3f Color(const Ray& r, Shape** world, curandState* local_rand_state, const PathTermination& termination) {
     Ray cur_ray = r;
     Point3f cur_attenuation = Point3f(1.0f, 1.0f, 1.0f);
     Point3f cur_emitted = Point3f(0.0f, 0.0f, 0.0f);
-    for (int i = 0; i < MAXBOUNDTIME; i++) {
+    for (int i = 0; i < termination.maxDepth; i++) {
         HitRecord rec;
 
         if ((*world)->Hit(cur_ray, rec)) {
@@ -55,6 +54,9 @@ __device__ Point3f Color(const Ray& r, Shape** world, curandState* local_rand_st
                 cur_attenuation = cur_attenuation * attenuation + emitted;
                 cur_emitted = Point3f(emitted);
                 cur_ray = scattered;
+                Float survival = termination.Survive(i + 1, cur_attenuation, local_rand_state);
+                if (survival == 0) return Point3f(0.0, 0.0, 0.0); // 被轮盘赌结束，和超过最大深度一样
+                cur_attenuation /= survival;
                 // return cur_attenuation;
             }
             else {
@@ -82,7 +84,7 @@ __global__ void render_init(int max_x, int max_y, curandState* rand_state) {
 }
 
 
-__global__ void render(Point3f* fb, int max_x, int max_y, int ns, Camera** cam, Shape** world, curandState* rand_state) {
+__global__ void render(Point3f* fb, int max_x, int max_y, int ns, Camera** cam, Shape** world, curandState* rand_state, PathTermination termination) {
     int i = threadIdx.x + blockIdx.x * blockDim.x;
     int j = threadIdx.y + blockIdx.y * blockDim.y;
     if ((i >= max_x) || (j >= max_y)) return;
@@ -94,7 +96,7 @@ __global__ void render(Point3f* fb, int max_x, int max_y, int ns, Camera** cam,
         Float v = Float(/*max_y -*/ j /*- 1*/ + curand_uniform(&local_rand_state)) / Float(max_y);
         Ray ray = (*cam)->GenerateRay(u, v, &local_rand_state);
         //printf("GetColor。。。\n");
-        color += Color(ray, world, &local_rand_state);
+        color += Color(ray, world, &local_rand_state, termination);
 
         //printf("GetColor done\n");
     }
@@ -141,8 +143,6 @@ int main() {
     // make our world of hitables
     Shape** d_list;
     checkCudaErrors(cudaMalloc((void**)&d_list, MAXNUMSHAPE * sizeof(Shape*)));
-    Shape** d_nodes;
-    checkCudaErrors(cudaMalloc((void**)&d_nodes, MAXNUMSHAPE * sizeof(Shape*)));
     Shape** d_world;
     checkCudaErrors(cudaMalloc((void**)&d_world, sizeof(Shape*)));
     Camera** d_camera;
@@ -196,8 +196,9 @@ int main() {
 
 
     /*--------------------------更换自己的场景--------------------------*/
-    ModelScene << <1, 1 >> > (d_list, d_nodes, d_world, d_camera, nx, ny, d_rand_state2, devicePitchedPointer, d_triangleMeshs, modelId);
-    //RTNWScene2 << <1, 1 >> > (d_list, d_nodes, d_world, d_camera, nx, ny, d_rand_state2, devicePitchedPointer);
+    ModelScene << <1, 1 >> > (d_list, d_world, d_camera, nx, ny, d_rand_state2, devicePitchedPointer, d_triangleMeshs, modelId);
+    //ModelInstancesScene << <1, 1 >> > (d_list, d_world, d_camera, nx, ny, d_rand_state2, devicePitchedPointer, d_triangleMeshs, modelId);
+    //RTNWScene2 << <1, 1 >> > (d_list, d_world, d_camera, nx, ny, d_rand_state2, devicePitchedPointer);
     //SampleScene<<<1, 1>>>(d_list, d_world, d_camera, nx, ny, d_rand_state2);
     // create_world << <1, 1 >> > (d_list, d_world, d_camera, nx, ny);
     /*------------------------------end--------------------------------*/
@@ -205,58 +206,95 @@ int main() {
     checkCudaErrors(cudaGetLastError());
     checkCudaErrors(cudaDeviceSynchronize());
 
+    // 在主机端构建 BVH
+    BVHBuildOptions bvhOptions;
+    //bvhOptions.splitMethod = BVHSplitMethod::LBVH; // 百万级三角形的模型用 LBVH 缩短启动时间
+    //bvhOptions.treeletPasses = 2;
+    //bvhOptions.splitMethod = BVHSplitMethod::SBVH; // 建筑、扫描模型里细长的斜三角形多时用空间划分，引用数量受 spatialSplitBudget 限制
+    //bvhOptions.motionBlur = true; // 有快速运动的 DSphere 时，节点包围盒按光线时间插值，快门区间与相机一致
+    //bvhOptions.cacheDirectory = "."; // 模型和构建参数不变时，之后启动直接映射读取上次的 BVH，目录需已存在
+    //bvhOptions.compressNodes = true; // 显存紧张的大场景用 16 字节的量化节点，节点显存减半，遍历稍慢
+    SceneBVH sceneBVH;
+    sceneBVH.Build(d_world, bvhOptions);
+    checkCudaErrors(cudaGetLastError());
+    checkCudaErrors(cudaDeviceSynchronize());
+
+    // 路径的最大深度和轮盘赌设置，封闭、间接光多的场景可以打开轮盘赌并调大最大深度
+    PathTermination termination;
+    //termination.russianRoulette = true;
+    //termination.maxDepth = 32;
+
+    // 转台动画：numFrames 大于 1 时，每帧先在设备端把 d_list 里的实例转动 degreesPerFrame 度，
+    // 再调用 sceneBVH.Refit() 只重算包围盒，SAH 代价退化超过 bvhOptions.rebuildThreshold 倍时才完整重建
+    int numFrames = 1;
+    Float degreesPerFrame = 6.0f;
+    int firstInstance = 2, numInstances = 1; // ModelScene 的模型实例；ModelInstancesScene 为 2、64
+
     clock_t start, stop;
-    start = clock();
-    // Render our buffer
     dim3 blocks(nx / tx + 1, ny / ty + 1);
     dim3 threads(tx, ty);
     render_init << <blocks, threads >> > (nx, ny, d_rand_state);
     checkCudaErrors(cudaGetLastError());
     checkCudaErrors(cudaDeviceSynchronize());
-    render << <blocks, threads >> > (fb, nx, ny, ns, d_camera, d_world, d_rand_state);
-    checkCudaErrors(cudaGetLastError());
-    checkCudaErrors(cudaDeviceSynchronize());
-    stop = clock();
-    double timer_seconds = ((double)(stop - start)) / CLOCKS_PER_SEC;
-    std::cerr << "took " << timer_seconds << " seconds.\n";
-    auto* data = (unsigned char*)malloc(nx * ny * 3);
-    Float hdr_max = 1.f;
+    for (int frame = 0; frame < numFrames; frame++) {
+        if (frame > 0) {
+            RotateInstances << <1, 1 >> > (d_list, firstInstance, numInstances, degreesPerFrame);
+            checkCudaErrors(cudaGetLastError());
+            checkCudaErrors(cudaDeviceSynchronize());
+            sceneBVH.Refit();
+            checkCudaErrors(cudaGetLastError());
+            checkCudaErrors(cudaDeviceSynchronize());
+        }
+        start = clock();
+        // Render our buffer
+        render << <blocks, threads >> > (fb, nx, ny, ns, d_camera, d_world, d_rand_state, termination);
+        checkCudaErrors(cudaGetLastError());
+        checkCudaErrors(cudaDeviceSynchronize());
+        stop = clock();
+        double timer_seconds = ((double)(stop - start)) / CLOCKS_PER_SEC;
+        std::cerr << "took " << timer_seconds << " seconds.\n";
+        auto* data = (unsigned char*)malloc(nx * ny * 3);
+        Float hdr_max = 1.f;
 #ifdef HDR
-    for (int j = ny - 1; j >= 0; j--) {
-        for (int i = 0; i < nx; i++) {
-            size_t pixel_index = j * nx + i;
-            hdr_max = Max(Max(Max(fb[pixel_index].x, fb[pixel_index].y), fb[pixel_index].z), hdr_max);
+        for (int j = ny - 1; j >= 0; j--) {
+            for (int i = 0; i < nx; i++) {
+                size_t pixel_index = j * nx + i;
+                hdr_max = Max(Max(Max(fb[pixel_index].x, fb[pixel_index].y), fb[pixel_index].z), hdr_max);
+            }
         }
-    }
-    printf("hdr_max:%f\n", hdr_max);
-    hdr_max = 1.f / hdr_max;
+        printf("hdr_max:%f\n", hdr_max);
+        hdr_max = 1.f / hdr_max;
 #endif // HDR
 
-    for (int j = ny - 1; j >= 0; j--) {
-        for (int i = 0; i < nx; i++) {
-            size_t pixel_index = j * nx + i;
-            fb[pixel_index] *= hdr_max;
-            fb[pixel_index] = Point3f(pow(fb[pixel_index].x, Gamma), pow(fb[pixel_index].y, Gamma), pow(fb[pixel_index].z, Gamma)); // gamma矫正
-            Float max_axis = Max(fb[pixel_index].z, Max(fb[pixel_index].x, fb[pixel_index].y));
-            fb[pixel_index] = fb[pixel_index] / (max_axis > 1 ? max_axis : 1); // gamma矫正
-            int ir = int(255.99 * fb[pixel_index].x) % 257;
-            int ig = int(255.99 * fb[pixel_index].y) % 257;
-            int ib = int(255.99 * fb[pixel_index].z) % 257;
-            size_t shadingPoint = ((ny - j - 1) * nx + i) * 3;
-            data[shadingPoint + 0] = ir;
-            data[shadingPoint + 1] = ig;
-            data[shadingPoint + 2] = ib;
+        for (int j = ny - 1; j >= 0; j--) {
+            for (int i = 0; i < nx; i++) {
+                size_t pixel_index = j * nx + i;
+                fb[pixel_index] *= hdr_max;
+                fb[pixel_index] = Point3f(pow(fb[pixel_index].x, Gamma), pow(fb[pixel_index].y, Gamma), pow(fb[pixel_index].z, Gamma)); // gamma矫正
+                Float max_axis = Max(fb[pixel_index].z, Max(fb[pixel_index].x, fb[pixel_index].y));
+                fb[pixel_index] = fb[pixel_index] / (max_axis > 1 ? max_axis : 1); // gamma矫正
+                int ir = int(255.99 * fb[pixel_index].x) % 257;
+                int ig = int(255.99 * fb[pixel_index].y) % 257;
+                int ib = int(255.99 * fb[pixel_index].z) % 257;
+                size_t shadingPoint = ((ny - j - 1) * nx + i) * 3;
+                data[shadingPoint + 0] = ir;
+                data[shadingPoint + 1] = ig;
+                data[shadingPoint + 2] = ib;
+            }
         }
+        // 写入图像
+        char filename[64];
+        if (numFrames == 1) sprintf(filename, "./output/CustomAdd/test.png");
+        else sprintf(filename, "./output/CustomAdd/frame_%03d.png", frame);
+        raytracer::stbi_write_png(filename, nx, ny, 3, data, 0);
+        raytracer::stbi_image_free(data);
     }
-    // 写入图像
-    raytracer::stbi_write_png("./output/CustomAdd/test.png", nx, ny, 3, data, 0);
-    raytracer::stbi_image_free(data);
 
     // clean up
     checkCudaErrors(cudaGetLastError());;
     checkCudaErrors(cudaDeviceSynchronize());
     free_world_bvh << <1, 1 >> > (d_list, d_world, d_camera);
-    checkCudaErrors(cudaFree(d_nodes));
+    sceneBVH.Free();
     checkCudaErrors(cudaFree(d_camera));
     checkCudaErrors(cudaFree(d_world));
     checkCudaErrors(cudaFree(d_rand_state));
@@ -0,0 +1,4 @@
+#include "bvh_benchmark.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
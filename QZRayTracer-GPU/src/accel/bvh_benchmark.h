@@ -0,0 +1,607 @@
+#ifndef QZRT_ACCEL_BVH_BENCHMARK_H
+#define QZRT_ACCEL_BVH_BENCHMARK_H
+
+#include <chrono>
+#include <random>
+#include "linear_bvh.h"
+#include "compressed_bvh.h"
+#include "triangle_block.h"
+
+namespace raytracer {
+	/// <summary>
+	/// ׼õĹߣӳΧڵλó򷢳̶ӱ֤ʹͬһ
+	/// </summary>
+	inline std::vector<Ray> GenerateBenchmarkRays(const std::vector<Bounds3f>& primBounds, int nRays) {
+		Bounds3f sceneBounds;
+		for (const Bounds3f& b : primBounds) sceneBounds = Union(sceneBounds, b);
+
+		std::vector<Ray> rays(nRays);
+		std::mt19937 rng(2022);
+		std::uniform_real_distribution<Float> uniform(0, 1);
+		Vector3f diagonal = sceneBounds.Diagonal();
+		for (Ray& ray : rays) {
+			Float u0 = uniform(rng), u1 = uniform(rng), u2 = uniform(rng);
+			Point3f o = sceneBounds.pMin + Vector3f(u0 * diagonal.x, u1 * diagonal.y, u2 * diagonal.z);
+			Float z = 1 - 2 * uniform(rng);
+			Float r = std::sqrt(std::max(Float(0), 1 - z * z));
+			Float phi = Float(6.28318530717958647692) * uniform(rng); // Pi  __device__ ˲
+			ray = Ray(o, Vector3f(r * std::cos(phi), r * std::sin(phi), z));
+		}
+		return rays;
+	}
+
+	/// <summary>
+	/// ͼԪΧдͼԪ̵߳׷йߣػеĹ
+	/// </summary>
+	inline int TraceBenchmarkRays(const LinearBVHNode* nodes, const std::vector<int>& primitiveIndices,
+		const std::vector<Bounds3f>& primBounds, const std::vector<Ray>& rays, int numThreads) {
+		std::vector<int> hits(numThreads, 0);
+		ParallelForChunks(int64_t(rays.size()), numThreads, [&](int64_t begin, int64_t end, int thread) {
+			for (int64_t i = begin; i < end; i++) {
+				const Ray& ray = rays[i];
+				bool hit = IntersectLinearBVH(nodes, ray, [&](int first, int count, Float& tMax) {
+					bool hitLeaf = false;
+					for (int slot = first; slot < first + count; slot++) {
+						Float t0, t1;
+						if (primBounds[primitiveIndices[slot]].IntersectP(ray, &t0, &t1) && t0 > 0 && t0 < tMax) {
+							tMax = t0;
+							hitLeaf = true;
+						}
+					}
+					return hitLeaf;
+				});
+				if (hit) hits[thread]++;
+			}
+		});
+		int total = 0;
+		for (int h : hits) total += h;
+		return total;
+	}
+
+	/// <summary>
+	/// ˱Ƚϸֹʽʱ䡢SAH ۣԼͼԪΧдͼԪʱıʱ
+	/// </summary>
+	inline void BenchmarkBVHBuilders(const std::vector<Bounds3f>& primBounds, int nRays = 1 << 20, int numThreads = 0) {
+		if (primBounds.empty()) return;
+		if (numThreads <= 0) numThreads = NumSystemCores();
+		std::vector<Ray> rays = GenerateBenchmarkRays(primBounds, nRays);
+
+		struct Config {
+			const char* name;
+			BVHBuildOptions options;
+		};
+		std::vector<Config> configs(5);
+		configs[0].name = "median";
+		configs[0].options.splitMethod = BVHSplitMethod::Median;
+		configs[0].options.maxPrimsInNode = 2;
+		configs[1].name = "SAH";
+		configs[2].name = "LBVH-30";
+		configs[2].options.splitMethod = BVHSplitMethod::LBVH;
+		configs[2].options.mortonBits = 30;
+		configs[3].name = "LBVH-63";
+		configs[3].options.splitMethod = BVHSplitMethod::LBVH;
+		configs[4].name = "LBVH-63+treelet";
+		configs[4].options.splitMethod = BVHSplitMethod::LBVH;
+		configs[4].options.treeletPasses = 2;
+
+		printf("BVH benchmark: %d primitives, %d rays, %d threads\n", int(primBounds.size()), nRays, numThreads);
+		printf("%-16s %10s %10s %10s %10s %12s\n", "builder", "build ms", "SAH cost", "nodes", "depth", "trace ms");
+		for (Config& config : configs) {
+			config.options.numThreads = numThreads;
+			LinearBVH bvh;
+			auto start = std::chrono::steady_clock::now();
+			bvh.Build(primBounds, config.options);
+			auto built = std::chrono::steady_clock::now();
+
+			TraceBenchmarkRays(bvh.nodes.data(), bvh.primitiveIndices, primBounds, rays, numThreads);
+			auto traced = std::chrono::steady_clock::now();
+			printf("%-16s %10.1f %10.2f %10d %10d %12.1f\n", config.name,
+				std::chrono::duration<double, std::milli>(built - start).count(), bvh.SAHCost(), bvh.NumNodes(), bvh.maxDepth,
+				std::chrono::duration<double, std::milli>(traced - built).count());
+		}
+	}
+
+	/// <summary>
+	/// ˵Ĺ󽻣Moller-Trumboreֻڻ׼ԣʱع߲ t
+	/// </summary>
+	inline bool IntersectBenchmarkTriangle(const BVHTriangle& triangle, const Ray& ray, Float& t) {
+		Vector3f e1 = triangle.p1 - triangle.p0, e2 = triangle.p2 - triangle.p0;
+		Vector3f p = Cross(ray.d, e2);
+		Float det = Dot(e1, p);
+		if (std::abs(det) < 1e-12f) return false;
+		Float invDet = 1 / det;
+		Vector3f s = ray.o - triangle.p0;
+		Float u = Dot(s, p) * invDet;
+		if (u < 0 || u > 1) return false;
+		Vector3f q = Cross(s, e1);
+		Float v = Dot(ray.d, q) * invDet;
+		if (v < 0 || u + v > 1) return false;
+		t = Dot(e2, q) * invDet;
+		return t > 0;
+	}
+
+	/// <summary>
+	/// ȽϰĻֵ SAH  SBVHʱ䡢SAH ۣԼʱÿߵͼԪԴٶȡ
+	/// εͼԪðΧд档ҵӦȫһ
+	/// </summary>
+	inline void BenchmarkSpatialSplits(const std::vector<Bounds3f>& primBounds, const std::vector<BVHTriangle>& triangles,
+		const BVHBuildOptions& options, int nRays = 1 << 20, int numThreads = 0) {
+		if (primBounds.empty() || triangles.size() != primBounds.size()) return;
+		if (numThreads <= 0) numThreads = NumSystemCores();
+		std::vector<Ray> rays = GenerateBenchmarkRays(primBounds, nRays);
+
+		printf("SBVH benchmark: %d primitives, %d rays, %d threads\n", int(primBounds.size()), nRays, numThreads);
+		printf("%-8s %10s %12s %10s %10s %12s %10s %10s\n", "builder", "build ms", "references", "nodes", "SAH cost", "tests/ray", "Mrays/s", "hits");
+		for (BVHSplitMethod method : { BVHSplitMethod::SAH, BVHSplitMethod::SBVH }) {
+			BVHBuildOptions buildOptions = options;
+			buildOptions.splitMethod = method;
+			buildOptions.numThreads = numThreads;
+			LinearBVH bvh;
+			auto start = std::chrono::steady_clock::now();
+			bvh.Build(primBounds, buildOptions, &triangles);
+			auto built = std::chrono::steady_clock::now();
+
+			std::vector<int64_t> tests(numThreads, 0);
+			std::vector<int> hits(numThreads, 0);
+			ParallelForChunks(nRays, numThreads, [&](int64_t begin, int64_t end, int thread) {
+				for (int64_t i = begin; i < end; i++) {
+					const Ray& ray = rays[i];
+					bool hit = IntersectLinearBVH(bvh.nodes.data(), ray, [&](int first, int count, Float& tMax) {
+						bool hitLeaf = false;
+						tests[thread] += count;
+						for (int slot = first; slot < first + count; slot++) {
+							int index = bvh.primitiveIndices[slot];
+							Float t0, t1;
+							bool hitPrim = triangles[index].isTriangle ? IntersectBenchmarkTriangle(triangles[index], ray, t0)
+								: primBounds[index].IntersectP(ray, &t0, &t1) && t0 > 0;
+							if (hitPrim && t0 < tMax) {
+								tMax = t0;
+								hitLeaf = true;
+							}
+						}
+						return hitLeaf;
+					});
+					if (hit) hits[thread]++;
+				}
+			});
+			auto traced = std::chrono::steady_clock::now();
+			int64_t totalTests = 0;
+			int totalHits = 0;
+			for (int thread = 0; thread < numThreads; thread++) {
+				totalTests += tests[thread];
+				totalHits += hits[thread];
+			}
+			printf("%-8s %10.1f %12d %10d %10.2f %12.2f %10.2f %10d\n", method == BVHSplitMethod::SBVH ? "SBVH" : "SAH",
+				std::chrono::duration<double, std::milli>(built - start).count(), int(bvh.primitiveIndices.size()), bvh.NumNodes(),
+				bvh.SAHCost(), double(totalTests) / nRays, nRays / std::chrono::duration<double>(traced - built).count() * 1e-6, totalHits);
+		}
+	}
+
+	/// <summary>
+	/// LRU 滻ĻģֻͣͳȱʧȽϽڵ㲼ֶԻӰ
+	/// </summary>
+	class CacheSimulator {
+	public:
+		CacheSimulator(int cacheBytes, int lineBytes, int ways)
+			: lineBytes(lineBytes), ways(ways), numSets(std::max(1, cacheBytes / (lineBytes * ways))),
+			tags(size_t(numSets) * ways, ~uint64_t(0)), misses(0), accesses(0) {}
+
+		void Access(uint64_t address, int bytes) {
+			for (uint64_t line = address / lineBytes; line <= (address + bytes - 1) / lineBytes; line++) {
+				accesses++;
+				// ÿڰʹõ˳УеƵǰȱʧʱһ
+				uint64_t* set = &tags[size_t(line % numSets) * ways];
+				int way = 0;
+				while (way < ways && set[way] != line) way++;
+				if (way == ways) {
+					misses++;
+					way = ways - 1;
+				}
+				for (; way > 0; way--) set[way] = set[way - 1];
+				set[0] = line;
+			}
+		}
+
+		const int lineBytes, ways, numSets;
+		std::vector<uint64_t> tags;
+		int64_t misses, accesses;
+	};
+
+	/// <summary>
+	///  IntersectLinearBVH ˳ÿζȡĽڵַģͣطʵĽڵ
+	/// ڵַ豸˵Ĵŷʽ㣺ڵƫһڵ㣬ֵ֮ܶԶ뵽 64 ֽڡ
+	/// slots Ϊʱڵ i ڵ slots[i] λãģзʽ
+	/// </summary>
+	inline int64_t SimulateNodeAccesses(const LinearBVH& bvh, const std::vector<Bounds3f>& primBounds, const Ray& ray, CacheSimulator& cache,
+		const int* slots = nullptr) {
+		const std::vector<LinearBVHNode>& nodes = bvh.nodes;
+		Ray r = ray;
+		Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+		int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+		int64_t visited = 0;
+		int nodesToVisit[MAXBVHDEPTH];
+		int toVisitOffset = 0, currentNodeIndex = 0;
+		while (true) {
+			const LinearBVHNode& node = nodes[currentNodeIndex];
+			int slot = slots ? slots[currentNodeIndex] : currentNodeIndex + 1;
+			cache.Access(uint64_t(slot) * sizeof(LinearBVHNode), sizeof(LinearBVHNode));
+			visited++;
+			if (node.bounds.IntersectP(r, invDir, dirIsNeg)) {
+				if (node.nPrimitives > 0) {
+					for (int slot = node.primitivesOffset; slot < node.primitivesOffset + node.nPrimitives; slot++) {
+						Float t0, t1;
+						if (primBounds[bvh.primitiveIndices[slot]].IntersectP(r, &t0, &t1) && t0 > 0 && t0 < r.tMax) r.tMax = t0;
+					}
+					if (toVisitOffset == 0) break;
+					currentNodeIndex = nodesToVisit[--toVisitOffset];
+				}
+				else {
+					int nearChild = dirIsNeg[node.axis];
+					nodesToVisit[toVisitOffset++] = node.childOffset + 1 - nearChild;
+					currentNodeIndex = node.childOffset + nearChild;
+				}
+			}
+			else {
+				if (toVisitOffset == 0) break;
+				currentNodeIndex = nodesToVisit[--toVisitOffset];
+			}
+		}
+		return visited;
+	}
+
+	/// <summary>
+	/// Ƚϲͬڵ㲼ֵĻȱʧͱٶȡĽṹȫֻͬǽڵвͬ
+	/// ģǵ߳˳׷ 32KB8 ·64 ֽУӽһ SM  L1 1MB16 ·128 ֽ
+	/// ٶȰ IntersectLinearBVH ߳ʵ⣬ڵں豸һĻ
+	/// һǸĳֵ֮ܶǰĸʽӽڵ㣩ĻȱʧѾָ֧ʽûٶ
+	/// </summary>
+	inline void BenchmarkBVHLayouts(const std::vector<Bounds3f>& primBounds, const BVHBuildOptions& options,
+		int nRays = 1 << 20, int numThreads = 0) {
+		if (primBounds.empty()) return;
+		if (numThreads <= 0) numThreads = NumSystemCores();
+		std::vector<Ray> rays = GenerateBenchmarkRays(primBounds, nRays);
+
+		struct Config {
+			const char* name;
+			BVHNodeLayout layout;
+			int blockBytes;
+		};
+		const Config configs[] = {
+			{ "depth-first", BVHNodeLayout::DepthFirst, 0 },
+			{ "treelet-256B", BVHNodeLayout::Treelet, 256 },
+			{ "treelet-4KB", BVHNodeLayout::Treelet, 4096 },
+			{ "treelet-64KB", BVHNodeLayout::Treelet, 65536 },
+		};
+		printf("BVH layout benchmark: %d primitives, %d rays, %d threads\n", int(primBounds.size()), nRays, numThreads);
+		printf("%-14s %14s %14s %14s %12s\n", "layout", "nodes/ray", "L1 miss/ray", "L2 miss/ray", "Mrays/s");
+		{
+			BVHBuildOptions layoutOptions = options;
+			layoutOptions.numThreads = numThreads;
+			layoutOptions.nodeLayout = BVHNodeLayout::DepthFirst;
+			LinearBVH bvh;
+			bvh.Build(primBounds, layoutOptions);
+			std::vector<int> slots(bvh.NumNodes());
+			std::vector<int> stack(1, 0);
+			int next = 0;
+			while (!stack.empty()) {
+				int i = stack.back();
+				stack.pop_back();
+				slots[i] = next++;
+				if (bvh.nodes[i].nPrimitives > 0) continue;
+				stack.push_back(bvh.nodes[i].childOffset + 1);
+				stack.push_back(bvh.nodes[i].childOffset);
+			}
+			CacheSimulator l1(32 * 1024, 64, 8), l2(1024 * 1024, 128, 16);
+			int64_t visited = 0;
+			for (const Ray& ray : rays) {
+				visited += SimulateNodeAccesses(bvh, primBounds, ray, l1, slots.data());
+				SimulateNodeAccesses(bvh, primBounds, ray, l2, slots.data());
+			}
+			printf("%-14s %14.1f %14.2f %14.2f %12s\n", "single-node", double(visited) / nRays,
+				double(l1.misses) / nRays, double(l2.misses) / nRays, "-");
+		}
+		for (const Config& config : configs) {
+			BVHBuildOptions layoutOptions = options;
+			layoutOptions.numThreads = numThreads;
+			layoutOptions.nodeLayout = config.layout;
+			layoutOptions.layoutBlockBytes = config.blockBytes;
+			LinearBVH bvh;
+			bvh.Build(primBounds, layoutOptions);
+
+			CacheSimulator l1(32 * 1024, 64, 8), l2(1024 * 1024, 128, 16);
+			int64_t visited = 0;
+			for (const Ray& ray : rays) {
+				visited += SimulateNodeAccesses(bvh, primBounds, ray, l1);
+				SimulateNodeAccesses(bvh, primBounds, ray, l2);
+			}
+
+			std::vector<unsigned char> storage(bvh.NodeBytes() + 2 * 64);
+			uintptr_t address = (uintptr_t(storage.data()) + 63) / 64 * 64 + 64 - sizeof(LinearBVHNode);
+			LinearBVHNode* alignedNodes = (LinearBVHNode*)address;
+			memcpy(alignedNodes, bvh.nodes.data(), bvh.NodeBytes());
+			auto start = std::chrono::steady_clock::now();
+			TraceBenchmarkRays(alignedNodes, bvh.primitiveIndices, primBounds, rays, numThreads);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("%-14s %14.1f %14.2f %14.2f %12.2f\n", config.name, double(visited) / nRays,
+				double(l1.misses) / nRays, double(l2.misses) / nRays, nRays / seconds * 1e-6);
+		}
+	}
+
+	/// <summary>
+	/// Ƚд棩 key ӳȡ棩ĺʱ
+	/// ص͹ȫһ¡ļд options.cacheDirectory 
+	/// </summary>
+	inline void BenchmarkBVHCache(const std::vector<Bounds3f>& primBounds, const BVHBuildOptions& options) {
+		if (primBounds.empty() || !options.cacheDirectory) return;
+		using Clock = std::chrono::steady_clock;
+		auto start = Clock::now();
+		uint64_t key = BVHCacheKey(primBounds, options);
+		auto hashed = Clock::now();
+		std::string path = BVHCachePath(options.cacheDirectory, key);
+		LinearBVH built;
+		built.Build(primBounds, options);
+		auto builtTime = Clock::now();
+		if (!built.SaveCache(path, key)) {
+			printf("BVH cache benchmark: cannot write %s\n", path.c_str());
+			return;
+		}
+		auto saved = Clock::now();
+
+		LinearBVH loaded;
+		bool ok = loaded.LoadCache(path, key, options);
+		auto loadedTime = Clock::now();
+		ok = ok && loaded.nodes.size() == built.nodes.size() && loaded.primitiveIndices == built.primitiveIndices &&
+			memcmp(loaded.nodes.data(), built.nodes.data(), built.NodeBytes()) == 0;
+
+		auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+		printf("BVH cache benchmark: %d primitives, %.1f KB file, %s\n", int(primBounds.size()),
+			double(sizeof(BVHCacheHeader) + built.NodeBytes() + built.primitiveIndices.size() * sizeof(int)) / 1024,
+			ok ? "loaded tree matches" : "loaded tree MISMATCH");
+		printf("cold start: key %.1f ms + build %.1f ms + save %.1f ms\n", ms(start, hashed), ms(hashed, builtTime), ms(builtTime, saved));
+		printf("warm start: key %.1f ms + load %.1f ms\n", ms(start, hashed), ms(saved, loadedTime));
+	}
+
+	/// <summary>
+	/// Ƚ 32 ֽڵ LinearBVHNode  16 ֽڵѹڵ㣺ڵڴ桢Χбɴ SAH ۣ
+	/// ÿߵͼԪԴٶȡΧֻ߻еĹӦȫһ
+	/// </summary>
+	inline void BenchmarkCompressedNodes(const std::vector<Bounds3f>& primBounds, const BVHBuildOptions& options,
+		int nRays = 1 << 20, int numThreads = 0) {
+		if (primBounds.empty()) return;
+		if (numThreads <= 0) numThreads = NumSystemCores();
+		std::vector<Ray> rays = GenerateBenchmarkRays(primBounds, nRays);
+		BVHBuildOptions buildOptions = options;
+		buildOptions.numThreads = numThreads;
+		if (buildOptions.splitMethod == BVHSplitMethod::SBVH) buildOptions.splitMethod = BVHSplitMethod::SAH; // ֻаΧ
+		LinearBVH bvh;
+		bvh.Build(primBounds, buildOptions);
+		auto start = std::chrono::steady_clock::now();
+		CompressedBVH compressed;
+		compressed.Compress(bvh);
+		auto compressedTime = std::chrono::steady_clock::now();
+
+		printf("Compressed BVH benchmark: %d primitives, %d rays, %d threads, compressed in %.1f ms\n", int(primBounds.size()), nRays, numThreads,
+			std::chrono::duration<double, std::milli>(compressedTime - start).count());
+		printf("%-12s %10s %10s %10s %12s %10s %10s\n", "nodes", "bytes", "node MB", "SAH cost", "tests/ray", "Mrays/s", "hits");
+		for (bool useCompressed : { false, true }) {
+			std::vector<int64_t> tests(numThreads, 0);
+			std::vector<int> hits(numThreads, 0);
+			auto traceStart = std::chrono::steady_clock::now();
+			ParallelForChunks(nRays, numThreads, [&](int64_t begin, int64_t end, int thread) {
+				for (int64_t i = begin; i < end; i++) {
+					const Ray& ray = rays[i];
+					auto intersect = [&](int first, int count, Float& tMax) {
+						bool hitLeaf = false;
+						tests[thread] += count;
+						for (int slot = first; slot < first + count; slot++) {
+							Float t0, t1;
+							if (primBounds[bvh.primitiveIndices[slot]].IntersectP(ray, &t0, &t1) && t0 > 0 && t0 < tMax) {
+								tMax = t0;
+								hitLeaf = true;
+							}
+						}
+						return hitLeaf;
+					};
+					bool hit = useCompressed ? IntersectCompressedBVH(compressed.nodes.data(), compressed.rootBounds, ray, intersect)
+						: IntersectLinearBVH(bvh.nodes.data(), ray, intersect);
+					if (hit) hits[thread]++;
+				}
+			});
+			auto traced = std::chrono::steady_clock::now();
+			int64_t totalTests = 0;
+			int totalHits = 0;
+			for (int thread = 0; thread < numThreads; thread++) {
+				totalTests += tests[thread];
+				totalHits += hits[thread];
+			}
+			size_t bytes = useCompressed ? compressed.NodeBytes() : bvh.NodeBytes();
+			printf("%-12s %10d %10.2f %10.2f %12.2f %10.2f %10d\n", useCompressed ? "compressed" : "float",
+				useCompressed ? int(sizeof(CompressedBVHNode)) : int(sizeof(LinearBVHNode)), bytes / (1024.0 * 1024.0),
+				bvh.SAHCost() * (useCompressed ? 1 + compressed.SAHCostIncrease(bvh) : 1), double(totalTests) / nRays,
+				nRays / std::chrono::duration<double>(traced - traceStart).count() * 1e-6, totalHits);
+		}
+	}
+
+	/// <summary>
+	/// ȽӰڵѯanyHitٶȡ߸ GenerateBenchmarkRays ͷ
+	/// յȡڳԽ߳ȵ 0.05  0.5 ֮䣬ʹɫԴӰһȷյ㡣
+	/// ͼԪðΧд棬ַʽжΪڵĹӦȫһ
+	/// </summary>
+	inline void BenchmarkOcclusion(const std::vector<Bounds3f>& primBounds, const BVHBuildOptions& options,
+		int nRays = 1 << 20, int numThreads = 0) {
+		if (primBounds.empty()) return;
+		if (numThreads <= 0) numThreads = NumSystemCores();
+		std::vector<Ray> rays = GenerateBenchmarkRays(primBounds, nRays);
+		Bounds3f sceneBounds;
+		for (const Bounds3f& b : primBounds) sceneBounds = Union(sceneBounds, b);
+		Float diagonal = sceneBounds.Diagonal().Length();
+		std::mt19937 rng(2023);
+		std::uniform_real_distribution<Float> uniform(Float(0.05), Float(0.5));
+		for (Ray& ray : rays) ray.tMax = diagonal * uniform(rng); // ǵλtMax ߶γ
+		BVHBuildOptions buildOptions = options;
+		buildOptions.numThreads = numThreads;
+		if (buildOptions.splitMethod == BVHSplitMethod::SBVH) buildOptions.splitMethod = BVHSplitMethod::SAH; // ֻаΧ
+		LinearBVH bvh;
+		bvh.Build(primBounds, buildOptions);
+
+		printf("Occlusion benchmark: %d primitives, %d shadow rays, %d threads\n", int(primBounds.size()), nRays, numThreads);
+		printf("%-12s %12s %10s %10s\n", "query", "tests/ray", "Mrays/s", "occluded");
+		for (bool anyHit : { false, true }) {
+			std::vector<int64_t> tests(numThreads, 0);
+			std::vector<int> occluded(numThreads, 0);
+			auto start = std::chrono::steady_clock::now();
+			ParallelForChunks(nRays, numThreads, [&](int64_t begin, int64_t end, int thread) {
+				for (int64_t i = begin; i < end; i++) {
+					const Ray& ray = rays[i];
+					auto intersect = [&](int first, int count, Float& tMax) {
+						bool hitLeaf = false;
+						for (int slot = first; slot < first + count; slot++) {
+							tests[thread]++;
+							Float t0, t1;
+							if (primBounds[bvh.primitiveIndices[slot]].IntersectP(ray, &t0, &t1) && t0 > 0 && t0 < tMax) {
+								if (anyHit) return true;
+								tMax = t0;
+								hitLeaf = true;
+							}
+						}
+						return hitLeaf;
+					};
+					if (IntersectLinearBVH(bvh.nodes.data(), ray, intersect, nullptr, 0, anyHit)) occluded[thread]++;
+				}
+			});
+			auto traced = std::chrono::steady_clock::now();
+			int64_t totalTests = 0;
+			int totalOccluded = 0;
+			for (int thread = 0; thread < numThreads; thread++) {
+				totalTests += tests[thread];
+				totalOccluded += occluded[thread];
+			}
+			printf("%-12s %12.2f %10.2f %10d\n", anyHit ? "any hit" : "closest hit", double(totalTests) / nRays,
+				nRays / std::chrono::duration<double>(traced - start).count() * 1e-6, totalOccluded);
+		}
+	}
+
+	/// <summary>
+	/// ̵߳׷йߣ¼ÿ tûлΪ󣩣ʱ룩
+	/// intersect(ray, watertight, first, count, tMax) ҶһͼԪ󽻣Լͬ IntersectLinearBVH
+	/// </summary>
+	template <typename Intersector>
+	inline double TraceTriangleBenchmarkRays(const LinearBVH& bvh, const std::vector<Ray>& rays, int numThreads,
+		Intersector intersect, std::vector<Float>& tHits) {
+		tHits.assign(rays.size(), Float(INFINITY));
+		auto start = std::chrono::steady_clock::now();
+		ParallelForChunks(int64_t(rays.size()), numThreads, [&](int64_t begin, int64_t end, int) {
+			for (int64_t i = begin; i < end; i++) {
+				const Ray& ray = rays[i];
+				WatertightRay watertight(ray);
+				Float tHit = tHits[i];
+				IntersectLinearBVH(bvh.nodes.data(), ray, [&](int first, int count, Float& tMax) {
+					if (!intersect(ray, watertight, first, count, tMax)) return false;
+					tHit = tMax;
+					return true;
+				});
+				tHits[i] = tHit;
+			}
+		});
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/// <summary>
+	/// Ƚ󽻺ʹɿ󽻵ٶȡ󽻺豸ԭ Triangle::Intersect һ
+	/// ÿζµλߡᣬͶӰϣÿֻ׼һΣ
+	///  SIMD һԡԼ󽻰ͼԪ󽻰ҶӵĴۡ
+	/// εͼԪðΧд档ַʽҵӦһ
+	/// </summary>
+	inline void BenchmarkTriangleBlocks(const std::vector<Bounds3f>& primBounds, const std::vector<BVHTriangle>& triangles,
+		const BVHBuildOptions& options, int nRays = 1 << 20, int numThreads = 0) {
+		if (primBounds.empty() || triangles.size() != primBounds.size()) return;
+		int numTriangles = 0;
+		for (const BVHTriangle& triangle : triangles) numTriangles += triangle.isTriangle;
+		if (numTriangles == 0) return;
+		if (numThreads <= 0) numThreads = NumSystemCores();
+		std::vector<Ray> rays = GenerateBenchmarkRays(primBounds, nRays);
+		auto buildBVH = [&](LinearBVH& bvh, int leafBatchWidth) {
+			BVHBuildOptions buildOptions = options;
+			buildOptions.numThreads = numThreads;
+			buildOptions.leafBatchWidth = leafBatchWidth;
+			bvh.Build(primBounds, buildOptions, buildOptions.splitMethod == BVHSplitMethod::SBVH ? &triangles : nullptr);
+		};
+		auto intersectBounds = [&](const Ray& ray, int index, Float tMax, Float& t) {
+			Float t0, t1;
+			if (!primBounds[index].IntersectP(ray, &t0, &t1) || t0 <= 0 || t0 >= tMax) return false;
+			t = t0;
+			return true;
+		};
+
+		LinearBVH bvh1;
+		buildBVH(bvh1, 1);
+		std::vector<Float> tSingle;
+		double singleSeconds = TraceTriangleBenchmarkRays(bvh1, rays, numThreads,
+			[&](const Ray& ray, const WatertightRay&, int first, int count, Float& tMax) {
+				bool hitLeaf = false;
+				for (int slot = first; slot < first + count; slot++) {
+					int index = bvh1.primitiveIndices[slot];
+					const BVHTriangle& triangle = triangles[index];
+					Float t;
+					if (triangle.isTriangle) {
+						Float dLength = ray.d.Length();
+						Ray unitRay(ray.o, ray.d / dLength, ray.time, tMax * dLength, ray.tMin);
+						Float tLocal, b[3];
+						if (!IntersectTriangleWatertight(WatertightRay(unitRay), triangle.p0, triangle.p1, triangle.p2, unitRay.tMax, tLocal, b)) continue;
+						Point3f pHit = b[0] * triangle.p0 + b[1] * triangle.p1 + b[2] * triangle.p2;
+						t = Dot(pHit - ray.o, ray.d) / Dot(ray.d, ray.d);
+						if (t >= tMax) continue;
+					}
+					else if (!intersectBounds(ray, index, tMax, t)) {
+						continue;
+					}
+					tMax = t;
+					hitLeaf = true;
+				}
+				return hitLeaf;
+			}, tSingle);
+
+		// ַʽ t 㷨ͬСĲֻǡò߻򶥵Ĺ
+		auto countMismatches = [&](const std::vector<Float>& tHits) {
+			int mismatches = 0;
+			for (int i = 0; i < nRays; i++) {
+				bool hitA = tSingle[i] < INFINITY, hitB = tHits[i] < INFINITY;
+				if (hitA != hitB || (hitA && std::abs(tSingle[i] - tHits[i]) > Float(1e-4) * std::max(Float(1), tSingle[i]))) mismatches++;
+			}
+			return mismatches;
+		};
+		int hits = 0;
+		for (Float t : tSingle) hits += t < INFINITY;
+		printf("Triangle block benchmark: %d triangles, %d other primitives, %d rays, %d threads, %d hits\n", numTriangles,
+			int(primBounds.size()) - numTriangles, nRays, numThreads, hits);
+		printf("%-14s %10s %10s %10s %10s %12s %12s\n", "intersector", "nodes", "blocks", "MB", "Mrays/s", "speedup", "mismatches");
+		printf("%-14s %10d %10s %10s %10.2f %12s %12s\n", "per triangle", bvh1.NumNodes(), "-", "-", nRays / singleSeconds * 1e-6, "1.00x", "-");
+
+		auto benchmarkBlocks = [&](auto& blocks, const char* name) {
+			LinearBVH bvh;
+			buildBVH(bvh, blocks.Width);
+			blocks.Build(bvh, triangles);
+			std::vector<Float> tHits;
+			double seconds = TraceTriangleBenchmarkRays(bvh, rays, numThreads,
+				[&](const Ray& ray, const WatertightRay& watertight, int first, int count, Float& tMax) {
+					const TriangleLeaf& leaf = blocks.leaves[first];
+					bool hitLeaf = IntersectTriangleLeaf(blocks.blocks.data(), leaf, watertight, tMax) >= 0;
+					for (int slot = first + leaf.nTriangles; slot < first + count; slot++) {
+						Float t;
+						if (!intersectBounds(ray, bvh.primitiveIndices[slot], tMax, t)) continue;
+						tMax = t;
+						hitLeaf = true;
+					}
+					return hitLeaf;
+				}, tHits);
+			printf("%-14s %10d %10d %10.2f %10.2f %11.2fx %12d\n", name, bvh.NumNodes(), int(blocks.blocks.size()), blocks.Bytes() / (1024.0 * 1024.0),
+				nRays / seconds * 1e-6, singleSeconds / seconds, countMismatches(tHits));
+		};
+		TriangleBlocks<4> blocks4;
+		TriangleBlocks<8> blocks8;
+		benchmarkBlocks(blocks4, "SoA x4");
+		benchmarkBlocks(blocks8, "SoA x8");
+	}
+}
+
+#endif // QZRT_ACCEL_BVH_BENCHMARK_H
\ No newline at end of file
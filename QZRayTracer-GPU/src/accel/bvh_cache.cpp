@@ -0,0 +1,4 @@
+#include "bvh_cache.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
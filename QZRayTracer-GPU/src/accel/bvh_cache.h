@@ -0,0 +1,248 @@
+#ifndef QZRT_ACCEL_BVH_CACHE_H
+#define QZRT_ACCEL_BVH_CACHE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "linear_bvh.h"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace raytracer {
+	// ļʽİ汾LinearBVHNode ļָıʱһļᱻЧ¹
+#define BVH_CACHE_VERSION 2
+
+	/// <summary>
+	/// ļͷ nodesprimitiveIndices  motionBounds 
+	/// </summary>
+	struct BVHCacheHeader {
+		char magic[8];          // "QZRTBVH"
+		uint32_t version;
+		uint32_t nodeBytes;     // sizeof(LinearBVHNode)Float  double ļͨ
+		uint64_t key;           // ͼԪΧк͹Ĺϣ
+		uint64_t payloadHash;   // ݵĹϣļǷضϻ
+		int32_t numNodes;
+		int32_t numPrimitives;
+		int32_t numMotionBounds;
+		int32_t maxDepth;
+		double builtSAHCost;
+	};
+
+	/// <summary>
+	/// FNV-1a 64 λϣseed һεĽ԰Ѷݴ
+	/// </summary>
+	inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull) {
+		const unsigned char* bytes = (const unsigned char*)data;
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	/// <summary>
+	///  keyͼԪΧУݺͱ任Ӱ״Ĺ֮߳಻ӰĲ롣
+	/// ˶ģٴŹرʱ̵İΧУSBVH ٴڲü
+	/// </summary>
+	inline uint64_t BVHCacheKey(const std::vector<Bounds3f>& primBounds, const BVHBuildOptions& options,
+		const std::vector<Bounds3f>* primBounds1 = nullptr, const std::vector<BVHTriangle>* triangles = nullptr) {
+		uint64_t hash = HashBytes(primBounds.data(), primBounds.size() * sizeof(Bounds3f));
+		if (primBounds1) hash = HashBytes(primBounds1->data(), primBounds1->size() * sizeof(Bounds3f), hash);
+		if (triangles) {
+			// ֶμ㣬ṹĩβֽǲȷ
+			for (const BVHTriangle& triangle : *triangles) {
+				hash = HashBytes(&triangle.p0, 3 * sizeof(Point3f), hash);
+				hash = HashBytes(&triangle.isTriangle, sizeof(bool), hash);
+			}
+		}
+		int splitMethod = int(options.splitMethod);
+		int motionBlur = options.motionBlur ? 1 : 0;
+		hash = HashBytes(&splitMethod, sizeof(int), hash);
+		hash = HashBytes(&options.maxPrimsInNode, sizeof(int), hash);
+		hash = HashBytes(&options.leafBatchWidth, sizeof(int), hash);
+		hash = HashBytes(&options.traversalCost, sizeof(Float), hash);
+		hash = HashBytes(&options.nBuckets, sizeof(int), hash);
+		hash = HashBytes(&options.mortonBits, sizeof(int), hash);
+		hash = HashBytes(&options.treeletPasses, sizeof(int), hash);
+		int nodeLayout = int(options.nodeLayout);
+		hash = HashBytes(&nodeLayout, sizeof(int), hash);
+		hash = HashBytes(&options.layoutBlockBytes, sizeof(int), hash);
+		hash = HashBytes(&options.spatialSplitBudget, sizeof(Float), hash);
+		hash = HashBytes(&options.spatialSplitAlpha, sizeof(Float), hash);
+		hash = HashBytes(&motionBlur, sizeof(int), hash);
+		if (motionBlur) {
+			hash = HashBytes(&options.shutterOpen, sizeof(Float), hash);
+			hash = HashBytes(&options.shutterClose, sizeof(Float), hash);
+		}
+		return hash;
+	}
+
+	/// <summary>
+	/// ļ·Ŀ¼ key ͬһ BLAS Ͷ BVH ռһļ
+	/// </summary>
+	inline std::string BVHCachePath(const char* directory, uint64_t key) {
+		char name[32];
+		snprintf(name, sizeof(name), "bvh_%016llx.bin", (unsigned long long)key);
+		return std::string(directory) + "/" + name;
+	}
+
+	/// <summary>
+	/// ֻذļӳ䵽ڴ棬ʱӳ䡣ֻǰҳ滻Ķ
+	/// </summary>
+	class MappedFile {
+	public:
+		explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) return;
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!mapping) return;
+			data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (data) size = size_t(fileSize.QuadPart);
+#else
+			fd = open(path.c_str(), O_RDONLY);
+			if (fd < 0) return;
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0) return;
+			void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) return;
+			data = p;
+			size = size_t(st.st_size);
+#endif // _WIN32
+		}
+		~MappedFile() {
+#ifdef _WIN32
+			if (data) UnmapViewOfFile(data);
+			if (mapping) CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+			if (data) munmap(data, size);
+			if (fd >= 0) close(fd);
+#endif // _WIN32
+		}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const unsigned char* Data() const { return (const unsigned char*)data; }
+		size_t Size() const { return size; }
+
+	private:
+		void* data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int fd = -1;
+#endif // _WIN32
+	};
+
+	inline bool LinearBVH::SaveCache(const std::string& path, uint64_t key) const {
+		BVHCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, "QZRTBVH", 8);
+		header.version = BVH_CACHE_VERSION;
+		header.nodeBytes = sizeof(LinearBVHNode);
+		header.key = key;
+		header.numNodes = NumNodes();
+		header.numPrimitives = int(primitiveIndices.size());
+		header.numMotionBounds = int(motionBounds.size());
+		header.maxDepth = maxDepth;
+		header.builtSAHCost = builtSAHCost;
+		uint64_t hash = HashBytes(nodes.data(), NodeBytes());
+		hash = HashBytes(primitiveIndices.data(), primitiveIndices.size() * sizeof(int), hash);
+		header.payloadHash = HashBytes(motionBounds.data(), MotionBoundsBytes(), hash);
+
+		// дʱļٸ;˳°
+		std::string tempPath = path + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (!file) return false;
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(nodes.data(), 1, NodeBytes(), file) == NodeBytes() &&
+			fwrite(primitiveIndices.data(), sizeof(int), primitiveIndices.size(), file) == primitiveIndices.size() &&
+			fwrite(motionBounds.data(), 1, MotionBoundsBytes(), file) == MotionBoundsBytes();
+		ok = fclose(file) == 0 && ok;
+		if (ok) {
+			remove(path.c_str());
+			ok = rename(tempPath.c_str(), path.c_str()) == 0;
+		}
+		if (!ok) remove(tempPath.c_str());
+		return ok;
+	}
+
+	inline bool LinearBVH::LoadCache(const std::string& path, uint64_t key, const BVHBuildOptions& options) {
+		MappedFile file(path);
+		if (file.Size() < sizeof(BVHCacheHeader)) return false;
+		BVHCacheHeader header;
+		memcpy(&header, file.Data(), sizeof(header));
+		if (memcmp(header.magic, "QZRTBVH", 8) != 0 || header.version != BVH_CACHE_VERSION ||
+			header.nodeBytes != sizeof(LinearBVHNode) || header.key != key) {
+			return false;
+		}
+		if (header.numNodes <= 0 || header.numPrimitives < 0 ||
+			(header.numMotionBounds != 0 && header.numMotionBounds != header.numNodes)) {
+			return false;
+		}
+		size_t nodeBytes = size_t(header.numNodes) * sizeof(LinearBVHNode);
+		size_t indexBytes = size_t(header.numPrimitives) * sizeof(int);
+		size_t motionBytes = size_t(header.numMotionBounds) * sizeof(LinearBVHMotionBounds);
+		if (file.Size() != sizeof(header) + nodeBytes + indexBytes + motionBytes) return false;
+
+		const unsigned char* payload = file.Data() + sizeof(header);
+		uint64_t hash = HashBytes(payload, nodeBytes);
+		hash = HashBytes(payload + nodeBytes, indexBytes, hash);
+		hash = HashBytes(payload + nodeBytes + indexBytes, motionBytes, hash);
+		if (hash != header.payloadHash) return false;
+
+		nodes.resize(header.numNodes);
+		primitiveIndices.resize(header.numPrimitives);
+		motionBounds.resize(header.numMotionBounds);
+		memcpy(nodes.data(), payload, nodeBytes);
+		memcpy(primitiveIndices.data(), payload + nodeBytes, indexBytes);
+		memcpy(motionBounds.data(), payload + nodeBytes + indexBytes, motionBytes);
+
+		// ±Խ豸˻ֱӷԽ磬ټһ飬ͨͶ
+		bool valid = true;
+		for (int i = 0; i < header.numNodes && valid; i++) {
+			const LinearBVHNode& node = nodes[i];
+			if (node.nPrimitives > 0) {
+				valid = node.primitivesOffset >= 0 && node.primitivesOffset + node.nPrimitives <= header.numPrimitives;
+			}
+			else {
+				valid = node.childOffset > i && node.childOffset + 1 < header.numNodes;
+			}
+		}
+		for (int i = 0; i < header.numPrimitives && valid; i++) {
+			valid = primitiveIndices[i] >= 0 && primitiveIndices[i] < header.numPrimitives;
+		}
+		if (!valid) {
+			nodes.clear();
+			primitiveIndices.clear();
+			motionBounds.clear();
+			return false;
+		}
+
+		this->options = options;
+		this->options.motionBlur = header.numMotionBounds > 0;
+		maxDepth = header.maxDepth;
+		builtSAHCost = Float(header.builtSAHCost);
+		return true;
+	}
+}
+
+#endif // QZRT_ACCEL_BVH_CACHE_H
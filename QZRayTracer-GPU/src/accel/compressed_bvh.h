@@ -0,0 +1,240 @@
+#ifndef QZRT_ACCEL_COMPRESSED_BVH_H
+#define QZRT_ACCEL_COMPRESSED_BVH_H
+
+#include <cmath>
+#include <limits>
+#include "linear_bvh.h"
+
+namespace raytracer {
+	/// <summary>
+	/// 8 λ q  [lo, hi] Ӧֵ0  255  lo  hi
+	/// 豸˽ֹѳ˼Ӻϲ fma֤˱ʱĽλͬϵƫ
+	/// </summary>
+	__host__ __device__ inline Float DecodeBVHCoordinate(int q, Float lo, Float hi) {
+		if (q == 255) return hi;
+#ifdef __CUDA_ARCH__
+#ifdef PBRT_FLOAT_AS_DOUBLE
+		return __dadd_rn(lo, __dmul_rn(Float(q), __dmul_rn(hi - lo, Float(1.0 / 255))));
+#else
+		return __fadd_rn(lo, __fmul_rn(Float(q), __fmul_rn(hi - lo, Float(1.0 / 255))));
+#endif // PBRT_FLOAT_AS_DOUBLE
+#else
+		return lo + Float(q) * ((hi - lo) * Float(1.0 / 255));
+#endif // __CUDA_ARCH__
+	}
+
+	/// <summary>
+	/// ѹ BVH ڵ㣬16 ֽڣ LinearBVHNode һ롣Χвٴ 6  float
+	/// ԸڵΧУڵϵ 8 λڵÿȷֳ 255 ݣ
+	/// 0  255 ֱǸڵ pMin  pMax DecodeBVHCoordinateʱ½¡ϽȡİΧǰסԭİΧС
+	/// ȻɶԴţchildOffsetprimitivesOffsetnPrimitivesaxis ĺ LinearBVHNode ͬ
+	/// </summary>
+	struct CompressedBVHNode {
+		uint8_t qMin[3], qMax[3];
+		uint8_t axis;
+		uint8_t pad;
+		union {
+			int primitivesOffset; // Ҷ
+			int childOffset;      // ڲڵ㣬һӵ±
+		};
+		uint16_t nPrimitives;
+		uint16_t pad1;
+
+		/// <summary>
+		/// ڸڵϵ frame ΧУframe ǸڵİΧУڵ CompressedBVH::rootBounds
+		/// </summary>
+		__host__ __device__ inline Bounds3f Decode(const Bounds3f& frame) const {
+			Bounds3f b;
+			for (int i = 0; i < 3; i++) {
+				b.pMin[i] = DecodeBVHCoordinate(qMin[i], frame.pMin[i], frame.pMax[i]);
+				b.pMax[i] = DecodeBVHCoordinate(qMax[i], frame.pMin[i], frame.pMax[i]);
+			}
+			return b;
+		}
+	};
+	static_assert(sizeof(CompressedBVHNode) == 16, "CompressedBVHNode should stay 16 bytes");
+
+	/// <summary>
+	///  LinearBVH ɵѹڵ顣ڵ˳ LinearBVH::nodes ȫһֻǰΧл 8 λ꣬
+	/// 豸ֻҪϴ飬ڵڴ룬ǱʱÿڵҪһν룬ΧɻһЩڵ㡣
+	/// ˵ LinearBVH ԭĽڵ refitrefit ؽ֮ Compress ɣֻһԵı
+	/// ֧˶ģ motionBounds
+	/// </summary>
+	class CompressedBVH {
+	public:
+		void Compress(const LinearBVH& bvh);
+
+		int NumNodes() const { return int(nodes.size()); }
+		size_t NodeBytes() const { return nodes.size() * sizeof(CompressedBVHNode); }
+
+		/// <summary>
+		/// ѹɵİΧбɣнڵ SAH ԭӱ
+		/// </summary>
+		Float SAHCostIncrease(const LinearBVH& bvh) const;
+
+		std::vector<CompressedBVHNode> nodes;
+		Bounds3f rootBounds; // ڵİΧа float ţΪϵ
+	};
+
+	/// <summary>
+	///  v  frame [lo, hi]  8 λꡣdown Ϊ true ʱ vΧ½磩С v
+	/// λͬmargin ֻһ ulp ֹ˱ı㷽ʽ
+	/// scale = 255 / (hi - lo)  margin ɵ߶ÿڵһΣĸ깲
+	/// </summary>
+	inline uint8_t QuantizeBVHCoordinate(Float v, Float lo, Float hi, Float scale, Float margin, bool down) {
+		auto decode = [&](int q) { return DecodeBVHCoordinate(q, lo, hi); };
+		if (down) {
+			if (!(v > lo)) return 0;
+			if (v >= hi) return 255;
+			// Ȱֵȡ𲽵x ǸʱֱӽضϾȡ std::floor 
+			Float x = std::max((v - margin - lo) * scale, Float(0));
+			int q = std::min(int(x), 254);
+			while (q > 0 && decode(q) > v - margin) q--;
+			return uint8_t(q);
+		}
+		if (!(v < hi)) return 255;
+		if (v <= lo) return 0;
+		Float x = std::min((v + margin - lo) * scale, Float(255));
+		int q = std::max(int(x) + (Float(int(x)) < x), 1);
+		while (q < 255 && decode(q) < v + margin) q++;
+		return uint8_t(q);
+	}
+
+	inline void CompressedBVH::Compress(const LinearBVH& bvh) {
+		int numNodes = bvh.NumNodes();
+		nodes.resize(numNodes);
+		if (numNodes == 0) return;
+		rootBounds = bvh.nodes[0].bounds;
+		// ӵ±Ǵڸڵ㣬±˳ʱڵѾãԽİΧΪϵۻ
+		std::vector<Bounds3f> frames(numNodes);
+		frames[0] = rootBounds;
+		for (int i = 0; i < numNodes; i++) {
+			const LinearBVHNode& node = bvh.nodes[i];
+			CompressedBVHNode& compressed = nodes[i];
+			if (i == 0) {
+				for (int axis = 0; axis < 3; axis++) {
+					compressed.qMin[axis] = 0;
+					compressed.qMax[axis] = 255;
+				}
+			}
+			compressed.axis = node.axis;
+			compressed.pad = 0;
+			compressed.primitivesOffset = node.primitivesOffset;
+			compressed.nPrimitives = node.nPrimitives;
+			compressed.pad1 = 0;
+			if (node.nPrimitives > 0) continue;
+			const Bounds3f& frame = frames[i];
+			for (int axis = 0; axis < 3; axis++) {
+				Float lo = frame.pMin[axis], hi = frame.pMax[axis];
+				Float scale = hi > lo ? 255 / (hi - lo) : 0;
+				Float margin = std::numeric_limits<Float>::epsilon() * std::max(std::abs(lo), std::abs(hi));
+				for (int child = node.childOffset; child < node.childOffset + 2; child++) {
+					const Bounds3f& b = bvh.nodes[child].bounds;
+					nodes[child].qMin[axis] = QuantizeBVHCoordinate(b.pMin[axis], lo, hi, scale, margin, true);
+					nodes[child].qMax[axis] = QuantizeBVHCoordinate(b.pMax[axis], lo, hi, scale, margin, false);
+				}
+			}
+			frames[node.childOffset] = nodes[node.childOffset].Decode(frame);
+			frames[node.childOffset + 1] = nodes[node.childOffset + 1].Decode(frame);
+		}
+	}
+
+	inline Float CompressedBVH::SAHCostIncrease(const LinearBVH& bvh) const {
+		if (nodes.empty()) return 0;
+		std::vector<Bounds3f> frames(nodes.size());
+		frames[0] = rootBounds;
+		double original = 0, compressed = 0;
+		for (size_t i = 0; i < nodes.size(); i++) {
+			const CompressedBVHNode& node = nodes[i];
+			// ֻЧͼԪҶӰΧǿյģpMin > pMaxû
+			const Bounds3f& bounds = bvh.nodes[i].bounds;
+			if (bounds.pMin.x <= bounds.pMax.x) {
+				Float cost = node.nPrimitives > 0 ? bvh.Options().LeafCost(node.nPrimitives) : bvh.Options().traversalCost;
+				original += cost * bounds.SurfaceArea();
+				compressed += cost * frames[i].SurfaceArea();
+			}
+			if (node.nPrimitives == 0) {
+				frames[node.childOffset] = nodes[node.childOffset].Decode(frames[i]);
+				frames[node.childOffset + 1] = nodes[node.childOffset + 1].Decode(frames[i]);
+			}
+		}
+		return original > 0 ? Float(compressed / original - 1) : 0;
+	}
+
+	/// <summary>
+	/// ѹ BVHintersect Լ IntersectLinearBVH ͬ
+	/// ڲڵһν벢ӣڣͬһ 32 ֽڵĶʱȷʻϽǸ
+	/// 뺢ҪڵİΧУջԶӵ±İΧУջʱ̺ tMax ²һΡ
+	/// ջ IntersectLinearBVH ÿ 28 ֽڣڵ롣anyHit ͬ IntersectLinearBVH
+	/// </summary>
+#ifdef __CUDACC__
+#pragma nv_exec_check_disable
+#endif // __CUDACC__
+	template <typename Intersector>
+	__host__ __device__ inline bool IntersectCompressedBVH(const CompressedBVHNode* nodes, const Bounds3f& rootBounds,
+		const Ray& ray, Intersector intersect, bool anyHit = false) {
+		Ray r = ray;
+		Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+		int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+		if (!rootBounds.IntersectP(r, invDir, dirIsNeg)) return false;
+		bool hitAnything = false;
+		int nodesToVisit[MAXBVHDEPTH];
+		Float boundsToVisit[MAXBVHDEPTH][6]; // ԶӽİΧС Bounds3f 飬ÿ߶Ҫȹջ
+		int toVisitOffset = 0, currentNodeIndex = 0;
+		Bounds3f currentBounds = rootBounds;
+		while (true) {
+			const CompressedBVHNode& node = nodes[currentNodeIndex];
+			bool descend = false;
+			if (node.nPrimitives > 0) {
+				if (intersect(node.primitivesOffset, node.nPrimitives, r.tMax)) {
+					hitAnything = true;
+					if (anyHit) break;
+				}
+			}
+			else {
+				int nearChild = dirIsNeg[node.axis];
+				int nearIndex = node.childOffset + nearChild, farIndex = node.childOffset + 1 - nearChild;
+				Bounds3f nearBounds = nodes[nearIndex].Decode(currentBounds);
+				Bounds3f farBounds = nodes[farIndex].Decode(currentBounds);
+				bool hitNear = nearBounds.IntersectP(r, invDir, dirIsNeg);
+				bool hitFar = farBounds.IntersectP(r, invDir, dirIsNeg);
+				if (hitNear) {
+					if (hitFar) {
+						Float* pushed = boundsToVisit[toVisitOffset];
+						for (int axis = 0; axis < 3; axis++) {
+							pushed[axis] = farBounds.pMin[axis];
+							pushed[axis + 3] = farBounds.pMax[axis];
+						}
+						nodesToVisit[toVisitOffset++] = farIndex;
+					}
+					currentNodeIndex = nearIndex;
+					currentBounds = nearBounds;
+					descend = true;
+				}
+				else if (hitFar) {
+					currentNodeIndex = farIndex;
+					currentBounds = farBounds;
+					descend = true;
+				}
+			}
+			if (descend) continue;
+			// ջѹջ֮ҵĽѾ޳
+			bool found = false;
+			while (toVisitOffset > 0 && !found) {
+				const Float* popped = boundsToVisit[--toVisitOffset];
+				for (int axis = 0; axis < 3; axis++) {
+					currentBounds.pMin[axis] = popped[axis];
+					currentBounds.pMax[axis] = popped[axis + 3];
+				}
+				if (currentBounds.IntersectP(r, invDir, dirIsNeg)) {
+					currentNodeIndex = nodesToVisit[toVisitOffset];
+					found = true;
+				}
+			}
+			if (!found) break;
+		}
+		return hitAnything;
+	}
+}
+
+#endif // QZRT_ACCEL_COMPRESSED_BVH_H
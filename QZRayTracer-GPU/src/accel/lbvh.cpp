@@ -0,0 +1,4 @@
+#include "lbvh.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
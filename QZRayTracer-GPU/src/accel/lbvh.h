@@ -0,0 +1,410 @@
+#ifndef QZRT_ACCEL_LBVH_H
+#define QZRT_ACCEL_LBVH_H
+
+#include <functional>
+#include <future>
+#include <memory>
+#include "linear_bvh.h"
+#include "parallel.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+namespace raytracer {
+	/// <summary>
+	///  21 λıչÿλ֮ճλڽά Morton 
+	/// </summary>
+	inline uint64_t LeftShift3(uint64_t x) {
+		x &= 0x1fffff;
+		x = (x | x << 32) & 0x1f00000000ffff;
+		x = (x | x << 16) & 0x1f0000ff0000ff;
+		x = (x | x << 8) & 0x100f00f00f00f00f;
+		x = (x | x << 4) & 0x10c30c30c30c30c3;
+		x = (x | x << 2) & 0x1249249249249249;
+		return x;
+	}
+
+	/// <summary>
+	///  21 λ Morton 룬ÿ 10 λʱõ 30 λ21 λʱõ 63 λ
+	/// </summary>
+	inline uint64_t EncodeMorton3(uint32_t x, uint32_t y, uint32_t z) {
+		return (LeftShift3(z) << 2) | (LeftShift3(y) << 1) | LeftShift3(x);
+	}
+
+	inline int CountLeadingZeros64(uint64_t x) {
+#ifdef _MSC_VER
+		unsigned long index;
+		return _BitScanReverse64(&index, x) ? 63 - int(index) : 64;
+#else
+		return x == 0 ? 64 : __builtin_clzll(x);
+#endif // _MSC_VER
+	}
+
+	struct MortonPrimitive {
+		uint64_t mortonCode;
+		int primitiveIndex;
+	};
+
+	/// <summary>
+	///  mortonCode ĵ bits λ LSD ÿ 8 λ
+	/// ÿ߳ͳԼһεֱͼٰ (Ͱ, ߳) ˳ǰ׺ͺַȶ
+	/// </summary>
+	inline void RadixSort(std::vector<MortonPrimitive>& v, int bits, int numThreads) {
+		const int bitsPerPass = 8;
+		const int nBuckets = 1 << bitsPerPass;
+		const int nPasses = (bits + bitsPerPass - 1) / bitsPerPass;
+		const int64_t n = int64_t(v.size());
+		numThreads = int(std::max<int64_t>(1, std::min<int64_t>(numThreads, n)));
+		std::vector<MortonPrimitive> tempVector(v.size());
+		std::vector<int64_t> offsets(nBuckets * numThreads);
+		for (int pass = 0; pass < nPasses; pass++) {
+			int lowBit = pass * bitsPerPass;
+			std::vector<MortonPrimitive>& in = (pass & 1) ? tempVector : v;
+			std::vector<MortonPrimitive>& out = (pass & 1) ? v : tempVector;
+			std::fill(offsets.begin(), offsets.end(), 0);
+			ParallelForChunks(n, numThreads, [&](int64_t begin, int64_t end, int thread) {
+				int64_t* count = &offsets[thread * nBuckets];
+				for (int64_t i = begin; i < end; i++) {
+					count[(in[i].mortonCode >> lowBit) & (nBuckets - 1)]++;
+				}
+			});
+			int64_t sum = 0;
+			for (int bucket = 0; bucket < nBuckets; bucket++) {
+				for (int thread = 0; thread < numThreads; thread++) {
+					int64_t count = offsets[thread * nBuckets + bucket];
+					offsets[thread * nBuckets + bucket] = sum;
+					sum += count;
+				}
+			}
+			ParallelForChunks(n, numThreads, [&](int64_t begin, int64_t end, int thread) {
+				int64_t* offset = &offsets[thread * nBuckets];
+				for (int64_t i = begin; i < end; i++) {
+					out[offset[(in[i].mortonCode >> lowBit) & (nBuckets - 1)]++] = in[i];
+				}
+			});
+		}
+		if (nPasses & 1) v.swap(tempVector);
+	}
+
+	/// <summary>
+	/// LBVH еĶ Karras ıŷʽڲڵ [0, n - 1)
+	/// Ҷӱ [n - 1, 2n - 1) j ҶӶӦĵ j ͼԪ
+	/// </summary>
+	struct LBVHTree {
+		int numPrimitives;
+		std::vector<int> children[2];   // ֻڲڵк
+		std::vector<int> parent;        // ڵΪ -1
+		std::vector<Bounds3f> bounds;
+		std::vector<int> leafCount;     // ͼԪ
+		std::vector<Float> cost;        //  SAH ۣδԸڵ
+
+		bool IsLeaf(int node) const { return node >= numPrimitives - 1; }
+	};
+
+	/// <summary>
+	/// Treelet ŻKarras & Aila 2013ӽڵչڲڵ㣬
+	/// õ 7 Ҷӵ treeletö̬滮öЩҶӵлַʽ
+	/// ҵ SAH С˺ԭڲڵӡ
+	/// ȴٴԼֵཻϴԲ
+	/// </summary>
+	class TreeletOptimizer {
+	public:
+		TreeletOptimizer(LBVHTree& tree, const BVHBuildOptions& options)
+			: tree(tree), options(options), activeThreads(1) {}
+
+		void Optimize(int node) {
+			if (tree.IsLeaf(node)) return;
+			if (tree.leafCount[node] > options.parallelThreshold && activeThreads.fetch_add(1) < options.numThreads) {
+				auto first = std::async(std::launch::async, [&]() {
+					Optimize(tree.children[0][node]);
+					activeThreads--;
+				});
+				Optimize(tree.children[1][node]);
+				first.get();
+			}
+			else {
+				if (tree.leafCount[node] > options.parallelThreshold) activeThreads--;
+				Optimize(tree.children[0][node]);
+				Optimize(tree.children[1][node]);
+			}
+			OptimizeTreelet(node);
+		}
+
+	private:
+		static const int maxTreeletLeaves = 7;
+
+		void OptimizeTreelet(int root) {
+			int leaves[maxTreeletLeaves];
+			int internals[maxTreeletLeaves - 1];
+			int nLeaves = 2, nInternals = 1;
+			leaves[0] = tree.children[0][root];
+			leaves[1] = tree.children[1][root];
+			internals[0] = root;
+			while (nLeaves < maxTreeletLeaves) {
+				int expand = -1;
+				Float maxArea = -1;
+				for (int i = 0; i < nLeaves; i++) {
+					if (tree.IsLeaf(leaves[i])) continue;
+					Float area = tree.bounds[leaves[i]].SurfaceArea();
+					if (area > maxArea) {
+						maxArea = area;
+						expand = i;
+					}
+				}
+				if (expand < 0) break;
+				int node = leaves[expand];
+				internals[nInternals++] = node;
+				leaves[expand] = tree.children[0][node];
+				leaves[nLeaves++] = tree.children[1][node];
+			}
+			if (nLeaves < 3) return;
+
+			// ÿҶӼİΧСŴۺŻ
+			const int nSubsets = 1 << nLeaves;
+			Bounds3f subsetBounds[1 << maxTreeletLeaves];
+			Float subsetCost[1 << maxTreeletLeaves];
+			int bestPartition[1 << maxTreeletLeaves];
+			for (int s = 1; s < nSubsets; s++) {
+				int low = 0;
+				while (!(s & (1 << low))) low++;
+				int rest = s & (s - 1);
+				subsetBounds[s] = rest ? Union(subsetBounds[rest], tree.bounds[leaves[low]]) : tree.bounds[leaves[low]];
+				if (!rest) {
+					subsetCost[s] = tree.cost[leaves[low]];
+					continue;
+				}
+				// ӼֵСӼһѾֻöٰλһظ
+				Float best = FLT_MAX;
+				int bestP = 0;
+				for (int p = (s - 1) & s; p; p = (p - 1) & s) {
+					if (!(p & (1 << low))) continue;
+					Float c = subsetCost[p] + subsetCost[s ^ p];
+					if (c < best) {
+						best = c;
+						bestP = p;
+					}
+				}
+				subsetCost[s] = options.traversalCost * subsetBounds[s].SurfaceArea() + best;
+				bestPartition[s] = bestP;
+			}
+
+			const int all = nSubsets - 1;
+			if (subsetCost[all] >= tree.cost[root] * (1 - 1e-5f)) return;
+			int nextInternal = 1;
+			Rebuild(all, root, leaves, internals, nextInternal, subsetBounds, subsetCost, bestPartition);
+		}
+
+		void Rebuild(int s, int node, const int* leaves, const int* internals, int& nextInternal,
+			const Bounds3f* subsetBounds, const Float* subsetCost, const int* bestPartition) {
+			int parts[2] = { bestPartition[s], s ^ bestPartition[s] };
+			int count = 0;
+			for (int c = 0; c < 2; c++) {
+				int child;
+				if (!(parts[c] & (parts[c] - 1))) {
+					int index = 0;
+					while (!(parts[c] & (1 << index))) index++;
+					child = leaves[index];
+				}
+				else {
+					child = internals[nextInternal++];
+					Rebuild(parts[c], child, leaves, internals, nextInternal, subsetBounds, subsetCost, bestPartition);
+				}
+				tree.children[c][node] = child;
+				tree.parent[child] = node;
+				count += tree.leafCount[child];
+			}
+			tree.bounds[node] = subsetBounds[s];
+			tree.cost[node] = subsetCost[s];
+			tree.leafCount[node] = count;
+		}
+
+		LBVHTree& tree;
+		const BVHBuildOptions& options;
+		std::atomic<int> activeThreads;
+	};
+
+	inline void LinearBVH::BuildLBVH(std::vector<BVHPrimitiveInfo>& primitiveInfo) {
+		const int n = int(primitiveInfo.size());
+		const int numThreads = options.numThreads;
+
+		// ͼԪĵİΧУ
+		std::vector<Bounds3f> threadBounds(numThreads);
+		ParallelForChunks(n, numThreads, [&](int64_t begin, int64_t end, int thread) {
+			for (int64_t i = begin; i < end; i++) threadBounds[thread] = Union(threadBounds[thread], primitiveInfo[i].centroid);
+		});
+		Bounds3f centroidBounds;
+		for (const Bounds3f& b : threadBounds) centroidBounds = Union(centroidBounds, b);
+
+		const int bitsPerAxis = options.mortonBits > 30 ? 21 : 10;
+		const Float mortonScale = Float(1 << bitsPerAxis);
+		std::vector<MortonPrimitive> mortonPrims(n);
+		ParallelForChunks(n, numThreads, [&](int64_t begin, int64_t end, int thread) {
+			for (int64_t i = begin; i < end; i++) {
+				Vector3f offset = centroidBounds.Offset(primitiveInfo[i].centroid) * mortonScale;
+				uint32_t q[3];
+				for (int axis = 0; axis < 3; axis++) {
+					q[axis] = uint32_t(std::min(std::max(offset[axis], Float(0)), mortonScale - 1));
+				}
+				mortonPrims[i].mortonCode = EncodeMorton3(q[0], q[1], q[2]);
+				mortonPrims[i].primitiveIndex = int(i);
+			}
+		});
+		RadixSort(mortonPrims, 3 * bitsPerAxis, numThreads);
+
+		if (n == 1) {
+			LinearBVHNode leaf;
+			leaf.bounds = primitiveInfo[0].bounds;
+			leaf.primitivesOffset = 0;
+			leaf.nPrimitives = 1;
+			leaf.axis = 0;
+			nodes.push_back(leaf);
+			primitiveIndices.push_back(primitiveInfo[0].primitiveNumber);
+			maxDepth = 1;
+			return;
+		}
+
+		LBVHTree tree;
+		tree.numPrimitives = n;
+		tree.children[0].resize(n - 1);
+		tree.children[1].resize(n - 1);
+		tree.parent.resize(2 * n - 1);
+		tree.bounds.resize(2 * n - 1);
+		tree.leafCount.resize(2 * n - 1);
+		tree.cost.resize(2 * n - 1);
+		tree.parent[0] = -1;
+
+		//  Morton Ĺǰ׺ȣͬʱ±֣֤ÿڲڵ㶼ȷ
+		auto delta = [&](int i, int j) {
+			if (j < 0 || j >= n) return -1;
+			uint64_t a = mortonPrims[i].mortonCode, b = mortonPrims[j].mortonCode;
+			if (a == b) return 64 + CountLeadingZeros64(uint64_t(i ^ j));
+			return CountLeadingZeros64(a ^ b);
+		};
+
+		// ÿڲڵȷԼǵҶͻλãKarras 2012
+		ParallelForChunks(n - 1, numThreads, [&](int64_t begin, int64_t end, int thread) {
+			for (int i = int(begin); i < int(end); i++) {
+				int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+				int deltaMin = delta(i, i - d);
+				int lMax = 2;
+				while (delta(i, i + lMax * d) > deltaMin) lMax *= 2;
+				int l = 0;
+				for (int t = lMax / 2; t >= 1; t /= 2) {
+					if (delta(i, i + (l + t) * d) > deltaMin) l += t;
+				}
+				int j = i + l * d;
+				int deltaNode = delta(i, j);
+				int s = 0, t = l;
+				do {
+					t = (t + 1) >> 1;
+					if (delta(i, i + (s + t) * d) > deltaNode) s += t;
+				} while (t > 1);
+				int gamma = i + s * d + std::min(d, 0);
+				int left = std::min(i, j) == gamma ? (n - 1) + gamma : gamma;
+				int right = std::max(i, j) == gamma + 1 ? (n - 1) + gamma + 1 : gamma + 1;
+				tree.children[0][i] = left;
+				tree.children[1][i] = right;
+				tree.parent[left] = i;
+				tree.parent[right] = i;
+			}
+		});
+
+		// ҶϺϲΧУÿڲڵɵڶ̸߳
+		std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[n - 1]);
+		for (int i = 0; i < n - 1; i++) visits[i] = 0;
+		ParallelForChunks(n, numThreads, [&](int64_t begin, int64_t end, int thread) {
+			for (int64_t j = begin; j < end; j++) {
+				int node = (n - 1) + int(j);
+				tree.bounds[node] = primitiveInfo[mortonPrims[j].primitiveIndex].bounds;
+				tree.leafCount[node] = 1;
+				tree.cost[node] = tree.bounds[node].SurfaceArea();
+				int p = tree.parent[node];
+				while (p >= 0 && visits[p].fetch_add(1, std::memory_order_acq_rel) == 1) {
+					int a = tree.children[0][p], b = tree.children[1][p];
+					tree.bounds[p] = Union(tree.bounds[a], tree.bounds[b]);
+					tree.leafCount[p] = tree.leafCount[a] + tree.leafCount[b];
+					tree.cost[p] = options.traversalCost * tree.bounds[p].SurfaceArea() + tree.cost[a] + tree.cost[b];
+					p = tree.parent[p];
+				}
+			}
+		});
+
+		for (int pass = 0; pass < options.treeletPasses; pass++) {
+			TreeletOptimizer(tree, options).Optimize(0);
+		}
+
+		// չƽԵϰ SAH ЩճһҶӣͼԪҶӴ۲ڻִۣ
+		// ͬʱÿĽڵٲеذдԵλ
+		std::vector<int> subtreeNodes(2 * n - 1);
+		std::function<int(int)> countNodes = [&](int node) {
+			if (tree.IsLeaf(node)) return subtreeNodes[node] = 1;
+			int a = tree.children[0][node], b = tree.children[1][node];
+			int count = 1 + countNodes(a) + countNodes(b);
+			Float area = tree.bounds[node].SurfaceArea();
+			Float splitCost = options.traversalCost * area + tree.cost[a] + tree.cost[b];
+			Float leafCost = options.LeafCost(tree.leafCount[node]) * area;
+			if (tree.leafCount[node] <= options.MaxLeafPrimitives() && leafCost <= splitCost) {
+				tree.cost[node] = leafCost;
+				count = 1;
+			}
+			else {
+				tree.cost[node] = splitCost;
+			}
+			return subtreeNodes[node] = count;
+		};
+		countNodes(0);
+		nodes.resize(subtreeNodes[0]);
+		primitiveIndices.resize(n);
+
+		std::atomic<int> activeThreads(1);
+		std::function<int(int, int, int)> emit = [&](int node, int nodeOffset, int primOffset) {
+			LinearBVHNode& linearNode = nodes[nodeOffset];
+			linearNode.bounds = tree.bounds[node];
+			if (subtreeNodes[node] == 1) {
+				// 㹻С£һҶ
+				int count = 0;
+				std::vector<int> stack(1, node);
+				while (!stack.empty()) {
+					int cur = stack.back();
+					stack.pop_back();
+					if (tree.IsLeaf(cur)) {
+						primitiveIndices[primOffset + count++] = primitiveInfo[mortonPrims[cur - (n - 1)].primitiveIndex].primitiveNumber;
+					}
+					else {
+						stack.push_back(tree.children[1][cur]);
+						stack.push_back(tree.children[0][cur]);
+					}
+				}
+				linearNode.primitivesOffset = primOffset;
+				linearNode.nPrimitives = uint16_t(count);
+				linearNode.axis = 0;
+				return 1;
+			}
+			int a = tree.children[0][node], b = tree.children[1][node];
+			int secondChild = nodeOffset + 1 + subtreeNodes[a];
+			Bounds3f centroids(.5f * tree.bounds[a].pMin + .5f * tree.bounds[a].pMax, .5f * tree.bounds[b].pMin + .5f * tree.bounds[b].pMax);
+			linearNode.childOffset = secondChild;
+			linearNode.nPrimitives = 0;
+			linearNode.axis = uint8_t(centroids.MaximumExtent());
+			int depthA, depthB;
+			if (tree.leafCount[node] > options.parallelThreshold && activeThreads.fetch_add(1) < numThreads) {
+				auto first = std::async(std::launch::async, [&]() {
+					int depth = emit(a, nodeOffset + 1, primOffset);
+					activeThreads--;
+					return depth;
+				});
+				depthB = emit(b, secondChild, primOffset + tree.leafCount[a]);
+				depthA = first.get();
+			}
+			else {
+				if (tree.leafCount[node] > options.parallelThreshold) activeThreads--;
+				depthA = emit(a, nodeOffset + 1, primOffset);
+				depthB = emit(b, secondChild, primOffset + tree.leafCount[a]);
+			}
+			return 1 + std::max(depthA, depthB);
+		};
+		maxDepth = emit(0, 0, 0);
+	}
+}
+
+#endif // QZRT_ACCEL_LBVH_H
@@ -0,0 +1,644 @@
+#ifndef QZRT_ACCEL_LINEAR_BVH_H
+#define QZRT_ACCEL_LINEAR_BVH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../core/QZRayTracer.h"
+#include "../core/geometry.h"
+#include "parallel.h"
+
+namespace raytracer {
+	// ջĴСʱ˻λ
+#define MAXBVHDEPTH 64
+
+	/// <summary>
+	/// չƽ BVH ڵ㡣ڲڵڴţֻҪ¼һӵ±ꣻ
+	/// һڵ 32 ֽڣһֵռһ 64 ֽڵĻУʸڵһȡء
+	/// ӵ±ܱȸڵ󣬽ڵȺ˳ LayoutNodes 
+	/// </summary>
+	struct LinearBVHNode {
+		Bounds3f bounds;
+		union {
+			int primitivesOffset;   // Ҷӽڵ㣺һͼԪλ
+			int childOffset;        // ڲڵ㣺ӵ±꣬Һ childOffset + 1
+		};
+		uint16_t nPrimitives;  // 0 ʾڲڵ
+		uint8_t axis;          // ڲڵĻ
+		uint8_t pad[1];        // 뵽 32 ֽ
+	};
+#ifndef PBRT_FLOAT_AS_DOUBLE
+	static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should be 32 bytes");
+#endif // PBRT_FLOAT_AS_DOUBLE
+
+	/// <summary>
+	/// ˶ģ BVH ÿڵڿſ͹رʱ̵İΧУ LinearBVHNode һһӦ
+	/// ʱߵʱԲֵͼԪ˶ʱֵİΧܰסһʱ̵ӽڵ㣬
+	/// ˶ͼԪٰȽڵʱڶŴ
+	/// </summary>
+	struct LinearBVHMotionBounds {
+		Bounds3f bounds0, bounds1;
+
+		/// <summary>
+		/// time ǿڹһ [0, 1] ʱ䡣ֱӲֵ˵㣬հΧвֵȻǿյ
+		/// </summary>
+		__host__ __device__ Bounds3f At(Float time) const {
+			Bounds3f bounds;
+			bounds.pMin = Lerp(time, bounds0.pMin, bounds1.pMin);
+			bounds.pMax = Lerp(time, bounds0.pMax, bounds1.pMax);
+			return bounds;
+		}
+	};
+
+	/// <summary>
+	/// ʱÿͼԪϢ
+	/// </summary>
+	struct BVHPrimitiveInfo {
+		BVHPrimitiveInfo() {}
+		BVHPrimitiveInfo(int primitiveNumber, const Bounds3f& bounds)
+			: primitiveNumber(primitiveNumber), bounds(bounds), centroid(.5f * bounds.pMin + .5f * bounds.pMax) {}
+		int primitiveNumber;
+		Bounds3f bounds;
+		Point3f centroid;
+	};
+
+	/// <summary>
+	/// ʱڵ㣬ɸڵУչƽڵһͷš
+	/// Ҷֱ primitiveInfo  [firstPrimOffset, firstPrimOffset + nPrimitives) һΣ
+	/// ֮以صԿԲй
+	/// </summary>
+	struct BVHBuildNode {
+		Bounds3f bounds;
+		std::unique_ptr<BVHBuildNode> children[2];
+		int splitAxis = 0, firstPrimOffset = 0, nPrimitives = 0;
+		std::vector<int> primitives; // SBVH Ҷӹʱ֪ԼλãȼõͼԪ
+	};
+
+	/// <summary>
+	/// SBVH üͼԪʱõļΣռ䣨BVH ڿռ䣩㡣
+	/// εͼԪ isTriangle Ϊ falseֻܲüİΧ
+	/// </summary>
+	struct BVHTriangle {
+		Point3f p0, p1, p2;
+		bool isTriangle = false;
+	};
+
+	enum class BVHSplitMethod { Median, SAH, LBVH, SBVH };
+
+	/// <summary>
+	/// ڵезʽDepthFirst ηøֵܣ
+	/// Treelet г layoutBlockBytes СĿ飬ÿӿʼȷ󣨸ܱʣֵܶԣ
+	/// ȵ˼ʱĴͻȱʧ
+	/// </summary>
+	enum class BVHNodeLayout { DepthFirst, Treelet };
+
+	/// <summary>
+	/// BVH 
+	/// </summary>
+	struct BVHBuildOptions {
+		BVHSplitMethod splitMethod = BVHSplitMethod::SAH;
+		int maxPrimsInNode = 4;          // ҶͼԪʱʵ SAH ֹ
+		int leafBatchWidth = 1;          // ҶͼԪһԼʱ TRIANGLE_BLOCK_WIDTHSAH ҶӵĴ
+		Float traversalCost = .5f;       // һڲڵһͼԪ󽻵ĴۣԽҶԽ
+		int nBuckets = 12;               // SAH Ͱ 32
+		int numThreads = 0;              // ߳0 ʾʹȫӲ߳
+		int parallelThreshold = 16384;   // ͼԪֵʱŽ̹߳
+		int mortonBits = 63;             // LBVH ʹõ Morton λ30  63
+		int treeletPasses = 0;           // LBVH ɺ treelet Ż0 ʾ
+		Float spatialSplitBudget = 1.5f; // SBVH ͼԪô౶ƿռ仮ָռõڴ
+		Float spatialSplitAlpha = 1e-5f; // ĻֵصڵʱSBVH ųԿռ仮
+		Float rebuildThreshold = 1.5f;   // Update ʱ refit  SAH ۳ϴ¹
+		bool motionBlur = false;         // Ϊ˶ͼԪʱֵİΧУ BuildMotion
+		Float shutterOpen = 0, shutterClose = 1; // ˶ģ BVH ΧжӦʱ̣ӦĿһ
+		const char* cacheDirectory = nullptr; // ĻĿ¼nullptr ʾʹû棬 bvh_cache.h
+		BVHNodeLayout nodeLayout = BVHNodeLayout::DepthFirst; // ɺڵзʽ
+		int layoutBlockBytes = 4096;     // Treelet ÿĴСȡһֵܣ64 ֽڣ
+		bool compressNodes = false;      // 豸ʹ 8 λΧе 16 ֽڽڵ㣬ڵڴ롢 compressed_bvh.hӰ칹Ҳ key
+		bool triangleBlocks = true;      // Ҷδ SoA Ŀ飬 BVH ռĶ󽻣 triangle_block.hͬ key
+
+		/// <summary>
+		/// n ͼԪҶӵ󽻴ۡʱһͼԪһԣһҲҪһ
+		/// </summary>
+		Float LeafCost(int n) const { return Float((n + leafBatchWidth - 1) / leafBatchWidth); }
+		int MaxLeafPrimitives() const { return maxPrimsInNode * leafBatchWidth; }
+	};
+
+	/// <summary>
+	/// ˹ BVHֻҪÿͼԪİΧУӴ Shape 
+	/// ˿ CPU ϵԣɺ nodes  primitiveIndices 豸˼
+	/// </summary>
+	class LinearBVH {
+	public:
+		LinearBVH() : maxDepth(0), builtSAHCost(0) {}
+
+		/// <summary>
+		///  BVHSAH ͼԪĿϷͰѡСͰ߽绮֣
+		/// Median ͬһϰλ԰֡ϴָ߳ͬʱ
+		/// LBVH ͼԪĵ Morton ֱɲνṹÿһǲеģ
+		/// ʺϰͼԪĳ treelet Żֲ
+		/// SBVH ѿƽͼԪÿŽ࣬ҶӿظͬһͼԪ
+		/// triangles εĶھȷüȱʡʱֻüΧ
+		/// </summary>
+		void Build(const std::vector<Bounds3f>& primBounds, const BVHBuildOptions& options = BVHBuildOptions(),
+			const std::vector<BVHTriangle>* triangles = nullptr);
+
+		/// <summary>
+		/// ˶ģ BVHprimBounds0primBounds1 ǸͼԪ shutterOpenshutterClose ʱ̵İΧУ
+		/// ˰ߵĲԵΪÿڵʱ̵İΧд motionBounds
+		/// </summary>
+		void BuildMotion(const std::vector<Bounds3f>& primBounds0, const std::vector<Bounds3f>& primBounds1,
+			const BVHBuildOptions& options = BVHBuildOptions());
+
+		int NumNodes() const { return int(nodes.size()); }
+		size_t NodeBytes() const { return nodes.size() * sizeof(LinearBVHNode); }
+
+		/// <summary>
+		///  options.nodeLayout нڵ㣬Build һȵ˳
+		/// ӽڸڵ桢childOffset ݴҺӵ±꣬ﻻɺӳɶԴŵĸʽ
+		/// </summary>
+		void LayoutNodes();
+
+		/// <summary>
+		///  SAH ۣڵԸڵ󽻴֮ͣ
+		/// ҶӵĴͼԪڲڵĴ traversalCost
+		/// </summary>
+		Float SAHCost() const;
+
+		/// <summary>
+		/// ͼԪƶ󱣳˲䣬Ե¼ڵİΧСprimBounds  Build ʱһͼԪ
+		/// SBVH ҶֻͼԪһ֣refit õͼԪİΧУɣ Update жǷؽ
+		/// </summary>
+		void Refit(const std::vector<Bounds3f>& primBounds);
+
+		/// <summary>
+		/// ÿ֡ã RefitSAH ǵϴʱ rebuildThreshold ʱ
+		/// ˵ѾʺڵͼԪλãԭĲ Build
+		///  true ʾؽˣʱ primitiveIndices ͽڵܱ仯
+		/// </summary>
+		bool Update(const std::vector<Bounds3f>& primBounds);
+
+		/// <summary>
+		/// ˶ģ BVH  Refit  Updateڵ bounds ȡʱ̰ΧеĲ
+		/// </summary>
+		void RefitMotion(const std::vector<Bounds3f>& primBounds0, const std::vector<Bounds3f>& primBounds1);
+		bool UpdateMotion(const std::vector<Bounds3f>& primBounds0, const std::vector<Bounds3f>& primBounds1);
+
+		/// <summary>
+		/// ѹдɶƻļkey  BVHCacheKey ͼԪΧк͹
+		/// </summary>
+		bool SaveCache(const std::string& path, uint64_t key) const;
+
+		/// <summary>
+		/// ڴӳضȡļ汾keyļСݹϣͽڵ±ȫͨŲã
+		/// 򷵻 falseɵ÷ Buildoptions Ϊ֮ Update ؽʱĲ
+		/// </summary>
+		bool LoadCache(const std::string& path, uint64_t key, const BVHBuildOptions& options = BVHBuildOptions());
+
+		const BVHBuildOptions& Options() const { return options; }
+		size_t MotionBoundsBytes() const { return motionBounds.size() * sizeof(LinearBVHMotionBounds); }
+
+		/// <summary>
+		/// ڵռõڴ棬shapeNodeBytes ԭÿ Shape ڵĴСڶԱ
+		/// </summary>
+		void PrintMemoryReport(size_t shapeNodeBytes = 0) const;
+
+		std::vector<LinearBVHNode> nodes;
+		std::vector<int> primitiveIndices; // ҶӰ˳õͼԪ
+		std::vector<LinearBVHMotionBounds> motionBounds; // ֻ BuildMotion 
+		int maxDepth;
+		Float builtSAHCost; // һʱ SAH ۣUpdate ݴж refit 
+
+	private:
+		std::unique_ptr<BVHBuildNode> BuildRecursive(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end);
+		void BuildLBVH(std::vector<BVHPrimitiveInfo>& primitiveInfo); //  lbvh.h ʵ
+		void BuildSBVH(const std::vector<Bounds3f>& primBounds, const std::vector<BVHTriangle>* triangles); //  sbvh.h ʵ
+		int FlattenBVHTree(const BVHBuildNode* node, int depth);
+		bool NeedsRebuild() const;
+
+		BVHBuildOptions options;
+		std::atomic<int> activeThreads;
+		std::atomic<int> totalNodes;
+	};
+
+	inline void LinearBVH::Build(const std::vector<Bounds3f>& primBounds, const BVHBuildOptions& options,
+		const std::vector<BVHTriangle>* triangles) {
+		this->options = options;
+		this->options.leafBatchWidth = std::max(1, std::min(options.leafBatchWidth, 64));
+		this->options.maxPrimsInNode = std::max(1, std::min(options.maxPrimsInNode, 0xffff / this->options.leafBatchWidth));
+		this->options.nBuckets = std::max(2, std::min(options.nBuckets, 32));
+		if (this->options.numThreads <= 0) {
+			this->options.numThreads = NumSystemCores();
+		}
+		nodes.clear();
+		primitiveIndices.clear();
+		motionBounds.clear();
+		maxDepth = 0;
+		builtSAHCost = 0;
+		if (primBounds.empty()) return;
+
+		std::vector<BVHPrimitiveInfo> primitiveInfo(primBounds.size());
+		for (int i = 0; i < primBounds.size(); i++) {
+			primitiveInfo[i] = BVHPrimitiveInfo(i, primBounds[i]);
+		}
+		if (this->options.splitMethod == BVHSplitMethod::LBVH) {
+			BuildLBVH(primitiveInfo);
+		}
+		else if (this->options.splitMethod == BVHSplitMethod::SBVH) {
+			BuildSBVH(primBounds, triangles);
+		}
+		else {
+			activeThreads = 1;
+			totalNodes = 0;
+			std::unique_ptr<BVHBuildNode> root = BuildRecursive(primitiveInfo, 0, int(primitiveInfo.size()));
+
+			primitiveIndices.resize(primitiveInfo.size());
+			for (int i = 0; i < primitiveInfo.size(); i++) {
+				primitiveIndices[i] = primitiveInfo[i].primitiveNumber;
+			}
+			nodes.reserve(totalNodes);
+			FlattenBVHTree(root.get(), 1);
+		}
+
+		// ջֻ MAXBVHDEPTH 㣬̫ʱ˻б֤Լ log2 nλ
+		if (maxDepth > MAXBVHDEPTH && this->options.splitMethod != BVHSplitMethod::Median) {
+			printf("BVH: depth %d exceeds %d, falling back to median split\n", maxDepth, MAXBVHDEPTH);
+			BVHBuildOptions medianOptions = this->options;
+			medianOptions.splitMethod = BVHSplitMethod::Median;
+			Build(primBounds, medianOptions);
+			return;
+		}
+		LayoutNodes();
+		builtSAHCost = SAHCost();
+	}
+
+	inline void LinearBVH::BuildMotion(const std::vector<Bounds3f>& primBounds0, const std::vector<Bounds3f>& primBounds1,
+		const BVHBuildOptions& options) {
+		std::vector<Bounds3f> primBounds(primBounds0.size());
+		for (int i = 0; i < primBounds.size(); i++) {
+			primBounds[i] = Union(primBounds0[i], primBounds1[i]);
+		}
+		Build(primBounds, options);
+		this->options.motionBlur = true;
+		RefitMotion(primBounds0, primBounds1);
+	}
+
+	inline std::unique_ptr<BVHBuildNode> LinearBVH::BuildRecursive(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end) {
+		std::unique_ptr<BVHBuildNode> node(new BVHBuildNode());
+		totalNodes++;
+
+		Bounds3f bounds, centroidBounds;
+		for (int i = start; i < end; i++) {
+			bounds = Union(bounds, primitiveInfo[i].bounds);
+			centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
+		}
+		node->bounds = bounds;
+		int nPrimitives = end - start;
+		auto createLeaf = [&]() {
+			node->firstPrimOffset = start;
+			node->nPrimitives = nPrimitives;
+			return std::move(node);
+		};
+		if (nPrimitives == 1) return createLeaf();
+
+		int dim = centroidBounds.MaximumExtent();
+		int mid = (start + end) / 2;
+		auto byCentroid = [dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) { return a.centroid[dim] < b.centroid[dim]; };
+		if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
+			// ȫغûٷ֣Ҷӵʱֻп
+			if (nPrimitives <= 0xffff) return createLeaf();
+		}
+		else if (options.splitMethod == BVHSplitMethod::Median) {
+			if (nPrimitives <= options.MaxLeafPrimitives()) return createLeaf();
+			std::nth_element(primitiveInfo.begin() + start, primitiveInfo.begin() + mid, primitiveInfo.begin() + end, byCentroid);
+		}
+		else {
+			// ͶӰ nBuckets ͰֻͰı߽ SAH
+			const int nBuckets = options.nBuckets;
+			struct BucketInfo {
+				int count = 0;
+				Bounds3f bounds;
+			};
+			BucketInfo buckets[32];
+			auto bucketIndex = [&](const BVHPrimitiveInfo& pi) {
+				int b = int(nBuckets * centroidBounds.Offset(pi.centroid)[dim]);
+				return std::min(b, nBuckets - 1);
+			};
+			for (int i = start; i < end; i++) {
+				int b = bucketIndex(primitiveInfo[i]);
+				buckets[b].count++;
+				buckets[b].bounds = Union(buckets[b].bounds, primitiveInfo[i].bounds);
+			}
+
+			// ҡɨһ飬õÿλ
+			Float cost[32];
+			Float leftArea[32];
+			int leftCount[32];
+			Bounds3f b0, b1;
+			int count0 = 0, count1 = 0;
+			for (int i = 0; i < nBuckets - 1; i++) {
+				b0 = Union(b0, buckets[i].bounds);
+				count0 += buckets[i].count;
+				leftArea[i] = count0 > 0 ? b0.SurfaceArea() : 0;
+				leftCount[i] = count0;
+			}
+			for (int i = nBuckets - 1; i > 0; i--) {
+				b1 = Union(b1, buckets[i].bounds);
+				count1 += buckets[i].count;
+				Float rightArea = count1 > 0 ? b1.SurfaceArea() : 0;
+				cost[i - 1] = options.traversalCost + (options.LeafCost(leftCount[i - 1]) * leftArea[i - 1] + options.LeafCost(count1) * rightArea) / bounds.SurfaceArea();
+			}
+
+			Float minCost = cost[0];
+			int minCostSplitBucket = 0;
+			for (int i = 1; i < nBuckets - 1; i++) {
+				if (cost[i] < minCost) {
+					minCost = cost[i];
+					minCostSplitBucket = i;
+				}
+			}
+
+			// ֱֲҶӻ㣬ͼԪʱͰһͼԪһҶ
+			Float leafCost = options.LeafCost(nPrimitives);
+			if (nPrimitives <= options.MaxLeafPrimitives() && leafCost <= minCost) return createLeaf();
+			auto pmid = std::partition(primitiveInfo.begin() + start, primitiveInfo.begin() + end,
+				[&](const BVHPrimitiveInfo& pi) { return bucketIndex(pi) <= minCostSplitBucket; });
+			mid = int(pmid - primitiveInfo.begin());
+			if (mid == start || mid == end) {
+				mid = (start + end) / 2;
+				std::nth_element(primitiveInfo.begin() + start, primitiveInfo.begin() + mid, primitiveInfo.begin() + end, byCentroid);
+			}
+		}
+
+		// ͼԪ以صϴڻп߳ʱ̹߳
+		node->splitAxis = dim;
+		if (nPrimitives > options.parallelThreshold && activeThreads.fetch_add(1) < options.numThreads) {
+			auto left = std::async(std::launch::async, [&]() {
+				std::unique_ptr<BVHBuildNode> child = BuildRecursive(primitiveInfo, start, mid);
+				activeThreads--;
+				return child;
+			});
+			node->children[1] = BuildRecursive(primitiveInfo, mid, end);
+			node->children[0] = left.get();
+		}
+		else {
+			if (nPrimitives > options.parallelThreshold) activeThreads--;
+			node->children[0] = BuildRecursive(primitiveInfo, start, mid);
+			node->children[1] = BuildRecursive(primitiveInfo, mid, end);
+		}
+		return std::move(node);
+	}
+
+	inline int LinearBVH::FlattenBVHTree(const BVHBuildNode* node, int depth) {
+		maxDepth = std::max(maxDepth, depth);
+		int myOffset = int(nodes.size());
+		nodes.push_back(LinearBVHNode());
+		if (node->nPrimitives > 0) {
+			LinearBVHNode& linearNode = nodes[myOffset];
+			linearNode.bounds = node->bounds;
+			linearNode.primitivesOffset = node->firstPrimOffset;
+			linearNode.nPrimitives = uint16_t(node->nPrimitives);
+			linearNode.axis = 0;
+			return myOffset;
+		}
+		FlattenBVHTree(node->children[0].get(), depth + 1);
+		int secondChild = FlattenBVHTree(node->children[1].get(), depth + 1);
+		LinearBVHNode& linearNode = nodes[myOffset];
+		linearNode.bounds = node->bounds;
+		linearNode.childOffset = secondChild;
+		linearNode.nPrimitives = 0;
+		linearNode.axis = uint8_t(node->splitAxis);
+		return myOffset;
+	}
+
+	inline void LinearBVH::LayoutNodes() {
+		int n = NumNodes();
+		if (n <= 1) return;
+		// ˳ i + 1Һݴ childOffset 
+		auto left = [](int i) { return i + 1; };
+		auto right = [this](int i) { return nodes[i].childOffset; };
+		auto isInterior = [this](int i) { return nodes[i].nPrimitives == 0; };
+
+		// ֵܶڸڵź֮ŷţ±ȻǺӴڸڵ
+		std::vector<int> newIndex(n, -1);
+		newIndex[0] = 0;
+		int next = 1;
+		auto placeChildren = [&](int parent) {
+			newIndex[left(parent)] = next;
+			newIndex[right(parent)] = next + 1;
+			next += 2;
+		};
+		if (isInterior(0)) {
+			if (options.nodeLayout == BVHNodeLayout::DepthFirst) {
+				std::vector<int> stack(1, 0);
+				while (!stack.empty()) {
+					int parent = stack.back();
+					stack.pop_back();
+					placeChildren(parent);
+					if (isInterior(right(parent))) stack.push_back(right(parent));
+					if (isInterior(left(parent))) stack.push_back(left(parent));
+				}
+			}
+			else {
+				// ֵܶڸڵ㱻߻ʱŻʣʺ͸ڵıȣ
+				// ÿ̰ĵѡĺѡٰȷãһ·ڵļͬһ
+				// ʣµĺѡΪ¿Ŀȷţ븸
+				int pairsPerBlock = std::max(1, options.layoutBlockBytes / int(2 * sizeof(LinearBVHNode)));
+				typedef std::pair<Float, int> Candidate;
+				std::vector<int> blockRoots(1, 0), stack;
+				std::vector<Candidate> heap;
+				std::vector<bool> selected(n, false);
+				while (!blockRoots.empty()) {
+					int blockRoot = blockRoots.back();
+					blockRoots.pop_back();
+					heap.clear();
+					heap.push_back(Candidate(nodes[blockRoot].bounds.SurfaceArea(), blockRoot));
+					for (int count = 0; count < pairsPerBlock && !heap.empty(); count++) {
+						std::pop_heap(heap.begin(), heap.end());
+						int parent = heap.back().second;
+						heap.pop_back();
+						selected[parent] = true;
+						for (int child : { left(parent), right(parent) }) {
+							if (!isInterior(child)) continue;
+							heap.push_back(Candidate(nodes[child].bounds.SurfaceArea(), child));
+							std::push_heap(heap.begin(), heap.end());
+						}
+					}
+					stack.assign(1, blockRoot);
+					while (!stack.empty()) {
+						int parent = stack.back();
+						stack.pop_back();
+						placeChildren(parent);
+						if (selected[right(parent)]) stack.push_back(right(parent));
+						if (selected[left(parent)]) stack.push_back(left(parent));
+					}
+					std::sort(heap.begin(), heap.end());
+					for (const Candidate& candidate : heap) {
+						blockRoots.push_back(candidate.second);
+					}
+				}
+			}
+		}
+
+		std::vector<LinearBVHNode> ordered(n);
+		for (int i = 0; i < n; i++) {
+			LinearBVHNode& node = ordered[newIndex[i]];
+			node = nodes[i];
+			if (isInterior(i)) node.childOffset = newIndex[left(i)];
+		}
+		nodes.swap(ordered);
+		if (!motionBounds.empty()) {
+			std::vector<LinearBVHMotionBounds> orderedMotion(n);
+			for (int i = 0; i < n; i++) {
+				orderedMotion[newIndex[i]] = motionBounds[i];
+			}
+			motionBounds.swap(orderedMotion);
+		}
+	}
+
+	inline Float LinearBVH::SAHCost() const {
+		if (nodes.empty()) return 0;
+		Float rootArea = nodes[0].bounds.SurfaceArea();
+		Float cost = 0;
+		for (const LinearBVHNode& node : nodes) {
+			Float area = rootArea > 0 ? node.bounds.SurfaceArea() / rootArea : 1;
+			cost += area * (node.nPrimitives > 0 ? options.LeafCost(node.nPrimitives) : options.traversalCost);
+		}
+		return cost;
+	}
+
+	inline void LinearBVH::Refit(const std::vector<Bounds3f>& primBounds) {
+		// ӵ±ܱȸڵ󣬵ɨһԵ
+		for (int i = NumNodes() - 1; i >= 0; i--) {
+			LinearBVHNode& node = nodes[i];
+			if (node.nPrimitives > 0) {
+				Bounds3f bounds;
+				for (int j = 0; j < node.nPrimitives; j++) {
+					bounds = Union(bounds, primBounds[primitiveIndices[node.primitivesOffset + j]]);
+				}
+				node.bounds = bounds;
+			}
+			else {
+				node.bounds = Union(nodes[node.childOffset].bounds, nodes[node.childOffset + 1].bounds);
+			}
+		}
+	}
+
+	inline void LinearBVH::RefitMotion(const std::vector<Bounds3f>& primBounds0, const std::vector<Bounds3f>& primBounds1) {
+		motionBounds.resize(nodes.size());
+		for (int i = NumNodes() - 1; i >= 0; i--) {
+			LinearBVHNode& node = nodes[i];
+			LinearBVHMotionBounds& motion = motionBounds[i];
+			if (node.nPrimitives > 0) {
+				motion.bounds0 = motion.bounds1 = Bounds3f();
+				for (int j = 0; j < node.nPrimitives; j++) {
+					int index = primitiveIndices[node.primitivesOffset + j];
+					motion.bounds0 = Union(motion.bounds0, primBounds0[index]);
+					motion.bounds1 = Union(motion.bounds1, primBounds1[index]);
+				}
+			}
+			else {
+				const LinearBVHMotionBounds& a = motionBounds[node.childOffset];
+				const LinearBVHMotionBounds& b = motionBounds[node.childOffset + 1];
+				motion.bounds0 = Union(a.bounds0, b.bounds0);
+				motion.bounds1 = Union(a.bounds1, b.bounds1);
+			}
+			node.bounds = Union(motion.bounds0, motion.bounds1);
+		}
+	}
+
+	inline bool LinearBVH::NeedsRebuild() const {
+		if (SAHCost() <= options.rebuildThreshold * builtSAHCost) return false;
+		printf("BVH: SAH cost %.2f after refit exceeds %.2f, rebuilding\n", SAHCost(), options.rebuildThreshold * builtSAHCost);
+		return true;
+	}
+
+	inline bool LinearBVH::Update(const std::vector<Bounds3f>& primBounds) {
+		Refit(primBounds);
+		if (!NeedsRebuild()) return false;
+		BVHBuildOptions rebuildOptions = options;
+		Build(primBounds, rebuildOptions);
+		return true;
+	}
+
+	inline bool LinearBVH::UpdateMotion(const std::vector<Bounds3f>& primBounds0, const std::vector<Bounds3f>& primBounds1) {
+		RefitMotion(primBounds0, primBounds1);
+		if (!NeedsRebuild()) return false;
+		BVHBuildOptions rebuildOptions = options;
+		BuildMotion(primBounds0, primBounds1, rebuildOptions);
+		return true;
+	}
+
+	inline void LinearBVH::PrintMemoryReport(size_t shapeNodeBytes) const {
+		printf("BVH: %d primitive references, %d nodes, max depth %d, SAH cost %.2f\n", int(primitiveIndices.size()), NumNodes(), maxDepth, SAHCost());
+		printf("BVH: %d bytes per node, %.2f MB nodes + %.2f MB primitive indices\n", int(sizeof(LinearBVHNode)),
+			NodeBytes() / (1024.0 * 1024.0), primitiveIndices.size() * sizeof(int) / (1024.0 * 1024.0));
+		if (!motionBounds.empty()) {
+			printf("BVH: %.2f MB motion bounds for shutter [%.2f, %.2f]\n", MotionBoundsBytes() / (1024.0 * 1024.0),
+				options.shutterOpen, options.shutterClose);
+		}
+		if (shapeNodeBytes > 0) {
+			printf("BVH: Shape-derived nodes would take %d bytes per node, %.2f MB in total\n", int(shapeNodeBytes),
+				nodes.size() * shapeNodeBytes / (1024.0 * 1024.0));
+		}
+	}
+
+	/// <summary>
+	///  BVHĵͷÿֻһΣڲڵ㰴ϵĹ߷ȷʽĺӣ
+	/// Զĺѹջintersect(first, count, tMax) Ҷŵ [first, first + count) ͼԪ󽻣
+	/// иĽʱ tMax ̲ true
+	/// ֮İΧвԶ̺ tMaxԶֱӱ޳
+	/// ȷʽʱջÿһڵ㣬֤Ȳ MAXBVHDEPTHջ
+	///  motionBounds ʱڵİΧа timeڹһ [0, 1]ֵֻһʱͼԪصĽڵ㡣
+	/// ˺豸˹ã豸˴ Shape::Hit  lambda˿ֱðΧлβԡ
+	/// anyHit Ϊ true ʱڵѯintersect һη true ͽѰҸĽ
+	/// </summary>
+#ifdef __CUDACC__
+#pragma nv_exec_check_disable
+#endif // __CUDACC__
+	template <typename Intersector>
+	__host__ __device__ inline bool IntersectLinearBVH(const LinearBVHNode* nodes, const Ray& ray, Intersector intersect,
+		const LinearBVHMotionBounds* motionBounds = nullptr, Float time = 0, bool anyHit = false) {
+		Ray r = ray;
+		Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+		int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+		bool hitAnything = false;
+		int nodesToVisit[MAXBVHDEPTH];
+		int toVisitOffset = 0, currentNodeIndex = 0;
+		while (true) {
+			const LinearBVHNode& node = nodes[currentNodeIndex];
+			bool hitNode = motionBounds ? motionBounds[currentNodeIndex].At(time).IntersectP(r, invDir, dirIsNeg)
+				: node.bounds.IntersectP(r, invDir, dirIsNeg);
+			if (hitNode) {
+				if (node.nPrimitives > 0) {
+					if (intersect(node.primitivesOffset, node.nPrimitives, r.tMax)) {
+						hitAnything = true;
+						if (anyHit) break;
+					}
+					if (toVisitOffset == 0) break;
+					currentNodeIndex = nodesToVisit[--toVisitOffset];
+				}
+				else {
+					int nearChild = dirIsNeg[node.axis];
+					nodesToVisit[toVisitOffset++] = node.childOffset + 1 - nearChild;
+					currentNodeIndex = node.childOffset + nearChild;
+				}
+			}
+			else {
+				if (toVisitOffset == 0) break;
+				currentNodeIndex = nodesToVisit[--toVisitOffset];
+			}
+		}
+		return hitAnything;
+	}
+}
+
+#include "lbvh.h"
+#include "sbvh.h"
+#include "bvh_cache.h"
+
+#endif // QZRT_ACCEL_LINEAR_BVH_H
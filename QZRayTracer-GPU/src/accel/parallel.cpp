@@ -0,0 +1,4 @@
+#include "parallel.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
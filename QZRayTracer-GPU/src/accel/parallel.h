@@ -0,0 +1,40 @@
+#ifndef QZRT_ACCEL_PARALLEL_H
+#define QZRT_ACCEL_PARALLEL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace raytracer {
+	/// <summary>
+	/// ϿõӲ߳
+	/// </summary>
+	inline int NumSystemCores() {
+		return std::max(1, int(std::thread::hardware_concurrency()));
+	}
+
+	/// <summary>
+	///  [0, count) ֳ numThreads 䣬func(begin, end, threadIndex) ڸԵִ߳У
+	/// ̸߳ 0 Ρֻ count  numThreads εõĻͬ
+	/// ͳƺͷַ׶һ
+	/// </summary>
+	template <typename Func>
+	inline void ParallelForChunks(int64_t count, int numThreads, const Func& func) {
+		numThreads = int(std::max<int64_t>(1, std::min<int64_t>(numThreads, count)));
+		if (numThreads == 1) {
+			func(int64_t(0), count, 0);
+			return;
+		}
+		std::vector<std::thread> threads;
+		for (int t = 1; t < numThreads; t++) {
+			threads.push_back(std::thread([&func, count, numThreads, t]() {
+				func(count * t / numThreads, count * (t + 1) / numThreads, t);
+			}));
+		}
+		func(int64_t(0), count / numThreads, 0);
+		for (std::thread& thread : threads) thread.join();
+	}
+}
+
+#endif // QZRT_ACCEL_PARALLEL_H
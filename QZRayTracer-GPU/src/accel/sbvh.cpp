@@ -0,0 +1,4 @@
+#include "sbvh.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
@@ -0,0 +1,365 @@
+#ifndef QZRT_ACCEL_SBVH_H
+#define QZRT_ACCEL_SBVH_H
+
+#include <future>
+#include <limits>
+#include <memory>
+#include "linear_bvh.h"
+
+namespace raytracer {
+	/// <summary>
+	/// SBVH еһͼԪáռ仮ְѿƽͼԪó룬߸һã
+	/// bounds ǲüһǲͼԪİΧ
+	/// </summary>
+	struct SBVHReference {
+		int primitiveNumber;
+		Bounds3f bounds;
+		Point3f Centroid() const { return .5f * bounds.pMin + .5f * bounds.pMax; }
+	};
+
+	// Infinity 豸˱ʱ __device__ ˵Ĺ
+	static const Float SBVHInfinity = std::numeric_limits<Float>::infinity();
+
+	inline bool SBVHEmpty(const Bounds3f& b) {
+		return b.pMax.x < b.pMin.x || b.pMax.y < b.pMin.y || b.pMax.z < b.pMin.z;
+	}
+
+	/// <summary>
+	/// ΧеıհΧ 0ֱõ˵ľ޴
+	/// </summary>
+	inline Float SBVHArea(const Bounds3f& b) {
+		return SBVHEmpty(b) ? 0 : b.SurfaceArea();
+	}
+
+	/// <summary>
+	/// ռ仮ֵ SBVH ÿڵŵİĻ֣ΧصʱڽڵΧϾȷ䣬
+	/// òüռ仮֣ռ仮ָ˲ûгԤʱŲá
+	/// ΰʵʵļβüͼԪֻܲüΧ
+	/// </summary>
+	class SBVHBuilder {
+	public:
+		SBVHBuilder(const std::vector<BVHTriangle>* triangles, const BVHBuildOptions& options, int nPrimitives, Float rootArea)
+			: triangles(triangles), options(options), rootArea(rootArea),
+			maxReferences(int64_t(std::max(Float(1), options.spatialSplitBudget) * nPrimitives)),
+			references(nPrimitives), activeThreads(1) {}
+
+		std::unique_ptr<BVHBuildNode> Build(std::vector<SBVHReference>& refs) { return BuildRecursive(refs); }
+
+		int64_t NumReferences() const { return references; }
+
+	private:
+		struct ObjectSplit {
+			Float cost = SBVHInfinity;
+			int axis = 0, bucket = 0;
+			Bounds3f centroidBounds;
+			Float overlap = 0; // Χֵཻ
+		};
+		struct SpatialSplit {
+			Float cost = SBVHInfinity;
+			int axis = 0;
+			Float position = 0;
+			Bounds3f leftBounds, rightBounds;
+			int leftCount = 0, rightCount = 0;
+		};
+
+		std::unique_ptr<BVHBuildNode> BuildRecursive(std::vector<SBVHReference>& refs);
+		ObjectSplit FindObjectSplit(const std::vector<SBVHReference>& refs, const Bounds3f& bounds) const;
+		SpatialSplit FindSpatialSplit(const std::vector<SBVHReference>& refs, const Bounds3f& bounds) const;
+		void SplitReference(const SBVHReference& ref, int axis, Float position, SBVHReference& left, SBVHReference& right) const;
+		Bounds3f Clip(const SBVHReference& ref, int axis, Float lo, Float hi) const;
+		int BucketIndex(const ObjectSplit& split, const Point3f& centroid) const {
+			int b = int(options.nBuckets * split.centroidBounds.Offset(centroid)[split.axis]);
+			return std::max(0, std::min(b, options.nBuckets - 1));
+		}
+
+		const std::vector<BVHTriangle>* triangles;
+		const BVHBuildOptions& options;
+		const Float rootArea;
+		const int64_t maxReferences;
+		std::atomic<int64_t> references; // ǰռ仮ÿһüһ
+		std::atomic<int> activeThreads;
+	};
+
+	inline Bounds3f SBVHBuilder::Clip(const SBVHReference& ref, int axis, Float lo, Float hi) const {
+		Bounds3f clipped;
+		if (triangles && (*triangles)[ref.primitiveNumber].isTriangle) {
+			// ƽ [lo, hi] 󽻣ƽڵĶ㣬ϸƽĽ
+			const BVHTriangle& triangle = (*triangles)[ref.primitiveNumber];
+			const Point3f* p[3] = { &triangle.p0, &triangle.p1, &triangle.p2 };
+			for (int i = 0; i < 3; i++) {
+				const Point3f& v0 = *p[i];
+				const Point3f& v1 = *p[(i + 1) % 3];
+				Float a0 = v0[axis], a1 = v1[axis];
+				if (a0 >= lo && a0 <= hi) clipped = Union(clipped, v0);
+				for (Float plane : { lo, hi }) {
+					if ((a0 < plane && a1 > plane) || (a0 > plane && a1 < plane)) {
+						Point3f q = Lerp((plane - a0) / (a1 - a0), v0, v1);
+						q[axis] = plane;
+						clipped = Union(clipped, q);
+					}
+				}
+			}
+		}
+		else {
+			clipped = ref.bounds;
+			clipped.pMin[axis] = std::max(clipped.pMin[axis], lo);
+			clipped.pMax[axis] = std::min(clipped.pMax[axis], hi);
+		}
+		// ÿѾ֮ǰĻֲùܳԭİΧУཻʱر׼ĿհΧУֱӲ Union
+		clipped = Intersect(clipped, ref.bounds);
+		return SBVHEmpty(clipped) ? Bounds3f() : clipped;
+	}
+
+	inline void SBVHBuilder::SplitReference(const SBVHReference& ref, int axis, Float position,
+		SBVHReference& left, SBVHReference& right) const {
+		left.primitiveNumber = right.primitiveNumber = ref.primitiveNumber;
+		left.bounds = Clip(ref, axis, -SBVHInfinity, position);
+		right.bounds = Clip(ref, axis, position, SBVHInfinity);
+	}
+
+	inline SBVHBuilder::ObjectSplit SBVHBuilder::FindObjectSplit(const std::vector<SBVHReference>& refs, const Bounds3f& bounds) const {
+		ObjectSplit best;
+		Bounds3f centroidBounds;
+		for (const SBVHReference& ref : refs) centroidBounds = Union(centroidBounds, ref.Centroid());
+		const int nBuckets = options.nBuckets;
+		Float nodeArea = SBVHArea(bounds);
+		for (int axis = 0; axis < 3; axis++) {
+			if (centroidBounds.pMax[axis] <= centroidBounds.pMin[axis]) continue;
+			ObjectSplit split;
+			split.axis = axis;
+			split.centroidBounds = centroidBounds;
+			int counts[32] = {};
+			Bounds3f buckets[32];
+			for (const SBVHReference& ref : refs) {
+				int b = BucketIndex(split, ref.Centroid());
+				counts[b]++;
+				buckets[b] = Union(buckets[b], ref.bounds);
+			}
+			Bounds3f leftBounds[32];
+			int leftCount[32];
+			Bounds3f b0;
+			int count0 = 0;
+			for (int i = 0; i < nBuckets - 1; i++) {
+				b0 = Union(b0, buckets[i]);
+				count0 += counts[i];
+				leftBounds[i] = b0;
+				leftCount[i] = count0;
+			}
+			Bounds3f b1;
+			int count1 = 0;
+			for (int i = nBuckets - 1; i > 0; i--) {
+				b1 = Union(b1, buckets[i]);
+				count1 += counts[i];
+				if (leftCount[i - 1] == 0 || count1 == 0) continue;
+				Float cost = options.traversalCost +
+					(options.LeafCost(leftCount[i - 1]) * SBVHArea(leftBounds[i - 1]) + options.LeafCost(count1) * SBVHArea(b1)) / nodeArea;
+				if (cost < best.cost) {
+					best = split;
+					best.cost = cost;
+					best.bucket = i - 1;
+					best.overlap = SBVHArea(Intersect(leftBounds[i - 1], b1));
+				}
+			}
+		}
+		return best;
+	}
+
+	inline SBVHBuilder::SpatialSplit SBVHBuilder::FindSpatialSplit(const std::vector<SBVHReference>& refs, const Bounds3f& bounds) const {
+		SpatialSplit best;
+		const int nBins = options.nBuckets;
+		Float nodeArea = SBVHArea(bounds);
+		for (int axis = 0; axis < 3; axis++) {
+			Float origin = bounds.pMin[axis];
+			Float binWidth = (bounds.pMax[axis] - origin) / nBins;
+			if (binWidth <= 0) continue;
+			Bounds3f bins[32];
+			int enter[32] = {}, exit[32] = {};
+			auto binIndex = [&](Float x) { return std::max(0, std::min(int((x - origin) / binWidth), nBins - 1)); };
+			// ÿòüÿڵһӼ롢һӼƳ
+			for (const SBVHReference& ref : refs) {
+				int first = binIndex(ref.bounds.pMin[axis]), last = binIndex(ref.bounds.pMax[axis]);
+				for (int b = first; b <= last; b++) {
+					Float lo = origin + b * binWidth;
+					Float hi = b == nBins - 1 ? bounds.pMax[axis] : lo + binWidth;
+					bins[b] = Union(bins[b], first == last ? ref.bounds : Clip(ref, axis, lo, hi));
+				}
+				enter[first]++;
+				exit[last]++;
+			}
+			Bounds3f leftBounds[32];
+			int leftCount[32];
+			Bounds3f b0;
+			int count0 = 0;
+			for (int i = 0; i < nBins - 1; i++) {
+				b0 = Union(b0, bins[i]);
+				count0 += enter[i];
+				leftBounds[i] = b0;
+				leftCount[i] = count0;
+			}
+			Bounds3f b1;
+			int count1 = 0;
+			for (int i = nBins - 1; i > 0; i--) {
+				b1 = Union(b1, bins[i]);
+				count1 += exit[i];
+				if (leftCount[i - 1] == 0 || count1 == 0) continue;
+				Float cost = options.traversalCost +
+					(options.LeafCost(leftCount[i - 1]) * SBVHArea(leftBounds[i - 1]) + options.LeafCost(count1) * SBVHArea(b1)) / nodeArea;
+				if (cost < best.cost) {
+					best.cost = cost;
+					best.axis = axis;
+					best.position = origin + i * binWidth;
+					best.leftBounds = leftBounds[i - 1];
+					best.rightBounds = b1;
+					best.leftCount = leftCount[i - 1];
+					best.rightCount = count1;
+				}
+			}
+		}
+		return best;
+	}
+
+	inline std::unique_ptr<BVHBuildNode> SBVHBuilder::BuildRecursive(std::vector<SBVHReference>& refs) {
+		std::unique_ptr<BVHBuildNode> node(new BVHBuildNode());
+		Bounds3f bounds;
+		for (const SBVHReference& ref : refs) bounds = Union(bounds, ref.bounds);
+		node->bounds = bounds;
+		int nRefs = int(refs.size());
+		auto createLeaf = [&]() {
+			node->nPrimitives = nRefs;
+			node->primitives.resize(nRefs);
+			for (int i = 0; i < nRefs; i++) node->primitives[i] = refs[i].primitiveNumber;
+			return std::move(node);
+		};
+		if (nRefs == 1) return createLeaf();
+
+		ObjectSplit objectSplit = FindObjectSplit(refs, bounds);
+		SpatialSplit spatialSplit;
+		// ֻаĻֵصʱֵóԿռ仮֣alpha ڵһ
+		if (objectSplit.overlap > options.spatialSplitAlpha * rootArea && references < maxReferences) {
+			spatialSplit = FindSpatialSplit(refs, bounds);
+		}
+		Float minCost = std::min(objectSplit.cost, spatialSplit.cost);
+		Float leafCost = options.LeafCost(nRefs);
+		if (nRefs <= options.MaxLeafPrimitives() && leafCost <= minCost) return createLeaf();
+
+		std::vector<SBVHReference> left, right;
+		bool useSpatial = spatialSplit.cost < objectSplit.cost;
+		if (useSpatial) {
+			int64_t duplicates = spatialSplit.leftCount + spatialSplit.rightCount - nRefs;
+			if (references.fetch_add(duplicates) + duplicates > maxReferences) {
+				references -= duplicates;
+				useSpatial = false;
+			}
+		}
+		if (useSpatial) {
+			const int axis = spatialSplit.axis;
+			const Float position = spatialSplit.position;
+			Bounds3f leftBounds, rightBounds;
+			int leftCount = spatialSplit.leftCount, rightCount = spatialSplit.rightCount;
+			Float leftArea = SBVHArea(spatialSplit.leftBounds), rightArea = SBVHArea(spatialSplit.rightBounds);
+			int64_t duplicates = 0;
+			for (const SBVHReference& ref : refs) {
+				if (ref.bounds.pMax[axis] <= position) {
+					left.push_back(ref);
+				}
+				else if (ref.bounds.pMin[axis] >= position) {
+					right.push_back(ref);
+				}
+				else {
+					// ƽãŵһ߱ȲóʱͲƣunsplitting
+					Float splitCost = leftArea * leftCount + rightArea * rightCount;
+					Float allLeftCost = SBVHArea(Union(spatialSplit.leftBounds, ref.bounds)) * leftCount + rightArea * (rightCount - 1);
+					Float allRightCost = leftArea * (leftCount - 1) + SBVHArea(Union(spatialSplit.rightBounds, ref.bounds)) * rightCount;
+					SBVHReference leftRef, rightRef;
+					SplitReference(ref, axis, position, leftRef, rightRef);
+					bool leftEmpty = SBVHEmpty(leftRef.bounds), rightEmpty = SBVHEmpty(rightRef.bounds);
+					if (rightEmpty || (!leftEmpty && allLeftCost < splitCost && allLeftCost <= allRightCost)) {
+						left.push_back(ref);
+						rightCount--;
+					}
+					else if (leftEmpty || allRightCost < splitCost) {
+						right.push_back(ref);
+						leftCount--;
+					}
+					else {
+						left.push_back(leftRef);
+						right.push_back(rightRef);
+						duplicates++;
+					}
+				}
+			}
+			// ԤǰȫԤģûиƵĻȥ
+			references -= spatialSplit.leftCount + spatialSplit.rightCount - nRefs - duplicates;
+			node->splitAxis = axis;
+		}
+		else if (objectSplit.cost < SBVHInfinity) {
+			for (const SBVHReference& ref : refs) {
+				(BucketIndex(objectSplit, ref.Centroid()) <= objectSplit.bucket ? left : right).push_back(ref);
+			}
+			node->splitAxis = objectSplit.axis;
+		}
+		if (left.empty() || right.empty()) {
+			// ȫغֲռ仮֣Ҷӵʱֻп
+			if (nRefs <= 0xffff) return createLeaf();
+			left.assign(refs.begin(), refs.begin() + nRefs / 2);
+			right.assign(refs.begin() + nRefs / 2, refs.end());
+		}
+		std::vector<SBVHReference>().swap(refs);
+
+		if (nRefs > options.parallelThreshold && activeThreads.fetch_add(1) < options.numThreads) {
+			auto leftChild = std::async(std::launch::async, [&]() {
+				std::unique_ptr<BVHBuildNode> child = BuildRecursive(left);
+				activeThreads--;
+				return child;
+			});
+			node->children[1] = BuildRecursive(right);
+			node->children[0] = leftChild.get();
+		}
+		else {
+			if (nRefs > options.parallelThreshold) activeThreads--;
+			node->children[0] = BuildRecursive(left);
+			node->children[1] = BuildRecursive(right);
+		}
+		return std::move(node);
+	}
+
+	inline void LinearBVH::BuildSBVH(const std::vector<Bounds3f>& primBounds, const std::vector<BVHTriangle>* triangles) {
+		if (triangles && triangles->size() != primBounds.size()) triangles = nullptr;
+		std::vector<SBVHReference> refs;
+		refs.reserve(primBounds.size());
+		Bounds3f rootBounds;
+		for (int i = 0; i < primBounds.size(); i++) {
+			SBVHReference ref;
+			ref.primitiveNumber = i;
+			ref.bounds = primBounds[i];
+			refs.push_back(ref);
+			rootBounds = Union(rootBounds, primBounds[i]);
+		}
+		SBVHBuilder builder(triangles, options, int(primBounds.size()), SBVHArea(rootBounds));
+		std::unique_ptr<BVHBuildNode> root = builder.Build(refs);
+
+		// Ҷڹʱ֪Լ primitiveIndices еλãȵ˳ͳһ
+		primitiveIndices.clear();
+		primitiveIndices.reserve(builder.NumReferences());
+		int nodeCount = 0;
+		std::vector<BVHBuildNode*> stack(1, root.get());
+		while (!stack.empty()) {
+			BVHBuildNode* node = stack.back();
+			stack.pop_back();
+			nodeCount++;
+			if (node->nPrimitives > 0) {
+				node->firstPrimOffset = int(primitiveIndices.size());
+				primitiveIndices.insert(primitiveIndices.end(), node->primitives.begin(), node->primitives.end());
+				std::vector<int>().swap(node->primitives);
+			}
+			else {
+				stack.push_back(node->children[1].get());
+				stack.push_back(node->children[0].get());
+			}
+		}
+		nodes.reserve(nodeCount);
+		FlattenBVHTree(root.get(), 1);
+	}
+}
+
+#endif // QZRT_ACCEL_SBVH_H
@@ -0,0 +1,4 @@
+#include "triangle_block.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
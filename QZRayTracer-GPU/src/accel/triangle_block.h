@@ -0,0 +1,299 @@
+#ifndef QZRT_ACCEL_TRIANGLE_BLOCK_H
+#define QZRT_ACCEL_TRIANGLE_BLOCK_H
+
+#include <algorithm>
+#include <vector>
+#include "linear_bvh.h"
+#if !defined(__CUDA_ARCH__) && !defined(PBRT_FLOAT_AS_DOUBLE) && (defined(__SSE2__) || defined(_M_X64))
+#include <immintrin.h>
+#define TRIANGLE_BLOCK_SIMD //  SSE AVX ʱ 8 һ AVXһβһ
+#endif
+
+namespace raytracer {
+	// һ豸ÿ߳βԿΣһ SSE Ĵ
+#define TRIANGLE_BLOCK_WIDTH 4
+
+	/// <summary>
+	/// ˮ󽻣Woop ˵ķֻ͹йصĲ֣ѷỻ zбʹ߷ +z
+	/// ÿֻʣƽơб䶥άıֵȫ߲ͬӷ©ȥ
+	/// ͬһֻһΣҪλ t ԼĲ
+	/// </summary>
+	struct WatertightRay {
+		__host__ __device__ WatertightRay() {}
+		__host__ __device__ WatertightRay(const Ray& ray) {
+			kz = MaxDimension(Abs(ray.d));
+			kx = kz + 1; if (kx == 3) kx = 0;
+			ky = kx + 1; if (ky == 3) ky = 0;
+			Vector3f d = Permute(ray.d, kx, ky, kz);
+			ox = ray.o[kx];
+			oy = ray.o[ky];
+			oz = ray.o[kz];
+			Sx = -d.x / d.z;
+			Sy = -d.y / d.z;
+			Sz = 1.f / d.z;
+			// 㲻λȵ ShadowEpsilon * 100 Ľ㵱ཻ˲ __device__ ֵ
+			Float minDistance = Float(0.01) / ray.d.Length();
+			tMin = ray.tMin > minDistance ? ray.tMin : minDistance;
+		}
+		Float ox, oy, oz;
+		Float Sx, Sy, Sz;
+		Float tMin;
+		int kx, ky, kz;
+	};
+
+	/// <summary>
+	/// һεˮ󽻣xyz 㰴 kxkykz к꣨ûƽƵ㣩
+	///  (tMin, tMax) ֮ʱ t ꡣTriangle 󽻶֤ߵĽһ
+	/// </summary>
+	__host__ __device__ inline bool IntersectTriangleWatertight(const WatertightRay& r, Float x0, Float y0, Float z0,
+		Float x1, Float y1, Float z1, Float x2, Float y2, Float z2, Float tMax, Float& tHit, Float b[3]) {
+		x0 -= r.ox; y0 -= r.oy; z0 -= r.oz;
+		x1 -= r.ox; y1 -= r.oy; z1 -= r.oz;
+		x2 -= r.ox; y2 -= r.oy; z2 -= r.oz;
+		x0 += r.Sx * z0;
+		y0 += r.Sy * z0;
+		x1 += r.Sx * z1;
+		y1 += r.Sy * z1;
+		x2 += r.Sx * z2;
+		y2 += r.Sy * z2;
+
+		// ߵĺͬʱߴ
+		Float e0 = x1 * y2 - y1 * x2;
+		Float e1 = x2 * y0 - y2 * x0;
+		Float e2 = x0 * y1 - y0 * x1;
+		if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0)) return false;
+		Float det = e0 + e1 + e2;
+		if ((det < 0 ? -det : det) < Float(0.0001)) return false; // ˻ƽУֵͬ ShadowEpsilon
+
+		// t  z ֵ
+		z0 *= r.Sz;
+		z1 *= r.Sz;
+		z2 *= r.Sz;
+		Float invDet = 1 / det;
+		Float t = (e0 * z0 + e1 * z1 + e2 * z2) * invDet;
+		if (!(t > r.tMin && t < tMax)) return false;
+		tHit = t;
+		b[0] = e0 * invDet;
+		b[1] = e1 * invDet;
+		b[2] = e2 * invDet;
+		return true;
+	}
+
+	__host__ __device__ inline bool IntersectTriangleWatertight(const WatertightRay& r, const Point3f& p0, const Point3f& p1, const Point3f& p2,
+		Float tMax, Float& tHit, Float b[3]) {
+		return IntersectTriangleWatertight(r, p0[r.kx], p0[r.ky], p0[r.kz], p1[r.kx], p1[r.ky], p1[r.kz], p2[r.kx], p2[r.ky], p2[r.kz], tMax, tHit, b);
+	}
+
+	/// <summary>
+	/// N ΰ SoA ŵĿ飺Ѿ任 BVH ڵĿռ䣬ʱҪεı任
+	/// 갴 [][][] Уͬһ N ţһָܶһĴ
+	/// Ҳֻǻһ N ʱλͬĶ㣬ʽΪ 0ᱻ
+	/// </summary>
+	template <int N>
+	struct TriangleBlock {
+		Float p[3][3][N];
+		int primitive[N]; // ҶͼԪλãλΪ -1
+	};
+
+	/// <summary>
+	/// ҶﱻΣҶӵǰ棬ռ nTriangles λã firstBlock ʼ
+	/// </summary>
+	struct TriangleLeaf {
+		int firstBlock;
+		int nTriangles;
+	};
+
+#ifdef TRIANGLE_BLOCK_SIMD
+	/// <summary>
+	/// õ SSE 㣬AVXLanes ṩͬĽӿڣֻдһ
+	/// </summary>
+	struct SSELanes {
+		typedef __m128 V;
+		static const int Width = 4;
+		static V Set(float x) { return _mm_set1_ps(x); }
+		static V Load(const float* p) { return _mm_loadu_ps(p); }
+		static void Store(float* p, V a) { _mm_storeu_ps(p, a); }
+		static V Add(V a, V b) { return _mm_add_ps(a, b); }
+		static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+		static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+		static V Div(V a, V b) { return _mm_div_ps(a, b); }
+		static V Lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+		static V Gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+		static V Ge(V a, V b) { return _mm_cmpge_ps(a, b); }
+		static V And(V a, V b) { return _mm_and_ps(a, b); }
+		static V Or(V a, V b) { return _mm_or_ps(a, b); }
+		static V AndNot(V a, V b) { return _mm_andnot_ps(a, b); }
+		static V Abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+		static int Mask(V a) { return _mm_movemask_ps(a); }
+	};
+
+#ifdef __AVX__
+	struct AVXLanes {
+		typedef __m256 V;
+		static const int Width = 8;
+		static V Set(float x) { return _mm256_set1_ps(x); }
+		static V Load(const float* p) { return _mm256_loadu_ps(p); }
+		static void Store(float* p, V a) { _mm256_storeu_ps(p, a); }
+		static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+		static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+		static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+		static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+		static V Lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static V Gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static V Ge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static V And(V a, V b) { return _mm256_and_ps(a, b); }
+		static V Or(V a, V b) { return _mm256_or_ps(a, b); }
+		static V AndNot(V a, V b) { return _mm256_andnot_ps(a, b); }
+		static V Abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+		static int Mask(V a) { return _mm256_movemask_ps(a); }
+	};
+#endif // __AVX__
+
+	/// <summary>
+	/// IntersectTriangleWatertight  SIMD 汾L::Width һ飬˳汾ͬ
+	/// еڿλãtMax ̵ tûз -1
+	/// </summary>
+	template <typename L, int N>
+	inline int IntersectTriangleBlockSIMD(const TriangleBlock<N>& block, const WatertightRay& r, Float& tMax) {
+		typedef typename L::V V;
+		int hitLane = -1;
+		for (int g = 0; g < N; g += L::Width) {
+			V x[3], y[3], z[3];
+			for (int v = 0; v < 3; v++) {
+				z[v] = L::Sub(L::Load(&block.p[v][r.kz][g]), L::Set(r.oz));
+				x[v] = L::Add(L::Sub(L::Load(&block.p[v][r.kx][g]), L::Set(r.ox)), L::Mul(L::Set(r.Sx), z[v]));
+				y[v] = L::Add(L::Sub(L::Load(&block.p[v][r.ky][g]), L::Set(r.oy)), L::Mul(L::Set(r.Sy), z[v]));
+			}
+			V e0 = L::Sub(L::Mul(x[1], y[2]), L::Mul(y[1], x[2]));
+			V e1 = L::Sub(L::Mul(x[2], y[0]), L::Mul(y[2], x[0]));
+			V e2 = L::Sub(L::Mul(x[0], y[1]), L::Mul(y[0], x[1]));
+			V zero = L::Set(0);
+			V anyNegative = L::Or(L::Or(L::Lt(e0, zero), L::Lt(e1, zero)), L::Lt(e2, zero));
+			V anyPositive = L::Or(L::Or(L::Gt(e0, zero), L::Gt(e1, zero)), L::Gt(e2, zero));
+			V det = L::Add(L::Add(e0, e1), e2);
+			V valid = L::AndNot(L::And(anyNegative, anyPositive), L::Ge(L::Abs(det), L::Set(0.0001f)));
+			if (!L::Mask(valid)) continue;
+
+			V sz = L::Set(r.Sz);
+			V invDet = L::Div(L::Set(1), det);
+			V t = L::Mul(L::Add(L::Add(L::Mul(e0, L::Mul(z[0], sz)), L::Mul(e1, L::Mul(z[1], sz))), L::Mul(e2, L::Mul(z[2], sz))), invDet);
+			int mask = L::Mask(L::And(valid, L::And(L::Gt(t, L::Set(r.tMin)), L::Lt(t, L::Set(tMax)))));
+			if (!mask) continue;
+			float ts[L::Width];
+			L::Store(ts, t);
+			for (int lane = 0; lane < L::Width; lane++) {
+				if ((mask & (1 << lane)) && ts[lane] < tMax) {
+					tMax = ts[lane];
+					hitLane = g + lane;
+				}
+			}
+		}
+		return hitLane;
+	}
+#endif // TRIANGLE_BLOCK_SIMD
+
+	/// <summary>
+	/// һ N 󽻣еڿλãtMax ̵ tûз -1
+	///  SIMD һβһ飻豸˵ SIMD ߳ĸߣÿ̰߳˳ԣ
+	/// ʡµÿε麯á任ţȡҲ SoA 
+	/// </summary>
+	template <int N>
+	__host__ __device__ inline int IntersectTriangleBlock(const TriangleBlock<N>& block, const WatertightRay& r, Float& tMax) {
+#ifdef TRIANGLE_BLOCK_SIMD
+#ifdef __AVX__
+		if (N % 8 == 0) return IntersectTriangleBlockSIMD<AVXLanes>(block, r, tMax);
+#endif // __AVX__
+		if (N % 4 == 0) return IntersectTriangleBlockSIMD<SSELanes>(block, r, tMax);
+#endif // TRIANGLE_BLOCK_SIMD
+		int hitLane = -1;
+		for (int i = 0; i < N; i++) {
+			Float t, b[3];
+			if (IntersectTriangleWatertight(r, block.p[0][r.kx][i], block.p[0][r.ky][i], block.p[0][r.kz][i],
+				block.p[1][r.kx][i], block.p[1][r.ky][i], block.p[1][r.kz][i],
+				block.p[2][r.kx][i], block.p[2][r.ky][i], block.p[2][r.kz][i], tMax, t, b)) {
+				tMax = t;
+				hitLane = i;
+			}
+		}
+		return hitLane;
+	}
+
+	/// <summary>
+	/// Ҷ󽻣еҶͼԪλãtMax ̵ tûз -1
+	/// anyHit ʱһͷأڵѯ
+	/// </summary>
+	template <int N>
+	__host__ __device__ inline int IntersectTriangleLeaf(const TriangleBlock<N>* blocks, const TriangleLeaf& leaf, const WatertightRay& r,
+		Float& tMax, bool anyHit = false) {
+		int hitPrimitive = -1;
+		int lastBlock = leaf.firstBlock + (leaf.nTriangles + N - 1) / N;
+		for (int i = leaf.firstBlock; i < lastBlock; i++) {
+			int lane = IntersectTriangleBlock(blocks[i], r, tMax);
+			if (lane < 0) continue;
+			hitPrimitive = blocks[i].primitive[lane];
+			if (anyHit) break;
+		}
+		return hitPrimitive;
+	}
+
+	/// <summary>
+	/// Ϊ LinearBVH ҶӴΡɺ blocks  leaves 豸ˣ
+	/// ͼԪƶ Build ɣֻһԵı
+	/// </summary>
+	template <int N>
+	class TriangleBlocks {
+	public:
+		static const int Width = N;
+
+		/// <summary>
+		/// ÿҶȶŵҶǰ棨ֻҶڲ bvh.primitiveIndicesظòٸı˳򣩣
+		///  N һͼԪҶӺճ󽻡triangles ͼԪ BVH ڿռĶ
+		/// </summary>
+		void Build(LinearBVH& bvh, const std::vector<BVHTriangle>& triangles);
+
+		size_t Bytes() const { return blocks.size() * sizeof(TriangleBlock<N>) + leaves.size() * sizeof(TriangleLeaf); }
+
+		std::vector<TriangleBlock<N>> blocks;
+		std::vector<TriangleLeaf> leaves; // ҶͼԪλֻÿҶӵĵһλ壻ûʱΪ
+		int numTriangles = 0;
+	};
+
+	template <int N>
+	inline void TriangleBlocks<N>::Build(LinearBVH& bvh, const std::vector<BVHTriangle>& triangles) {
+		blocks.clear();
+		leaves.clear();
+		numTriangles = 0;
+		if (triangles.empty()) return;
+		leaves.assign(bvh.primitiveIndices.size(), TriangleLeaf{ 0, 0 });
+		for (const LinearBVHNode& node : bvh.nodes) {
+			if (node.nPrimitives == 0) continue;
+			auto begin = bvh.primitiveIndices.begin() + node.primitivesOffset;
+			auto triangleEnd = std::stable_partition(begin, begin + node.nPrimitives, [&](int index) { return triangles[index].isTriangle; });
+			TriangleLeaf& leaf = leaves[node.primitivesOffset];
+			leaf.firstBlock = int(blocks.size());
+			leaf.nTriangles = int(triangleEnd - begin);
+			for (int i = 0; i < leaf.nTriangles; i++) {
+				int lane = i % N;
+				if (lane == 0) {
+					blocks.push_back(TriangleBlock<N>());
+					TriangleBlock<N>& block = blocks.back();
+					std::fill(&block.p[0][0][0], &block.p[0][0][0] + 9 * N, Float(0));
+					std::fill(block.primitive, block.primitive + N, -1);
+				}
+				TriangleBlock<N>& block = blocks.back();
+				const BVHTriangle& triangle = triangles[begin[i]];
+				const Point3f* vertices[3] = { &triangle.p0, &triangle.p1, &triangle.p2 };
+				for (int v = 0; v < 3; v++) {
+					for (int axis = 0; axis < 3; axis++) {
+						block.p[v][axis][lane] = (*vertices[v])[axis];
+					}
+				}
+				block.primitive[lane] = node.primitivesOffset + i;
+			}
+			numTriangles += leaf.nTriangles;
+		}
+		if (numTriangles == 0) leaves.clear();
+	}
+}
+
+#endif // QZRT_ACCEL_TRIANGLE_BLOCK_H
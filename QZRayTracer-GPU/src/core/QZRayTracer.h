@@ -11,6 +11,8 @@
 #include <string>
 #include <sstream>
 #include <stdexcept>
+#include <cfloat>
+#include <cmath>
 #include "cuda_runtime.h"
 #include <curand_kernel.h>
 #include <thrust/reduce.h>
@@ -21,6 +21,7 @@
 #include "../shape/flip_normals.h"
 #include "../shape/bvh.h"
 #include "../shape/triangle.h"
+#include "../shape/instance.h"
 #include "../material/lambertian.h"
 #include "../material/metal.h"
 #include "../material/dielectric.h"
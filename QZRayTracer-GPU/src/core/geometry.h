@@ -1055,43 +1055,44 @@ namespace raytracer {
     class Bounds3 {
     public:
         // Bounds3 Public Methods
-        __device__ Bounds3() {
-            T minNum = MinFloat;
-            T maxNum = MaxFloat;
+        __host__ __device__ Bounds3() {
+            // MSVC  MinFloat/MaxFloat  __device__ ˶ֱ FLT_MAX
+            T minNum = -FLT_MAX;
+            T maxNum = FLT_MAX;
             pMin = Point3<T>(maxNum, maxNum, maxNum);
             pMax = Point3<T>(minNum, minNum, minNum);
         }
-        __device__ explicit Bounds3(const Point3<T>& p) : pMin(p), pMax(p) {}
-        __device__ Bounds3(const Point3<T>& p1, const Point3<T>& p2)
+        __host__ __device__ explicit Bounds3(const Point3<T>& p) : pMin(p), pMax(p) {}
+        __host__ __device__ Bounds3(const Point3<T>& p1, const Point3<T>& p2)
             : pMin(Min(p1.x, p2.x), Min(p1.y, p2.y),
                 Min(p1.z, p2.z)),
             pMax(Max(p1.x, p2.x), Max(p1.y, p2.y),
                 Max(p1.z, p2.z)) {
         }
-        __device__ const Point3<T>& operator[](int i) const;
-        __device__ Point3<T>& operator[](int i);
-        __device__ bool operator==(const Bounds3<T>& b) const {
+        __host__ __device__ const Point3<T>& operator[](int i) const;
+        __host__ __device__ Point3<T>& operator[](int i);
+        __host__ __device__ bool operator==(const Bounds3<T>& b) const {
             return b.pMin == pMin && b.pMax == pMax;
         }
-        __device__ bool operator!=(const Bounds3<T>& b) const {
+        __host__ __device__ bool operator!=(const Bounds3<T>& b) const {
             return b.pMin != pMin || b.pMax != pMax;
         }
-        __device__ Point3<T> Corner(int corner) const {
+        __host__ __device__ Point3<T> Corner(int corner) const {
             DCHECK(corner >= 0 && corner < 8);
             return Point3<T>((*this)[(corner & 1)].x,
                 (*this)[(corner & 2) ? 1 : 0].y,
                 (*this)[(corner & 4) ? 1 : 0].z);
         }
-        __device__ Vector3<T> Diagonal() const { return pMax - pMin; }
-        __device__ T SurfaceArea() const {
+        __host__ __device__ Vector3<T> Diagonal() const { return pMax - pMin; }
+        __host__ __device__ T SurfaceArea() const {
             Vector3<T> d = Diagonal();
             return 2 * (d.x * d.y + d.x * d.z + d.y * d.z);
         }
-        __device__ T Volume() const {
+        __host__ __device__ T Volume() const {
             Vector3<T> d = Diagonal();
             return d.x * d.y * d.z;
         }
-        __device__ int MaximumExtent() const {
+        __host__ __device__ int MaximumExtent() const {
             Vector3<T> d = Diagonal();
             if (d.x > d.y && d.x > d.z)
                 return 0;
@@ -1100,29 +1101,33 @@ namespace raytracer {
             else
                 return 2;
         }
-        __device__ Point3<T> Lerp(const Point3f& t) const {
+        __host__ __device__ Point3<T> Lerp(const Point3f& t) const {
             return Point3<T>(Lerp(t.x, pMin.x, pMax.x),
                 Lerp(t.y, pMin.y, pMax.y),
                 Lerp(t.z, pMin.z, pMax.z));
         }
-        __device__ Vector3<T> Offset(const Point3<T>& p) const {
+        __host__ __device__ Vector3<T> Offset(const Point3<T>& p) const {
             Vector3<T> o = p - pMin;
             if (pMax.x > pMin.x) o.x /= pMax.x - pMin.x;
             if (pMax.y > pMin.y) o.y /= pMax.y - pMin.y;
             if (pMax.z > pMin.z) o.z /= pMax.z - pMin.z;
             return o;
         }
-        __device__ void BoundingSphere(Point3<T>* center, Float* radius) const {
+        __host__ __device__ void BoundingSphere(Point3<T>* center, Float* radius) const {
             *center = (pMin + pMax) / 2;
             *radius = Inside(*center, *this) ? Distance(*center, pMax) : 0;
         }
         template <typename U>
-        __device__ explicit operator Bounds3<U>() const {
+        __host__ __device__ explicit operator Bounds3<U>() const {
             return Bounds3<U>((Point3<U>)pMin, (Point3<U>)pMax);
         }
 
-        __device__ bool IntersectP(const Ray& ray, Float* hitt0 = nullptr,
+        __host__ __device__ bool IntersectP(const Ray& ray, Float* hitt0 = nullptr,
             Float* hitt1 = nullptr) const;
+        /// <summary>
+        ///  BVH õİ汾ĵͷÿֻһΣֱȡԶƽ
+        /// </summary>
+        __host__ __device__ inline bool IntersectP(const Ray& ray, const Vector3f& invDir, const int dirIsNeg[3]) const;
 
         // Bounds3 Public Data
         Point3<T> pMin, pMax;
@@ -1135,19 +1140,19 @@ namespace raytracer {
 
 
     template <typename T>
-    __device__ inline const Point3<T>& Bounds3<T>::operator[](int i) const {
+    __host__ __device__ inline const Point3<T>& Bounds3<T>::operator[](int i) const {
         DCHECK(i == 0 || i == 1);
         return (i == 0) ? pMin : pMax;
     }
 
     template <typename T>
-    __device__ inline Point3<T>& Bounds3<T>::operator[](int i) {
+    __host__ __device__ inline Point3<T>& Bounds3<T>::operator[](int i) {
         DCHECK(i == 0 || i == 1);
         return (i == 0) ? pMin : pMax;
     }
 
     template <typename T>
-    __device__ Bounds3<T> Union(const Bounds3<T>& b, const Point3<T>& p) {
+    __host__ __device__ Bounds3<T> Union(const Bounds3<T>& b, const Point3<T>& p) {
         Bounds3<T> ret;
         ret.pMin = Min(b.pMin, p);
         ret.pMax = Max(b.pMax, p);
@@ -1155,7 +1160,7 @@ namespace raytracer {
     }
 
     template <typename T>
-    __device__ Bounds3<T> Union(const Bounds3<T>& b1, const Bounds3<T>& b2) {
+    __host__ __device__ Bounds3<T> Union(const Bounds3<T>& b1, const Bounds3<T>& b2) {
         Bounds3<T> ret;
         ret.pMin = Min(b1.pMin, b2.pMin);
         ret.pMax = Max(b1.pMax, b2.pMax);
@@ -1163,7 +1168,7 @@ namespace raytracer {
     }
 
     template <typename T>
-    __device__ Bounds3<T> Intersect(const Bounds3<T>& b1, const Bounds3<T>& b2) {
+    __host__ __device__ Bounds3<T> Intersect(const Bounds3<T>& b1, const Bounds3<T>& b2) {
         // Important: assign to pMin/pMax directly and don't run the Bounds2()
         // constructor, since it takes min/max of the points passed to it.  In
         // turn, that breaks returning an invalid bound for the case where we
@@ -1175,7 +1180,7 @@ namespace raytracer {
     }
 
     template <typename T>
-    __device__ bool Overlaps(const Bounds3<T>& b1, const Bounds3<T>& b2) {
+    __host__ __device__ bool Overlaps(const Bounds3<T>& b1, const Bounds3<T>& b2) {
         bool x = (b1.pMax.x >= b2.pMin.x) && (b1.pMin.x <= b2.pMax.x);
         bool y = (b1.pMax.y >= b2.pMin.y) && (b1.pMin.y <= b2.pMax.y);
         bool z = (b1.pMax.z >= b2.pMin.z) && (b1.pMin.z <= b2.pMax.z);
@@ -1183,19 +1188,19 @@ namespace raytracer {
     }
 
     template <typename T>
-    __device__ bool Inside(const Point3<T>& p, const Bounds3<T>& b) {
+    __host__ __device__ bool Inside(const Point3<T>& p, const Bounds3<T>& b) {
         return (p.x >= b.pMin.x && p.x <= b.pMax.x && p.y >= b.pMin.y &&
             p.y <= b.pMax.y && p.z >= b.pMin.z && p.z <= b.pMax.z);
     }
 
     template <typename T>
-    __device__ bool InsideExclusive(const Point3<T>& p, const Bounds3<T>& b) {
+    __host__ __device__ bool InsideExclusive(const Point3<T>& p, const Bounds3<T>& b) {
         return (p.x >= b.pMin.x && p.x < b.pMax.x&& p.y >= b.pMin.y &&
             p.y < b.pMax.y&& p.z >= b.pMin.z && p.z < b.pMax.z);
     }
 
     template <typename T, typename U>
-    __device__ inline Bounds3<T> Expand(const Bounds3<T>& b, U delta) {
+    __host__ __device__ inline Bounds3<T> Expand(const Bounds3<T>& b, U delta) {
         return Bounds3<T>(b.pMin - Vector3<T>(delta, delta, delta),
             b.pMax + Vector3<T>(delta, delta, delta));
     }
@@ -1203,7 +1208,7 @@ namespace raytracer {
     // Minimum squared distance from point to box; returns zero if point is
     // inside.
     template <typename T, typename U>
-    __device__ inline Float DistanceSquared(const Point3<T>& p, const Bounds3<U>& b) {
+    __host__ __device__ inline Float DistanceSquared(const Point3<T>& p, const Bounds3<U>& b) {
         Float dx = Max({ Float(0), b.pMin.x - p.x, p.x - b.pMax.x });
         Float dy = Max({ Float(0), b.pMin.y - p.y, p.y - b.pMax.y });
         Float dz = Max({ Float(0), b.pMin.z - p.z, p.z - b.pMax.z });
@@ -1211,7 +1216,7 @@ namespace raytracer {
     }
 
     template <typename T, typename U>
-    __device__ inline Float Distance(const Point3<T>& p, const Bounds3<U>& b) {
+    __host__ __device__ inline Float Distance(const Point3<T>& p, const Bounds3<U>& b) {
         return std::sqrt(DistanceSquared(p, b));
     }
 
@@ -1269,9 +1274,9 @@ namespace raytracer {
     }
 
     template <typename T>
-    __device__ inline bool Bounds3<T>::IntersectP(const Ray& ray, Float* hitt0,
+    __host__ __device__ inline bool Bounds3<T>::IntersectP(const Ray& ray, Float* hitt0,
         Float* hitt1) const {
-        Float t0 = MinFloat, t1 = ray.tMax;
+        Float t0 = -FLT_MAX, t1 = ray.tMax;
         for (int i = 0; i < 3; ++i) {
             // Update interval for _i_th bounding box slab
             Float invRayDir = 1.f / ray.d[i];
@@ -1299,17 +1304,39 @@ namespace raytracer {
         return true;
     }
 
+    template <typename T>
+    __host__ __device__ inline bool Bounds3<T>::IntersectP(const Ray& ray, const Vector3f& invDir, const int dirIsNeg[3]) const {
+        const Bounds3f& bounds = *this;
+        // Check for ray intersection against $x$ and $y$ slabs
+        Float tMin = (bounds[dirIsNeg[0]].x - ray.o.x) * invDir.x;
+        Float tMax = (bounds[1 - dirIsNeg[0]].x - ray.o.x) * invDir.x;
+        Float tyMin = (bounds[dirIsNeg[1]].y - ray.o.y) * invDir.y;
+        Float tyMax = (bounds[1 - dirIsNeg[1]].y - ray.o.y) * invDir.y;
+        if (tMin > tyMax || tyMin > tMax) return false;
+        if (tyMin > tMin) tMin = tyMin;
+        if (tyMax < tMax) tMax = tyMax;
+
+        // Check for ray intersection against $z$ slab
+        Float tzMin = (bounds[dirIsNeg[2]].z - ray.o.z) * invDir.z;
+        Float tzMax = (bounds[1 - dirIsNeg[2]].z - ray.o.z) * invDir.z;
+        if (tMin > tzMax || tzMin > tMax) return false;
+        if (tzMin > tMin) tMin = tzMin;
+        if (tzMax < tMax) tMax = tzMax;
+        return (tMin < ray.tMax) && (tMax > 0);
+    }
+
     
 
 
     class Ray {
     public:
         // Ray Public Methods
-        __device__ Ray() : tMax(Infinity), time(0.f), tMin(ShadowEpsilon) {}
-        __device__ Ray(const Point3f& o, const Vector3f& d,
-            Float time = 0.f, Float tMax = Infinity, Float tMin = ShadowEpsilon)
+        // Ĭϲڵôֵ˹ʱ __device__  INFINITY  ShadowEpsilon ֵ
+        __host__ __device__ Ray() : tMax(INFINITY), time(0.f), tMin(0.0001f) {}
+        __host__ __device__ Ray(const Point3f& o, const Vector3f& d,
+            Float time = 0.f, Float tMax = INFINITY, Float tMin = 0.0001f)
             : o(o), d(d), tMax(tMax), time(time), tMin(tMin) {}
-        __device__ Point3f operator()(Float t) const { return o + d * t; }
+        __host__ __device__ Point3f operator()(Float t) const { return o + d * t; }
         //__device__ bool HasNaNs() const { return (o.HasNaNs() || d.HasNaNs() || isNaN(tMax)); }
         /*friend std::ostream& operator<<(std::ostream& os, const Ray& r) {
             os << "[o=" << r.o << ", d=" << r.d << ", tMax=" << r.tMax
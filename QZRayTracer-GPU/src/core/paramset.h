@@ -15,6 +15,30 @@ namespace raytracer {
 
     };
 
+    /// <summary>
+    /// ·ʲôʱ൯ maxDepth Σ rrStartDepth ֮˹̶ģ
+    /// ˥˻ĸʣ [minSurvival, maxSurvival] ֮䣬·ʲ
+    ///  CPU 汾̶ͬĬϹرգṹֵȾ kernel
+    /// </summary>
+    struct PathTermination {
+        int maxDepth = 10;
+        bool russianRoulette = false;
+        int rrStartDepth = 5;
+        Float minSurvival = 0.05f; // ޱ·Ȩع󣬳
+        Float maxSurvival = 0.95f; // ˥ӽ 1 ·Ҳ
+
+        /// <summary>
+        /// · bounces Ρ˥˻Ϊ throughput ̶֮ġ
+        /// ʱؼĸʣ̶ʱΪ 1߰˥ʱ 0
+        /// </summary>
+        __device__ Float Survive(int bounces, const Point3f& throughput, curandState* local_rand_state) const {
+            if (!russianRoulette || bounces < rrStartDepth) return 1;
+            Float survival = Min(Max(Max(throughput.x, Max(throughput.y, throughput.z)), minSurvival), maxSurvival);
+            // curand_uniform ķΧ (0, 1]
+            return curand_uniform(local_rand_state) <= survival ? survival : 0;
+        }
+    };
+
     class RendererSet {
     public:
         RendererSet(){}
@@ -31,6 +55,7 @@ namespace raytracer {
         int spp;
         const char* savePath;
         Shape** shapes;
+        PathTermination termination;
     };
 
 }
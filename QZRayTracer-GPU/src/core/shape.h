@@ -21,26 +21,136 @@ namespace raytracer {
 		Float u, v;// u,v 
 	};
 
+	class Shape;
+	/// <summary>
+	/// ׶󽻵һ׶εĽϵĲͻеͼԪ
+	/// ۺֻȽϾ롢 tMaxŶͼԪ ComputeSurfaceInteraction д HitRecord
+	/// ͼԪʵռʱ instance ǸʵʵǶףڶ׶Ȱѹ߱任ȥ
+	/// </summary>
+	struct PrimitiveHit {
+		Float t;
+		const Shape* shape = nullptr;
+		const Shape* instance = nullptr;
+
+		__device__ inline bool ComputeSurfaceInteraction(const Ray& ray, HitRecord& rec) const;
+	};
+
+	/// <summary>
+	/// ״ı任״ָָֻ룬ٸԴһ 128 ֽڵ Transform
+	/// λ任ָΪգͬı任ͬһģ͵Σֻһݡ
+	/// 䣬±任ƶеıֻڵ̵߳ĳ˺ʹ
+	/// </summary>
+	struct TransformTable {
+		static const int ChunkSize = 256;
+		struct Chunk {
+			Transform transforms[ChunkSize];
+			Chunk* prev;
+		};
+		Chunk* chunk;
+		int used;
+		int count;
+
+		__device__ const Transform* Add(const Transform& t) {
+			if (count > 0 && chunk->transforms[used - 1] == t) return &chunk->transforms[used - 1];
+			if (!chunk || used == ChunkSize) {
+				Chunk* c = new Chunk;
+				c->prev = chunk;
+				chunk = c;
+				used = 0;
+			}
+			chunk->transforms[used] = t;
+			count++;
+			return &chunk->transforms[used++];
+		}
+		__device__ void Clear() {
+			while (chunk) {
+				Chunk* prev = chunk->prev;
+				delete chunk;
+				chunk = prev;
+			}
+			used = 0;
+			count = 0;
+		}
+	};
+	// ״ı任free_world ʱͳһͷ
+	__device__ static TransformTable sceneTransforms;
+
 	class Shape {
 	public:
 		Material* material = nullptr;
-		int left = -1;
-		int right = -1;
-		Bounds3f box;
-		Transform transform;
+		const Transform* transform = nullptr; // ָ sceneTransforms ınullptr ʾλ任
 		int numShapes = 0;
-		int numNodes = 0;
 
-		// flag={-1,0,1,2}; 
-		// -1(ʾͨShapeûҺ)
-		// 0(ʾBVHNodeҺΪ)
-		// 1(ʾBVHNodeֻ)
-		// 2(ʾBVHNodeֻҺ)
+		// flag={-1,0,1,2};
+		// -1(ʾͨShape)
+		// 0(ʾBVHAccel)
+		// 1(ʾTriangleBVH Ҷﲻ麯ֱ)
+		// 2(ʾInstanceһռ BLAS)
 		int flag = -1;
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec)const = 0;
+		/// <summary>
+		/// һ׶Σֻ ray.tMax ֮ǰĽϵĲͼԪ uvߣҲ任㡣
+		/// ֻڻʱд hitĬ˻ Hitý㻻ߵĲ
+		/// </summary>
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit)const {
+			HitRecord rec;
+			if (!Hit(ray, rec)) return false;
+			Float t = Dot(rec.p - ray.o, ray.d) / Dot(ray.d, ray.d);
+			if (t >= ray.tMax) return false;
+			hit.t = t;
+			hit.shape = this;
+			return true;
+		}
+		/// <summary>
+		/// ڶ׶ΣΪһ׶ҵĽд HitRecordÿֻͼԪһΡ
+		/// Ĭµ HitľͼԪĽ㣬rec.t0rec.t1 Ҳֱӵ Hit ʱһ
+		///  false ʱ rec Ч߰ûдÿ󽻽ͬͼԪ ConstantMediumҪԼʵ׶
+		/// </summary>
+		__device__ virtual bool ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec)const {
+			return Hit(ray, rec);
+		}
+		/// <summary>
+		/// ڵѯ ray.tMaxߵĲ֮ǰûн㣬ҵһͷأ㽻㡢ߡuv Ͳʣ
+		/// ӰߡڱεֻҪɼԵĲѯʹá
+		/// Ĭ˻ Hit״ rec.t Լľֲռ䣬ý㻻ߵĲٺ tMax Ƚ
+		/// </summary>
+		__device__ virtual bool IntersectP(const Ray& ray)const {
+			HitRecord rec;
+			if (!Hit(ray, rec)) return false;
+			return Dot(rec.p - ray.o, ray.d) < ray.tMax * Dot(ray.d, ray.d);
+		}
 		__device__ virtual bool BoundingBox(Bounds3f& box)const = 0;
+
+		/// <summary>
+		///  time0time1 ʱ̵İΧУ˶ģ BVH ֮Բֵ
+		/// ĬǾֹͼԪʱ̶ BoundingBox˶ͼԪҪ֤мʱֵ̱ס
+		/// </summary>
+		__device__ virtual bool MotionBoundingBox(Float time0, Float time1, Bounds3f& box0, Bounds3f& box1)const {
+			if (!BoundingBox(box0)) return false;
+			box1 = box0;
+			return true;
+		}
+
+		/// <summary>
+		/// ʱǼ״ı任λ任ռʱ ObjectToWorldWorldToObject ԭأʡߵı任
+		/// </summary>
+		__device__ void SetTransform(const Transform& t) {
+			transform = t.IsIdentity() ? nullptr : sceneTransforms.Add(t);
+		}
+		template <typename T>
+		__device__ inline T ObjectToWorld(const T& x) const {
+			return transform ? (*transform)(x) : x;
+		}
+		template <typename T>
+		__device__ inline T WorldToObject(const T& x) const {
+			return transform ? transform->ApplyInverse(x) : x;
+		}
 	};
 
+	__device__ inline bool PrimitiveHit::ComputeSurfaceInteraction(const Ray& ray, HitRecord& rec) const {
+		return (instance ? instance : shape)->ComputeSurfaceInteraction(ray, *this, rec);
+	}
+
 }
 
 #endif // QZRT_CORE_SHAPE_H
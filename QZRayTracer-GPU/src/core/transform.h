@@ -103,6 +103,13 @@ namespace raytracer {
         __host__ __device__ inline Vector3<T> operator()(const Vector3<T>& v) const;
         template <typename T>
         __host__ __device__ inline Normal3<T> operator()(const Normal3<T>&) const;
+        /// <summary>
+        /// 任 Inverse(*this)(p) һȸƳһ Transform
+        /// </summary>
+        template <typename T>
+        __host__ __device__ inline Point3<T> ApplyInverse(const Point3<T>& p) const;
+        template <typename T>
+        __host__ __device__ inline Vector3<T> ApplyInverse(const Vector3<T>& v) const;
 
         __device__ Bounds3f operator()(const Bounds3f& b) const;
         __host__ __device__ Transform operator*(const Transform& t2) const;
@@ -249,6 +256,28 @@ namespace raytracer {
      }
 
 
+     template <typename T>
+     __host__ __device__ inline Point3<T> Transform::ApplyInverse(const Point3<T>& p) const {
+         T x = p.x, y = p.y, z = p.z;
+         T xp = mInv.m[0][0] * x + mInv.m[0][1] * y + mInv.m[0][2] * z + mInv.m[0][3];
+         T yp = mInv.m[1][0] * x + mInv.m[1][1] * y + mInv.m[1][2] * z + mInv.m[1][3];
+         T zp = mInv.m[2][0] * x + mInv.m[2][1] * y + mInv.m[2][2] * z + mInv.m[2][3];
+         T wp = mInv.m[3][0] * x + mInv.m[3][1] * y + mInv.m[3][2] * z + mInv.m[3][3];
+         if (wp == 0)return Point3f(p);
+         if (wp == 1)
+             return Point3<T>(xp, yp, zp);
+         else
+             return Point3<T>(xp, yp, zp) / wp;
+     }
+
+     template <typename T>
+     __host__ __device__ inline Vector3<T> Transform::ApplyInverse(const Vector3<T>& v) const {
+         T x = v.x, y = v.y, z = v.z;
+         return Vector3<T>(mInv.m[0][0] * x + mInv.m[0][1] * y + mInv.m[0][2] * z,
+             mInv.m[1][0] * x + mInv.m[1][1] * y + mInv.m[1][2] * z,
+             mInv.m[2][0] * x + mInv.m[2][1] * y + mInv.m[2][2] * z);
+     }
+
      __device__ inline Bounds3f Transform::operator()(const Bounds3f& b) const {
          const Transform& M = *this;
          Bounds3f ret(M(Point3f(b.pMin.x, b.pMin.y, b.pMin.z)));
@@ -19,27 +19,54 @@ namespace raytracer {
 		}
 	}
 
+	/// <summary>
+	/// ͷųʵõ BLASʵܹһ BLASռظģÿֻͷһΣ
+	/// ʵûвʣɵߺͼԪһ delete
+	/// </summary>
+	__device__ void FreeInstanceObjects(Shape** d_list, int numShapes) {
+		int numInstances = 0;
+		for (int i = 0; i < numShapes; i++) numInstances += d_list[i]->flag == 2;
+		if (numInstances == 0) return;
+		const Shape** objects = new const Shape * [numInstances];
+		int numObjects = 0;
+		for (int i = 0; i < numShapes; i++) {
+			if (d_list[i]->flag != 2) continue;
+			const Shape* object = ((const Instance*)d_list[i])->object;
+			int j = 0;
+			while (j < numObjects && objects[j] != object) j++;
+			if (j == numObjects) objects[numObjects++] = object;
+		}
+		for (int i = 0; i < numObjects; i++) FreeMeshBVH(objects[i]);
+		delete[] objects;
+	}
+
 	__global__ void free_world(Shape** d_list, Shape** d_world, Camera** d_camera) {
 		printf("free_world! n:%d\n", (*d_world)->numShapes);
+		FreeInstanceObjects(d_list, (*d_world)->numShapes);
 		for (int i = 0; i < (*d_world)->numShapes; i++) {
-			delete d_list[i]->material->albedo;
-			delete d_list[i]->material;
+			if (d_list[i]->flag != 2) {
+				delete d_list[i]->material->albedo;
+				delete d_list[i]->material;
+			}
 			delete d_list[i];
 		}
 		delete* d_world;
 		delete* d_camera;
+		sceneTransforms.Clear();
 	}
 
 	
 	__global__ void free_world_bvh(Shape** d_list, Shape** d_world, Camera** d_camera) {
 		int numShapes = (*d_world)->numShapes;
+		FreeInstanceObjects(d_list, numShapes);
 		for (int i = 0; i < numShapes; i++) {
 			// delete d_list[i]->material->albedo;
-			delete d_list[i]->material;
+			if (d_list[i]->flag != 2) delete d_list[i]->material;
 			delete d_list[i];
 		}
-		//DeleteBVHNode(d_nodes, (*d_world)->numNodes);
+		delete* d_world;
 		delete* d_camera;
+		sceneTransforms.Clear();
 	}
 
 	
@@ -75,7 +102,7 @@ namespace raytracer {
 
 	
 
-	__global__ void SampleScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void SampleScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -157,7 +184,7 @@ namespace raytracer {
 		}
 	}
 
-	__global__ void Chapter1MotionBlurScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter1MotionBlurScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -219,13 +246,13 @@ namespace raytracer {
 			shapes[curNum++] = new Sphere(Point3f(4, 1, 0), 1.0, new Metal(new ConstantTexture(Point3f(0.7, 0.6, 0.5)), 0.0));
 			*rand_state = local_rand_state;
 
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f); // ʹBVH 100s spp 1000
+			*world = CreateBVHAccel(shapes, curNum); // ʹBVH 100s spp 1000
 			int n = (*world)->numShapes;
 			printf("n:%d\n", n);
 		}
 	}
 
-	__global__ void ShapeTestCylinderScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void ShapeTestCylinderScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -357,7 +384,7 @@ namespace raytracer {
 	
 
 
-	__global__ void Chapter2BVHScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter2BVHScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -426,14 +453,14 @@ namespace raytracer {
 
 			*rand_state = local_rand_state;
 
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f); // ʹBVH 100s spp 1000
+			*world = CreateBVHAccel(shapes, curNum); // ʹBVH 100s spp 1000
 			//*world = new ShapeList(shapes, curNum);// ʹBVH 675s spp 1000
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void Chapter3TextureScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter3TextureScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -503,14 +530,14 @@ namespace raytracer {
 
 			*rand_state = local_rand_state;
 
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f); // ʹBVH 100s spp 1000
+			*world = CreateBVHAccel(shapes, curNum); // ʹBVH 100s spp 1000
 			//*world = new ShapeList(shapes, curNum);// ʹBVH 675s spp 1000
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void Chapter3TextureScene2(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter3TextureScene2(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 
@@ -538,13 +565,13 @@ namespace raytracer {
 
 			*rand_state = local_rand_state;
 
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f); // ʹBVH 100s spp 1000
+			*world = CreateBVHAccel(shapes, curNum); // ʹBVH 100s spp 1000
 			//*world = new ShapeList(shapes, curNum);// ʹBVH 675s spp 1000
 			printf("Create World Successful!\n");
 		}
 	}
 
-	__global__ void Chapter4NoiseScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter4NoiseScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -574,14 +601,14 @@ namespace raytracer {
 
 			*rand_state = local_rand_state;
 
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f); // ʹBVH 100s spp 1000
+			*world = CreateBVHAccel(shapes, curNum); // ʹBVH 100s spp 1000
 			//*world = new ShapeList(shapes, curNum);// ʹBVH 675s spp 1000
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void Chapter5ImageScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter5ImageScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -610,13 +637,13 @@ namespace raytracer {
 
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f); 
+			*world = CreateBVHAccel(shapes, curNum); 
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void Chapter6LightScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter6LightScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -646,13 +673,13 @@ namespace raytracer {
 
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void Chapter6LightScene2(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter6LightScene2(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -686,13 +713,13 @@ namespace raytracer {
 
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void Chapter7InstancesScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter7InstancesScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -730,14 +757,14 @@ namespace raytracer {
 
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
 
-	__global__ void Chapter7InstancesScene2(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter7InstancesScene2(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -811,13 +838,13 @@ namespace raytracer {
 			shapes[curNum++] = new Cylinder(Point3f(0.f, 0.f, 0.f), 1.f, 0.f, 1.f, new Lambertian(new ConstantTexture(Point3f(0.0f, 0.9f, 0.0f))), t12);
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void Chapter7InstancesScene3(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter7InstancesScene3(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -859,14 +886,14 @@ namespace raytracer {
 			shapes[curNum++] = new Box(Point3f(0.f, 0.f, 0.f), Point3f(1.f, 1.f, 1.f), new Metal(imgtext, 0.2f), t01);
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
 
-	__global__ void Chapter8VolumeScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter8VolumeScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -910,14 +937,14 @@ namespace raytracer {
 			//shapes[curNum++] = new Box(Point3f(0.f, 0.f, 0.f), Point3f(1.f, 1.f, 1.f), new Metal(imgtext, 0.2f), t01);
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
 
-	__global__ void Chapter8VolumeScene2(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void Chapter8VolumeScene2(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -984,12 +1011,12 @@ namespace raytracer {
 
 
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
-	__global__ void TestScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void TestScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -1034,12 +1061,12 @@ namespace raytracer {
 
 			 //shapes[curNum++] = new Sphere(Point3f(250, 200, 400), 50, new Lambertian(imgtext));
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
-	__global__ void RTNWScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void RTNWScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -1103,13 +1130,13 @@ namespace raytracer {
 			}
 
 			* rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
-	__global__ void RTNWScene2(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void RTNWScene2(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -1184,14 +1211,14 @@ namespace raytracer {
 
 			*rand_state = local_rand_state;
 			//*world = new ShapeList(shapes, curNum);
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
 
 
-	__global__ void SkyBoxScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void SkyBoxScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image/*, cudaPitchedPtr image2*/) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -1241,7 +1268,7 @@ namespace raytracer {
 
 
 
-	__global__ void ModelScene(Shape** shapes, Shape** nodes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+	__global__ void ModelScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
 		cudaPitchedPtr image, TriangleMesh** meshs, int numModels) {
 		if (threadIdx.x == 0 && blockIdx.x == 0) {
 			curandState local_rand_state = *rand_state;
@@ -1280,14 +1307,73 @@ namespace raytracer {
 			shapes[curNum++] = new Sphere(new DiffuseLight(imgtext), Translate(Vector3f(0, -1500, 0)) * RotateY(180) * Scale(1500, 1500, 1500));
 			Float size = 65;
 			Float Rotate = 180;
-			CreateModel(shapes, meshs[0], curNum, metal, Translate(Vector3f(0, 65, 0)) * RotateY(Rotate) * Scale(size, size, size));
+			Shape* model = CreateMeshBVH(meshs[0], metal); // ģռｨһ BLASֻʵ
+			shapes[curNum++] = new Instance(model, Translate(Vector3f(0, 65, 0)) * RotateY(Rotate) * Scale(size, size, size));
 			printf("Shape Num: %d!\n", curNum);
 			*rand_state = local_rand_state;
-			*world = CreateBVHNode(shapes, curNum, nodes, &local_rand_state, 0.f, 0.f);
+			*world = CreateBVHAccel(shapes, curNum);
+			printf("Create World Successful!\n");
+		}
+	}
+
+	/// <summary>
+	///  BVH ӣͬһģͰڷ nx * nz Σκ BLAS ֻһݣ BVH ÿʵһͼԪ
+	/// </summary>
+	__global__ void ModelInstancesScene(Shape** shapes, Shape** world, Camera** camera, int width, int height, curandState* rand_state,
+		cudaPitchedPtr image, TriangleMesh** meshs, int numModels) {
+		if (threadIdx.x == 0 && blockIdx.x == 0) {
+			curandState local_rand_state = *rand_state;
+			Point3f lookFrom = Point3f(600, 400, -900.0);
+			Point3f lookAt = Point3f(0, 10, 0);
+			Vector3f lookUp = Vector3f(0, 1, 0);
+			Float aperture = 0.0f;
+			Float fov = 40.0f;
+			Float focusDis = 10.0f;
+			Float screenWidth = width;
+			Float screenHeight = height;
+			Float aspect = screenWidth / screenHeight;
+			*camera = new Camera(lookFrom, lookAt, lookUp, fov, aspect, aperture, focusDis, 0.0f, 1.0f);
+
+			int curNum = 0; // ¼Shape
+			Texture* imgtext = new ImageTexture((unsigned char*)image.ptr, image.xsize, image.ysize);
+			Material* metal = new Metal(new ConstantTexture(Point3f(1.f, 1.f, 1.f)), 0.2f);
+			Material* lamber = new Lambertian(new ConstantTexture(Point3f(0.8f, 0.3f, 0.3f)));
+
+			shapes[curNum++] = new XZRect(new Lambertian(new CheckerTexture(new ConstantTexture(Point3f(0.73f, 0.73f, 0.73f)), new ConstantTexture(Point3f(0.1f, 0.1f, 0.1f)), 500)), Scale(1000, 1, 1000));
+			shapes[curNum++] = new Sphere(new DiffuseLight(imgtext), Translate(Vector3f(0, -3000, 0)) * RotateY(180) * Scale(3000, 3000, 3000));
+
+			Shape* metalModel = CreateMeshBVH(meshs[0], metal);
+			Shape* lamberModel = CreateMeshBVH(meshs[0], lamber);
+			Float size = 40;
+			int nx = 8, nz = 8;
+			for (int i = 0; i < nx; i++) {
+				for (int j = 0; j < nz; j++) {
+					Shape* model = (i + j) % 2 == 0 ? metalModel : lamberModel;
+					Vector3f offset = Vector3f((i - (nx - 1) * 0.5f) * 120, size, (j - (nz - 1) * 0.5f) * 120);
+					shapes[curNum++] = new Instance(model, Translate(offset) * RotateY(180 + 30 * (i * nz + j)) * Scale(size, size, size));
+				}
+			}
+			printf("Shape Num: %d, Triangles: %d!\n", curNum, 2 * meshs[0]->nTriangles);
+			*rand_state = local_rand_state;
+			*world = CreateBVHAccel(shapes, curNum);
 			printf("Create World Successful!\n");
 		}
 	}
 
+	/// <summary>
+	/// ת̨һ֡shapes[first, first + count) ʵռ y ת angle ȡ
+	/// ֻʵı任BLAS 䣻֮˵ SceneBVH::Refit ¶ BVH İΧ
+	/// </summary>
+	__global__ void RotateInstances(Shape** shapes, int first, int count, Float angle) {
+		if (threadIdx.x == 0 && blockIdx.x == 0) {
+			Transform rotate = RotateY(angle);
+			for (int i = first; i < first + count; i++) {
+				Shape* shape = shapes[i];
+				shape->SetTransform(shape->transform ? *shape->transform * rotate : rotate);
+			}
+		}
+	}
+
 
 
 
@@ -11,10 +11,11 @@ namespace raytracer {
 	public:
 
 		// Bounds3 Public Data
+		Bounds3f box; // ֲռĺ
 		Shape* cube = nullptr;
 		__device__ Box() {}
 		__device__ Box(const Point3f& p0, const Point3f& p1, Material* _mat, const  Transform& _trans = Transform()) {
-			transform = _trans;
+			SetTransform(_trans);
 			box = Bounds3f(p0, p1);
 
 			/*printf("p0:[%f,%f,%f],p1:[%f,%f,%f] \n After tranform:[%f,%f,%f], [%f,%f,%f]\n",
@@ -31,6 +32,8 @@ namespace raytracer {
 		}
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
@@ -39,8 +42,7 @@ namespace raytracer {
 	};
 	__device__ inline bool Box::Hit(const Ray& ray, HitRecord& rec) const {
 		//printf("Hiting Box......................\n");
-		Transform invTransform = Inverse(transform);
-		Ray tansRay = Ray(invTransform(ray.o), invTransform(Normalize(ray.d)));
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(Normalize(ray.d)));
 
 
 
@@ -91,7 +93,7 @@ namespace raytracer {
 			rec.p[axis] = box.pMin[axis];
 		else
 			rec.p[axis] = box.pMax[axis];
-		rec.p = transform(rec.p);
+		rec.p = ObjectToWorld(rec.p);
 		if (axis == 0) {
 			rec.u = (hitP.y - box.pMin.y) / (box.pMax.y - box.pMin.y);
 			rec.v = (hitP.z - box.pMin.z) / (box.pMax.z - box.pMin.z);
@@ -112,14 +114,14 @@ namespace raytracer {
 		//}
 		Normal3f normal = Normalize(Normal3f(tansRay.o - hitP));
 		//printf("normal:%f, %f, %f\n", normal.x, normal.y, normal.z);
-		rec.normal = Normalize(transform(normal));
+		rec.normal = Normalize(ObjectToWorld(normal));
 		//printf("t0 : %f, t1 : %f\n", t0, t1);
 		return true;
 
 
 		/*if (cube->Hit(tansRay, rec)) {
-			rec.p = transform(rec.p);
-			rec.normal = Normalize(transform(rec.normal));
+			rec.p = ObjectToWorld(rec.p);
+			rec.normal = Normalize(ObjectToWorld(rec.normal));
 			return true;
 		}
 		else {
@@ -128,8 +130,41 @@ namespace raytracer {
 		/*return cube->Hit(ray, rec);*/
 	}
 
+	/// <summary>
+	///  Hit ͬ slab ԣֻȽϾ룬󽻵ڵ
+	/// </summary>
+	__device__ inline bool Box::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float dLength = ray.d.Length();
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d / dLength));
+		Float t0 = tansRay.tMin, t1 = tansRay.tMax;
+		for (int i = 0; i < 3; ++i) {
+			Float invRayDir = 1.f / tansRay.d[i];
+			Float tNear = (box.pMin[i] - tansRay.o[i]) * invRayDir;
+			Float tFar = (box.pMax[i] - tansRay.o[i]) * invRayDir;
+			if (tNear > tFar) {
+				Float temp = tNear;
+				tNear = tFar;
+				tFar = temp;
+			}
+			if (tNear > t0) t0 = tNear;
+			if (tFar < t1) t1 = tFar;
+			if (t0 > t1) return false;
+		}
+		if (t0 < 0 || t1 > tansRay.tMax) return false;
+		Float tShapeHit = t0 > tansRay.tMin + ShadowEpsilon ? t0 : t1;
+		if (tShapeHit >= ray.tMax * dLength) return false;
+		hit.t = tShapeHit / dLength;
+		hit.shape = this;
+		return true;
+	}
+
+	__device__ inline bool Box::IntersectP(const Ray& ray) const {
+		PrimitiveHit hit;
+		return Intersect(ray, hit);
+	}
+
 	__device__ inline bool Box::BoundingBox(Bounds3f& box) const {
-		box = transform(this->box);
+		box = ObjectToWorld(this->box);
 		return true;
 	}
 }
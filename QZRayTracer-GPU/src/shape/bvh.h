@@ -1,600 +1,641 @@
 #ifndef QZRT_CORE_BVH_H
 #define QZRT_CORE_BVH_H
 
+#include <set>
 #include "../core/shape.h"
-//#define BVH_DEBUG_INFO
+#include "../accel/linear_bvh.h"
+#include "../accel/compressed_bvh.h"
+#include "../accel/triangle_block.h"
+#include "../accel/bvh_benchmark.h"
+#include "shapeList.h"
+#include "triangle.h"
+#include "instance.h"
 
-#define STACKSIZE 20000
+//#define BVH_STATS // ʱλֽһߵ SAH Ա
+//#define BVH_BENCHMARK // ʱ˱ȽϸֹʽĹʱ䡢ʱ䣬ֽڵ㲼ֵĻȱʧѹڵڴٶȣԼڵѯٶ
 
 namespace raytracer {
-
-	__device__ inline int BoxCompareOnAxisX(const void* a, const void* b);
-	__device__ inline int BoxCompareOnAxisY(const void* a, const void* b);
-	__device__ inline int BoxCompareOnAxisZ(const void* a, const void* b);
-
-
-
-	class BVHNode :public Shape {
+	/// <summary>
+	/// BVH ٽṹڵ˹õ LinearBVHNode 飬Ϊÿڵ new һ Shape
+	/// ʱֻ 32 ֽڽڵ㣬ҶֱðҶ˳е shapes
+	/// ˺ CreateBVHAccel ʱûнڵ㣬˻Ϊ󽻣
+	/// ˵ SceneBVH::Build Ͻڵ
+	/// </summary>
+	class BVHAccel :public Shape {
 	public:
-		/*Shape* left;
-		Shape* right;*/
-		//Bounds3f box;
-		//int flag; //flag=0ûãflag=1ãûãflag=2ջ
-		//int numShapes;
-
-		Shape** nodes = nullptr;
-		Shape** shapes = nullptr;
-
-		__device__ BVHNode() {}
-		__device__ BVHNode(Shape** shapes, int n, Shape** nodes, Float time0 = 0.f, Float time1 = 1.f);
+		Shape** shapes = nullptr;      // Ҷ˳еͼԪSBVH ͬһͼԪֶܳ
+		Shape** primitives = nullptr;  // ʱͼԪ飬˳򲻱䣬SceneBVH ȡͼԪ
+		const LinearBVHNode* nodes = nullptr;
+		const CompressedBVHNode* compressedNodes = nullptr; // BVHBuildOptions::compressNodes ʱ nodes box Ϊڵϵ
+		const LinearBVHMotionBounds* motionBounds = nullptr; // ˶ģ BVH УʱֵڵΧ
+		const TriangleBlock<TRIANGLE_BLOCK_WIDTH>* triangleBlocks = nullptr; // BVHBuildOptions::triangleBlocks ʱҶ
+		const TriangleLeaf* triangleLeaves = nullptr; // ҶӵһͼԪλΪʱ
+		Float shutterOpen = 0, invShutterLength = 1;
+		Bounds3f box; // ڵİΧУҲѹڵϵ
+		int numNodes = 0;
+
+		__device__ BVHAccel(Shape** shapes, int n) {
+			this->shapes = shapes;
+			primitives = shapes;
+			numShapes = n;
+			flag = 0; // Ϊ BVHSceneBVH ݴжǷҪ
+		}
 
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec)const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit)const override;
+		__device__ virtual bool IntersectP(const Ray& ray)const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
 
-
+		// ͨ Shape ̳УΪ BLAS ʵʱڵڿ˵İΧ
+		__device__ virtual bool MotionBoundingBox(Float t0, Float t1, Bounds3f& box0, Bounds3f& box1) const override;
 	};
 
-	__device__ inline BVHNode::BVHNode(Shape** shapes, int n, Shape** nodes, Float time0, Float time1) {
-		numShapes = n;
-		flag = 0;
-		this->nodes = nodes;
-		this->shapes = shapes;
+	__device__ inline bool BVHAccel::Hit(const Ray& ray, HitRecord& rec) const {
+		PrimitiveHit hit;
+		if (!Intersect(ray, hit)) return false;
+		return hit.ComputeSurfaceInteraction(ray, rec);
 	}
 
-	__device__ inline bool BVHNode::Hit(const Ray& ray, HitRecord& rec) const {
-		//printf("Hit BVHNode!\n");
-		// ջ
-		//thrust::device_vector<int> stack;
-		int stack[20];
-		int sp = 0;
-		stack[sp++] = 0;
-		//stack.push_back(sp);
-		bool isHit = false;
-		rec.t = Infinity;
-		while (sp > 0) {
-			//printf("Hit BVHNode! sp: %d\n", sp);
-			int top = stack[--sp];
-			//int top = stack.back();
-			//stack.pop_back();
-			Shape* node = nodes[top];
-
-			if (node->box.IntersectP(ray)) { // box
-				// Ҷӽڵ㣬ֱӵShapeĻз
-				if (node->flag == 3) { 
-					int L = node->left;
-					int R = node->right;
-					HitRecord leftRec, rightRec;
-					bool hitLeft = shapes[L]->Hit(ray, leftRec);
-					bool hitRight = shapes[R]->Hit(ray, rightRec);
-					/* ҶڵҲֱӷأеĽǴ
-					* ڲõջǵݹ飬˺ܶƻһЩ
-					* ǻ˵ǰӵĳshapeʱһпԻиһshapeڹBVHʱ
-					* ֵܺ߱һСжʱΪǸȻУǺԵǸСӣ¸ǸshapeԵ
-					* ˳кûпֱӺԵҪӽڵ󽻣õshape
-					*/ 
-					if (hitLeft && hitRight) {
-						if (leftRec.t < rightRec.t && leftRec.t < rec.t) {
-							rec = leftRec;
-						}
-						else if(leftRec.t >= rightRec.t && rightRec.t < rec.t) {
-							rec = rightRec;
-						}
-						isHit = true;
-					}
-					else if (hitLeft) {
-						if (leftRec.t < rec.t) {
-							rec = leftRec;
-						}
-						isHit = true;
-					}
-					else if (hitRight) {
-						if (rightRec.t < rec.t) {
-							rec = rightRec;
-						}
-						isHit = true;
-					}
+	/// <summary>
+	/// ʱҶͼԪֻߵĲҵĽ tMaxuvߡ任ͼԪ
+	/// Ҷǰγɿ󽻣β麯ʵ̺ tMax  BLAS޳ԶĽڵ
+	/// </summary>
+	__device__ inline bool BVHAccel::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		WatertightRay watertight = triangleLeaves ? WatertightRay(ray) : WatertightRay();
+		auto intersect = [&](int first, int count, Float& tMax) {
+			bool found = false;
+			if (triangleLeaves) {
+				const TriangleLeaf& leaf = triangleLeaves[first];
+				int slot = IntersectTriangleLeaf(triangleBlocks, leaf, watertight, tMax);
+				if (slot >= 0) {
+					hit = PrimitiveHit();
+					hit.t = tMax;
+					hit.shape = shapes[slot];
+					found = true;
 				}
-				else {
-					bool leftHit = nodes[node->left]->box.IntersectP(ray);
-					bool rightHit = nodes[node->right]->box.IntersectP(ray);
-					if (leftHit && rightHit) {
-						stack[sp++] = node->right;
-						stack[sp++] = node->left;
-						//stack.push_back(node->right);
-						//stack.push_back(node->left);
-					}
-					else if (leftHit) {
-						stack[sp++] = node->left;
-						//stack.push_back(node->left);
-					}
-					else if (rightHit) {
-						stack[sp++] = node->right;
-						//stack.push_back(node->right);
-					}
+				first += leaf.nTriangles;
+				count -= leaf.nTriangles;
+			}
+			for (int i = first; i < first + count; i++) {
+				Ray r = Ray(ray.o, ray.d, ray.time, tMax, ray.tMin);
+				PrimitiveHit candidate;
+				bool hitShape = shapes[i]->flag == 1 ? static_cast<const Triangle*>(shapes[i])->Triangle::Intersect(r, candidate)
+					: shapes[i]->Intersect(r, candidate);
+				if (!hitShape) continue;
+				tMax = candidate.t;
+				hit = candidate;
+				found = true;
+			}
+			return found;
+		};
+		if (compressedNodes) {
+			return IntersectCompressedBVH(compressedNodes, box, ray, intersect);
+		}
+		if (!nodes) {
+			Float tMax = ray.tMax;
+			return intersect(0, numShapes, tMax);
+		}
+		// ֮ʱû壬ضϵֵ֤İΧǱص
+		Float time = motionBounds ? Min(Max((ray.time - shutterOpen) * invShutterLength, Float(0)), Float(1)) : 0;
+		return IntersectLinearBVH(nodes, ray, intersect, motionBounds, time);
+	}
+
+	/// <summary>
+	/// ڵѯ Hit ͬıҶκͼԪ ray.tMax ֮ǰоͽ
+	/// 㽻롢̹ߣҲβ rec
+	/// </summary>
+	__device__ inline bool BVHAccel::IntersectP(const Ray& ray) const {
+		WatertightRay watertight = triangleLeaves ? WatertightRay(ray) : WatertightRay();
+		auto intersect = [&](int first, int count, Float& tMax) {
+			if (triangleLeaves) {
+				const TriangleLeaf& leaf = triangleLeaves[first];
+				Float tHit = ray.tMax;
+				if (IntersectTriangleLeaf(triangleBlocks, leaf, watertight, tHit, true) >= 0) return true;
+				first += leaf.nTriangles;
+				count -= leaf.nTriangles;
+			}
+			for (int i = first; i < first + count; i++) {
+				if (shapes[i]->flag == 1) {
+					Float tLocal, b[3];
+					if (static_cast<const Triangle*>(shapes[i])->Intersect(ray, tLocal, b)) return true;
+				}
+				else if (shapes[i]->IntersectP(ray)) {
+					return true;
 				}
 			}
-			
+			return false;
+		};
+		if (compressedNodes) {
+			return IntersectCompressedBVH(compressedNodes, box, ray, intersect, true);
+		}
+		if (!nodes) {
+			Float tMax = ray.tMax;
+			return intersect(0, numShapes, tMax);
 		}
-		if (isHit) return true;
-		return false;
+		Float time = motionBounds ? Min(Max((ray.time - shutterOpen) * invShutterLength, Float(0)), Float(1)) : 0;
+		return IntersectLinearBVH(nodes, ray, intersect, motionBounds, time, true);
 	}
 
-	__device__ inline bool BVHNode::BoundingBox(Bounds3f& box) const {
+	__device__ inline bool BVHAccel::BoundingBox(Bounds3f& box) const {
 		box = this->box;
 		return true;
 	}
 
-	__device__ inline int BoxCompareOnAxisX(const void* a, const void* b) {
-		//printf("Stacking BoxCompareOnAxisX...\n");
-		Bounds3f boxLeft, boxRight;
-		Shape* aShapes = *(Shape**)a;
-		Shape* bShapes = *(Shape**)b;
-		if (!aShapes->BoundingBox(boxLeft) || !bShapes->BoundingBox(boxRight)) {
-			boxLeft = Bounds3f();
-			boxRight = Bounds3f();
-		}
-		if (boxLeft.pMin.x - boxRight.pMin.x < 0.f) {
-			return -1;
-		}
-		else {
-			return 1;
-		}
+	__device__ inline bool BVHAccel::MotionBoundingBox(Float t0, Float t1, Bounds3f& box0, Bounds3f& box1) const {
+		if (!motionBounds) return BoundingBox(box0) && BoundingBox(box1);
+		box0 = motionBounds[0].bounds0;
+		box1 = motionBounds[0].bounds1;
+		return true;
 	}
 
-	__device__ inline int BoxCompareOnAxisY(const void* a, const void* b) {
-		//printf("Stacking BoxCompareOnAxisY...\n");
-		Bounds3f boxLeft, boxRight;
-		Shape* aShapes = *(Shape**)a;
-		Shape* bShapes = *(Shape**)b;
-		if (!aShapes->BoundingBox(boxLeft) || !bShapes->BoundingBox(boxRight)) {
-			boxLeft = Bounds3f();
-			boxRight = Bounds3f();
-		}
-		if (boxLeft.pMin.y - boxRight.pMin.y < 0.f) {
-			return -1;
+	__device__ inline Shape* CreateBVHAccel(Shape** shapes, int n) {
+		return new BVHAccel(shapes, n);
+	}
+
+	/// <summary>
+	/// Ϊ񴴽ռ BLASβ任Žʱ Instance ã
+	/// ͬһڷŶٴζֻһκһ BVHָ豸ϣ BLAS פ
+	/// </summary>
+	__device__ inline Shape* CreateMeshBVH(TriangleMesh* mesh, Material* mat) {
+		Shape** triangles = new Shape * [mesh->nTriangles];
+		int n = 0;
+		CreateModel(triangles, mesh, n, mat);
+		return CreateBVHAccel(triangles, n);
+	}
+
+	/// <summary>
+	/// ͷ CreateMeshBVH  BLASΡǹõĲʡָ BVHAccel 
+	/// ڵ豸ڴ SceneBVH::Free ͷšʵʱֻܵһ
+	/// </summary>
+	__device__ inline void FreeMeshBVH(const Shape* blas) {
+		if (blas->flag == 0) {
+			const BVHAccel* bvh = (const BVHAccel*)blas;
+			if (bvh->numShapes > 0) delete bvh->primitives[0]->material;
+			for (int i = 0; i < bvh->numShapes; i++) delete (const Triangle*)bvh->primitives[i];
+			delete[] bvh->primitives;
+			delete bvh;
 		}
 		else {
-			return 1;
+			delete blas->material;
+			delete blas;
 		}
 	}
 
-	__device__ inline int BoxCompareOnAxisZ(const void* a, const void* b) {
-		//printf("Stacking BoxCompareOnAxisZ...\n");
-		Bounds3f boxLeft, boxRight;
-		Shape* aShapes = *(Shape**)a;
-		Shape* bShapes = *(Shape**)b;
-		if (!aShapes->BoundingBox(boxLeft) || !bShapes->BoundingBox(boxRight)) {
-			boxLeft = Bounds3f();
-			boxRight = Bounds3f();
+	/// <summary>
+	/// ȡٽṹͼԪ BVHAccel ʱΪ 0
+	/// </summary>
+	__global__ inline void GetBVHShapes(const Shape* accel, Shape*** shapes, int* count) {
+		if (threadIdx.x == 0 && blockIdx.x == 0) {
+			bool isBVH = accel->flag == 0;
+			*shapes = isBVH ? ((const BVHAccel*)accel)->primitives : nullptr;
+			*count = isBVH ? accel->numShapes : 0;
 		}
-		if (boxLeft.pMin.z - boxRight.pMin.z < 0.f) {
-			return -1;
+	}
+
+	/// <summary>
+	/// ÿ߳ȡһͼԪõ BLASʵʱΪ nullptr
+	/// </summary>
+	__global__ inline void GatherInstanceObjects(Shape** shapes, int n, const Shape** objects) {
+		int i = threadIdx.x + blockIdx.x * blockDim.x;
+		if (i >= n) return;
+		objects[i] = shapes[i]->flag == 2 ? ((const Instance*)shapes[i])->object : nullptr;
+	}
+
+	/// <summary>
+	/// ÿ߳ȡһͼԪİΧ
+	/// </summary>
+	__global__ inline void GatherShapeBounds(Shape** shapes, int n, Bounds3f* bounds) {
+		int i = threadIdx.x + blockIdx.x * blockDim.x;
+		if (i >= n) return;
+		if (!shapes[i]->BoundingBox(bounds[i])) {
+			bounds[i] = Bounds3f();
 		}
-		else {
-			return 1;
+	}
+
+	/// <summary>
+	/// ÿ߳ȡһͼԪڿ˵İΧ
+	/// </summary>
+	__global__ inline void GatherShapeMotionBounds(Shape** shapes, int n, Float time0, Float time1, Bounds3f* bounds0, Bounds3f* bounds1) {
+		int i = threadIdx.x + blockIdx.x * blockDim.x;
+		if (i >= n) return;
+		if (!shapes[i]->MotionBoundingBox(time0, time1, bounds0[i], bounds1[i])) {
+			bounds0[i] = bounds1[i] = Bounds3f();
 		}
 	}
 
-	/*__device__ inline Shape* create_temp_world(Shape** shapes, int n) {
-		return new ShapeList(shapes, n);
-	}*/
-
-	__device__ inline Shape* CreateBVHNode(Shape** shapes, int n, Shape** nodes, curandState* local_rand_state, Float time0, Float time1) {
-		// flag={-1,0,1,2}; 
-		// -1(ʾͨShapeûҺ)
-		// 0(ʾBVHNodeҺΪ)
-		// 1(ʾBVHNodeֻ)
-		// 2(ʾBVHNodeֻҺ)
-		Shape** temp = shapes;
-		Shape** stack = new Shape * [n]; // ջ
-		int* numShapesBeginStack = new int[n]; // ջ
-		int* numShapesEndStack = new int[n]; // ջ
-		int top = -1;
-		int size = -1;
-		BVHNode* root = new BVHNode(temp, n, nodes, time0, time1);
-		nodes[++size] = root;
-		//root->flag = 0;
-		stack[++top] = root;
-		numShapesBeginStack[top] = 0;
-		numShapesEndStack[top] = n - 1;
-		// ֵ
-		int axis = int(3 * curand_uniform(local_rand_state));
-		if (axis == 0) {
-			Qsort(temp, n, sizeof(Shape*), BoxCompareOnAxisX);
+	/// <summary>
+	/// ÿ߳ȡһͼԪζ㣨任 BVH ڵĿռ䣩 SBVH üáʱֻǳ
+	/// </summary>
+	__global__ inline void GatherShapeTriangles(Shape** shapes, int n, BVHTriangle* triangles) {
+		int i = threadIdx.x + blockIdx.x * blockDim.x;
+		if (i >= n) return;
+		BVHTriangle& out = triangles[i];
+		out.isTriangle = shapes[i]->flag == 1;
+		if (!out.isTriangle) return;
+		const Triangle* triangle = (const Triangle*)shapes[i];
+		out.p0 = triangle->ObjectToWorld(triangle->p0);
+		out.p1 = triangle->ObjectToWorld(triangle->p1);
+		out.p2 = triangle->ObjectToWorld(triangle->p2);
+	}
+
+	/// <summary>
+	/// ȡ任ı任
+	/// </summary>
+	__global__ inline void GetTransformCount(int* count) {
+		if (threadIdx.x == 0 && blockIdx.x == 0) *count = sceneTransforms.count;
+	}
+
+	/// <summary>
+	/// Ҷ˳ռͼԪָ룬n õڵBLAS ͼԪ豸ϣ cudaMemcpy 
+	/// </summary>
+	__global__ inline void PermuteShapes(Shape** shapes, int n, const int* primitiveIndices, Shape** ordered) {
+		int i = threadIdx.x + blockIdx.x * blockDim.x;
+		if (i >= n) return;
+		ordered[i] = shapes[primitiveIndices[i]];
+	}
+
+	/// <summary>
+	/// ѽڵҵ BVHAccel ϣnodes  compressedNodes ֻһΪաڵİΧ˴룬ѹڵû float İΧ
+	/// </summary>
+	__global__ inline void AttachBVHNodes(Shape* accel, Shape** leafShapes, const LinearBVHNode* nodes, const CompressedBVHNode* compressedNodes,
+		Bounds3f rootBounds, int numNodes, const LinearBVHMotionBounds* motionBounds, Float shutterOpen, Float shutterClose,
+		const TriangleBlock<TRIANGLE_BLOCK_WIDTH>* triangleBlocks, const TriangleLeaf* triangleLeaves) {
+		if (threadIdx.x == 0 && blockIdx.x == 0) {
+			BVHAccel* bvh = (BVHAccel*)accel;
+			bvh->shapes = leafShapes;
+			bvh->nodes = nodes;
+			bvh->compressedNodes = compressedNodes;
+			bvh->numNodes = numNodes;
+			bvh->box = rootBounds;
+			bvh->motionBounds = motionBounds;
+			bvh->shutterOpen = shutterOpen;
+			bvh->invShutterLength = shutterClose > shutterOpen ? 1 / (shutterClose - shutterOpen) : 0;
+			bvh->triangleBlocks = triangleBlocks;
+			bvh->triangleLeaves = triangleLeaves;
 		}
-		else if (axis == 1) {
-			Qsort(temp, n, sizeof(Shape*), BoxCompareOnAxisY);
+	}
+
+#ifdef __CUDACC__
+	/// <summary>
+	///  BVH ˵״̬Build Ϊÿ BVHAccel ڵ㣺ʵõ BLAS ȸһΣ
+	/// ʵ֮Ϲ BVH˵ LinearBVH 豸ƶͼԪ Refit
+	/// ֻΧУ֡Ⱦ̯Ŀrefit  SAH ˻̫һؽ
+	/// </summary>
+	class SceneBVH {
+	public:
+		~SceneBVH() { Free(); }
+
+		void Build(Shape** world, const BVHBuildOptions& options = BVHBuildOptions());
+
+		/// <summary>
+		///  BLAS ˳ȡͼԪΧв refitΧûб仯ĲдεĲ´ؽĲ
+		/// </summary>
+		int Refit();
+
+		/// <summary>
+		/// ͷ豸˵Ľڵ飬Ⱦ
+		/// </summary>
+		void Free();
+
+	private:
+		struct Level {
+			Shape* accel;                    // 豸˵ BVHAccel
+			Shape** shapes;                  // ͼԪ飬ִʱ˳򣬰Χа˳ȡ
+			int numShapes;
+			std::unique_ptr<LinearBVH> bvh;
+			Shape** d_leafShapes;            //  primitiveIndices ռҶͼԪҵ BVHAccel::shapes 
+			int numLeafShapes;
+			uint64_t boundsHash;             // ϴι refit ʱͼԪΧеĹϣûб仯Ĳ refit ʱֱ
+			CompressedBVH compressed;        // options.compressNodes ʱ bvh ɣ豸ֻϴһ
+			LinearBVHNode* d_nodes;          // ָ d_nodeStorage ĵڶڵ㣺ڵ㵥ռһλãֵ֮ܶԶ뵽 64 ֽ
+			CompressedBVHNode* d_compressedNodes; //  d_nodesͬһڵ㣬ֵܶԶ뵽 32 ֽ
+			void* d_nodeStorage;
+			LinearBVHMotionBounds* d_motionBounds; // options.motionBlur ʱ
+			int numNodes;
+			TriangleBlocks<TRIANGLE_BLOCK_WIDTH> triangles; // options.triangleBlocks ʱҶӴ
+			TriangleBlock<TRIANGLE_BLOCK_WIDTH>* d_triangleBlocks;
+			TriangleLeaf* d_triangleLeaves;
+			int numTriangleBlocks, numTriangleLeaves;
+		};
+		void BuildLevel(Shape* accel, std::set<const Shape*>& built);
+		std::vector<Bounds3f> GatherBounds(const Level& level) const;
+		std::vector<BVHTriangle> GatherTriangles(const Level& level) const;
+		void GatherMotionBounds(const Level& level, std::vector<Bounds3f>& bounds0, std::vector<Bounds3f>& bounds1) const;
+		void Upload(Level& level, bool rebuilt);
+
+		std::vector<Level> levels; // BLAS ǰrefit ʱ˳Ե
+		BVHBuildOptions options;
+	};
+
+	inline void SceneBVH::Build(Shape** world, const BVHBuildOptions& options) {
+		Free();
+		this->options = options;
+		Shape* accel = nullptr;
+		cudaMemcpy(&accel, world, sizeof(Shape*), cudaMemcpyDeviceToHost);
+		std::set<const Shape*> built;
+		BuildLevel(accel, built);
+
+		// ͼԪֻһָ任ָ룬λ任ռ
+		int* d_count;
+		int numTransforms = 0;
+		cudaMalloc((void**)&d_count, sizeof(int));
+		GetTransformCount << <1, 1 >> > (d_count);
+		cudaMemcpy(&numTransforms, d_count, sizeof(int), cudaMemcpyDeviceToHost);
+		cudaFree(d_count);
+		printf("Shapes: %d bytes per triangle (%d in the Shape base), %d shared transforms in %.2f KB instead of %d bytes in every shape\n",
+			int(sizeof(Triangle)), int(sizeof(Shape)), numTransforms, numTransforms * sizeof(Transform) / 1024.0, int(sizeof(Transform)));
+	}
+
+	/// <summary>
+	/// ʵİΧҪõ BLAS İΧУȵݹ鹹ͼԪõ BLASbuilt ֤ BLAS ֻһ
+	/// </summary>
+	inline void SceneBVH::BuildLevel(Shape* accel, std::set<const Shape*>& built) {
+		if (!built.insert(accel).second) return;
+		Shape*** d_shapes;
+		int* d_count;
+		cudaMalloc((void**)&d_shapes, sizeof(Shape**));
+		cudaMalloc((void**)&d_count, sizeof(int));
+		GetBVHShapes << <1, 1 >> > (accel, d_shapes, d_count);
+		Level level;
+		level.accel = accel;
+		level.shapes = nullptr;
+		level.numShapes = 0;
+		cudaMemcpy(&level.shapes, d_shapes, sizeof(Shape**), cudaMemcpyDeviceToHost);
+		cudaMemcpy(&level.numShapes, d_count, sizeof(int), cudaMemcpyDeviceToHost);
+		cudaFree(d_shapes);
+		cudaFree(d_count);
+		int n = level.numShapes;
+		if (n <= 0) return;
+
+		const Shape** d_objects;
+		cudaMalloc((void**)&d_objects, n * sizeof(Shape*));
+		GatherInstanceObjects << <(n + 255) / 256, 256 >> > (level.shapes, n, d_objects);
+		std::vector<const Shape*> objects(n);
+		cudaMemcpy(objects.data(), d_objects, n * sizeof(Shape*), cudaMemcpyDeviceToHost);
+		cudaFree(d_objects);
+		std::sort(objects.begin(), objects.end());
+		objects.erase(std::unique(objects.begin(), objects.end()), objects.end());
+		for (const Shape* object : objects) {
+			if (object) BuildLevel(const_cast<Shape*>(object), built);
 		}
-		else {
-			Qsort(temp, n, sizeof(Shape*), BoxCompareOnAxisZ);
+
+		clock_t start = clock();
+		std::vector<Bounds3f> bounds;
+		std::vector<BVHTriangle> triangles;
+		if (options.splitMethod == BVHSplitMethod::SBVH || options.triangleBlocks) triangles = GatherTriangles(level);
+		const std::vector<BVHTriangle>* trianglesPtr = options.splitMethod == BVHSplitMethod::SBVH ? &triangles : nullptr;
+		// δɿʱҶӵĴۣҶζһЩֻΪĲʵ㻹ǰͼԪ
+		BVHBuildOptions levelOptions = options;
+		if (options.triangleBlocks) {
+			int numTriangles = 0;
+			for (const BVHTriangle& triangle : triangles) numTriangles += triangle.isTriangle;
+			if (2 * numTriangles >= n) levelOptions.leafBatchWidth = TRIANGLE_BLOCK_WIDTH;
 		}
-#ifdef BVH_DEBUG_INFO
-		printf("Stacking...\n");
-#endif // BVH_DEBUG_INFO
-		int progress = 0; // ¼
-		int percentPg = 10; // ʱ
-		int status = 1;
-		while (top != -1) {
-			progress++;
-			if (progress % percentPg == 0) {
-				if (status == 1) {
-					printf("\rBuilding BVH.");
-					status = 2;
-				}
-				else if (status == 2) {
-					printf("\rBuilding BVH..");
-					status = 3;
-				}
-				else {
-					printf("\rBuilding BVH..."); 
-					status = 1;
+		level.bvh.reset(new LinearBVH());
+		//  key ֻȡͼԪΧк͹ģûʱֱӶȡϴεĹ
+		bool cached = false;
+		if (options.motionBlur) {
+			std::vector<Bounds3f> bounds1;
+			GatherMotionBounds(level, bounds, bounds1);
+			level.boundsHash = HashBytes(bounds1.data(), n * sizeof(Bounds3f), HashBytes(bounds.data(), n * sizeof(Bounds3f)));
+			if (options.cacheDirectory) {
+				uint64_t key = BVHCacheKey(bounds, levelOptions, &bounds1);
+				std::string path = BVHCachePath(options.cacheDirectory, key);
+				cached = level.bvh->LoadCache(path, key, levelOptions);
+				if (!cached) {
+					level.bvh->BuildMotion(bounds, bounds1, levelOptions);
+					level.bvh->SaveCache(path, key);
 				}
 			}
-			
-#ifdef BVH_DEBUG_INFO
-			printf("Top:%d, ", top);
-#endif // BVH_DEBUG_INFO
-			int tempN = numShapesEndStack[top] - numShapesBeginStack[top] + 1;
-			int tempBegin = numShapesBeginStack[top];
-			int tempEnd = numShapesEndStack[top];
-#ifdef BVH_DEBUG_INFO
-			printf("begin:%d, end:%d, ", tempBegin, tempEnd);
-#endif // BVH_DEBUG_INFO
-			// ֵ
-
-			if (tempN == 1) { // Ҷӽڵ
-				stack[top]->left = tempBegin;
-				stack[top]->right = tempBegin;
-				stack[top]->flag = 3;
-				//temp[tempBegin]->flag = -1;
-#ifdef BVH_DEBUG_INFO
-				printf("left[begin:%d, end:%d], right[begin:%d, end:%d], ", tempBegin, tempBegin, tempBegin, tempBegin);
-				printf("stack leaf node(n==1)\n");
-#endif // BVH_DEBUG_INFO
+			else {
+				level.bvh->BuildMotion(bounds, bounds1, levelOptions);
 			}
-			else if (tempN == 2) { // Ҷӽڵ
-				stack[top]->left = tempBegin;
-				stack[top]->right = tempBegin + 1;
-				stack[top]->flag = 3;
-				//temp[tempBegin]->flag = -1;
-				//temp[tempBegin + 1]->flag = -1;
-#ifdef BVH_DEBUG_INFO
-				printf("left[begin:%d, end:%d], right[begin:%d, end:%d], ", tempBegin, tempBegin, tempBegin + 1, tempBegin + 1);
-				printf("stack leaf node(n==2)\n");
-#endif // BVH_DEBUG_INFO
+			for (int i = 0; i < n; i++) {
+				bounds[i] = Union(bounds[i], bounds1[i]);
 			}
-			else { // мڵ
-				
-				if (stack[top]->flag == 0) {
-					BVHNode* node = new BVHNode(temp + tempBegin, tempN / 2, nodes, time0, time1);
-					nodes[++size] = node;
-					stack[top]->left = size;
-					stack[top]->flag = 1;
-					stack[++top] = node;
-					numShapesBeginStack[top] = tempBegin;
-					numShapesEndStack[top] = tempBegin + tempN / 2 - 1;
-#ifdef BVH_DEBUG_INFO
-					printf("left[begin:%d, end:%d], ", tempBegin, tempBegin + tempN / 2 - 1);
-					printf("stack left node\n");
-#endif // BVH_DEBUG_INFO
-					axis = int(3 * curand_uniform(local_rand_state));
-					if (axis == 0) {
-						Qsort(temp + numShapesBeginStack[top], numShapesEndStack[top] - numShapesBeginStack[top] + 1, sizeof(Shape*), BoxCompareOnAxisX);
-					}
-					else if (axis == 1) {
-						Qsort(temp + numShapesBeginStack[top], numShapesEndStack[top] - numShapesBeginStack[top] + 1, sizeof(Shape*), BoxCompareOnAxisY);
-					}
-					else {
-						Qsort(temp + numShapesBeginStack[top], numShapesEndStack[top] - numShapesBeginStack[top] + 1, sizeof(Shape*), BoxCompareOnAxisZ);
-					}
-				}
-				else if (stack[top]->flag == 1) {
-					BVHNode* node = new BVHNode(temp + tempBegin + tempN / 2, tempN - tempN / 2, nodes, time0, time1);
-					nodes[++size] = node;
-					stack[top]->right = size;
-					stack[top]->flag = 2;
-					stack[++top] = node;
-					numShapesBeginStack[top] = tempBegin + tempN / 2;
-					numShapesEndStack[top] = tempEnd;
-#ifdef BVH_DEBUG_INFO
-					printf("right[begin:%d, end:%d], ", tempBegin + tempN / 2, tempEnd);
-					printf("stack right node\n");
-#endif // BVH_DEBUG_INFO
+		}
+		else {
+			bounds = GatherBounds(level);
+			level.boundsHash = HashBytes(bounds.data(), n * sizeof(Bounds3f));
+			if (options.cacheDirectory) {
+				uint64_t key = BVHCacheKey(bounds, levelOptions, nullptr, trianglesPtr);
+				std::string path = BVHCachePath(options.cacheDirectory, key);
+				cached = level.bvh->LoadCache(path, key, levelOptions);
+				if (!cached) {
+					level.bvh->Build(bounds, levelOptions, trianglesPtr);
+					level.bvh->SaveCache(path, key);
 				}
 			}
-			while (top >= 0 && stack[top]->flag >= 2) {
-				Bounds3f leftBox, rightBox;
-				// Ҷڵ
-				if (stack[top]->flag == 3 && stack[top]->left >= 0 && stack[top]->right >= 0) {
-					if (shapes[stack[top]->left]->BoundingBox(leftBox) && shapes[stack[top]->right]->BoundingBox(rightBox)) {
-						stack[top]->box = Union(leftBox, rightBox);
-					}
-					else {
-						stack[top]->box = Bounds3f();
-					}
-				}
-				else if (stack[top]->flag == 2 && stack[top]->left >= 0 && stack[top]->right >= 0) {
-					if (nodes[stack[top]->left]->BoundingBox(leftBox) && nodes[stack[top]->right]->BoundingBox(rightBox)) {
-						stack[top]->box = Union(leftBox, rightBox);
-					}
-					else {
-						stack[top]->box = Bounds3f();
-					}
-				}
-				else {
-					stack[top]->box = Bounds3f();
-#ifdef BVH_DEBUG_INFO
-					printf("The Bounding Box is max\n");
-#endif // BVH_DEBUG_INFO
-				}
-#ifdef BVH_DEBUG_INFO
-				Bounds3f tempBox;
-				stack[top]->BoundingBox(tempBox);
-				printf("-------------------------------------------------\n");
-				printf("The %dth Shape Bounding Box is:[%f, %f, %f]\n", top, stack[top]->box.pMin.x, stack[top]->box.pMin.y, stack[top]->box.pMin.z);
-				printf("The %dth Shape Left Bounding Box is:[%f, %f, %f]\n", top, tempBox.pMin.x, tempBox.pMin.y, tempBox.pMin.z);
-				printf("The %dth Shape Left Index is:[%d]\n", top, stack[top]->left);
-				printf("The %dth Shape Right Index is:[%d]\n", top, stack[top]->right);
-				printf("-------------------------------------------------\n");
-#endif // BVH_DEBUG_INFO
-
-				top--;
+			else {
+				level.bvh->Build(bounds, levelOptions, trianglesPtr);
 			}
-			
 		}
-
-#ifdef BVH_DEBUG_INFO
-		// 
-		printf("stack complete! top:%d\n", top);
-		stack[++top] = root;
-		Shape* lastPop = nullptr;
-		int i = 0;
-		while (top > -1) {
-			while (stack[top]->left) {
-				stack[++top] = nodes[stack[top]->left];
-			}
-			while (top > -1) {
-				if (lastPop == nodes[stack[top]->right] || stack[top]->right > 0) {
-					Bounds3f box;
-					stack[top]->BoundingBox(box);
-					printf("The %dth Shape Bounding Box is:[%f, %f, %f] and have boys:%d\n", top + 1, box.pMin.x, box.pMin.y, box.pMin.z, ((BVHNode*)stack[top])->numShapes);
-					i++;
-					lastPop = stack[top];
-					top--;
-				}
-				else if (stack[top]->right > 0) {
-					stack[++top] = nodes[stack[top]->right];
-					break;
-				}
-			}
+		level.d_leafShapes = nullptr;
+		level.numLeafShapes = 0;
+		level.d_nodes = nullptr;
+		level.d_compressedNodes = nullptr;
+		level.d_nodeStorage = nullptr;
+		level.d_motionBounds = nullptr;
+		level.numNodes = 0;
+		level.d_triangleBlocks = nullptr;
+		level.d_triangleLeaves = nullptr;
+		level.numTriangleBlocks = 0;
+		level.numTriangleLeaves = 0;
+		Upload(level, true);
+
+		printf("%s BVH over %d shapes in %.3fs\n", cached ? "Loaded cached" : "Built", n, double(clock() - start) / CLOCKS_PER_SEC);
+		// ԭÿڵһ BVHNode  nodes һָ
+		level.bvh->PrintMemoryReport(sizeof(Shape) + 2 * sizeof(Shape**) + sizeof(Shape*));
+		if (level.d_compressedNodes) {
+			printf("BVH: compressed to %d bytes per node, %.2f MB nodes on device, SAH cost +%.1f%%\n", int(sizeof(CompressedBVHNode)),
+				level.compressed.NodeBytes() / (1024.0 * 1024.0), 100 * level.compressed.SAHCostIncrease(*level.bvh));
+		}
+		if (level.d_triangleLeaves) {
+			printf("BVH: %d triangles packed into %d blocks of %d, %.2f MB\n", level.triangles.numTriangles, level.numTriangleBlocks,
+				TRIANGLE_BLOCK_WIDTH, level.triangles.Bytes() / (1024.0 * 1024.0));
 		}
-		printf("Count %d\n", i);
-#endif // BVH_DEBUG_INFO
-#ifdef BVH_DEBUG_INFO
-		for (int i = 0; i < size; i++) {
-			Bounds3f box;
-			nodes[i]->BoundingBox(box);
-			printf("--------------------------------------------------------------------\n");
-			printf("The %dth Shape Flag is:[ %d ]\n", i + 1, nodes[i]->flag);
-			printf("The %dth Shape Bounding Box is:[%f, %f, %f] and [%f, %f, %f]\n", i + 1, box.pMin.x, box.pMin.y, box.pMin.z, box.pMax.x, box.pMax.y, box.pMax.z);
-			printf("The %dth Shape Left and Right node index is:[ %d ] and [ %d ]\n", i + 1, nodes[i]->left, nodes[i]->right);
+#ifdef BVH_STATS
+		if (options.splitMethod != BVHSplitMethod::Median) {
+			BVHBuildOptions medianOptions = levelOptions;
+			medianOptions.splitMethod = BVHSplitMethod::Median;
+			medianOptions.maxPrimsInNode = 2;
+			LinearBVH medianBVH;
+			medianBVH.Build(bounds, medianOptions);
+			printf("BVH: SAH cost %.2f, median split %.2f\n", level.bvh->SAHCost(), medianBVH.SAHCost());
 		}
-#endif // BVH_DEBUG_INFO
-		root->numNodes = size;
-		delete* stack;
-		delete[]numShapesBeginStack;
-		delete[]numShapesEndStack;
-
-		printf("\rBuilt BVH    :)\n");
-		return root;
+#endif // BVH_STATS
+#ifdef BVH_BENCHMARK
+		BenchmarkBVHBuilders(bounds);
+		BenchmarkBVHLayouts(bounds, levelOptions);
+		if (options.cacheDirectory) BenchmarkBVHCache(bounds, levelOptions);
+		if (trianglesPtr) BenchmarkSpatialSplits(bounds, triangles, levelOptions);
+		BenchmarkCompressedNodes(bounds, levelOptions);
+		BenchmarkOcclusion(bounds, levelOptions);
+		BenchmarkTriangleBlocks(bounds, triangles.empty() ? GatherTriangles(level) : triangles, options);
+#endif // BVH_BENCHMARK
+		levels.push_back(std::move(level));
 	}
 
+	inline std::vector<Bounds3f> SceneBVH::GatherBounds(const Level& level) const {
+		int n = level.numShapes;
+		Bounds3f* d_bounds;
+		cudaMalloc((void**)&d_bounds, n * sizeof(Bounds3f));
+		GatherShapeBounds << <(n + 255) / 256, 256 >> > (level.shapes, n, d_bounds);
+		std::vector<Bounds3f> bounds(n);
+		cudaMemcpy(bounds.data(), d_bounds, n * sizeof(Bounds3f), cudaMemcpyDeviceToHost);
+		cudaFree(d_bounds);
+		return bounds;
+	}
 
+	inline std::vector<BVHTriangle> SceneBVH::GatherTriangles(const Level& level) const {
+		int n = level.numShapes;
+		BVHTriangle* d_triangles;
+		cudaMalloc((void**)&d_triangles, n * sizeof(BVHTriangle));
+		GatherShapeTriangles << <(n + 255) / 256, 256 >> > (level.shapes, n, d_triangles);
+		std::vector<BVHTriangle> triangles(n);
+		cudaMemcpy(triangles.data(), d_triangles, n * sizeof(BVHTriangle), cudaMemcpyDeviceToHost);
+		cudaFree(d_triangles);
+		return triangles;
+	}
 
+	inline void SceneBVH::GatherMotionBounds(const Level& level, std::vector<Bounds3f>& bounds0, std::vector<Bounds3f>& bounds1) const {
+		int n = level.numShapes;
+		Bounds3f* d_bounds;
+		cudaMalloc((void**)&d_bounds, 2 * n * sizeof(Bounds3f));
+		GatherShapeMotionBounds << <(n + 255) / 256, 256 >> > (level.shapes, n, options.shutterOpen, options.shutterClose, d_bounds, d_bounds + n);
+		bounds0.resize(n);
+		bounds1.resize(n);
+		cudaMemcpy(bounds0.data(), d_bounds, n * sizeof(Bounds3f), cudaMemcpyDeviceToHost);
+		cudaMemcpy(bounds1.data(), d_bounds + n, n * sizeof(Bounds3f), cudaMemcpyDeviceToHost);
+		cudaFree(d_bounds);
+	}
 
-	//__device__ inline bool DeleteBVHNode(Shape** nodes, int numNodes) {
-	//	for (int i = 0; i < numNodes; i++) {
-	//		printf("%d\n", i);
-	//		printf("nodes left %d and right %d and flag %d \n",((BVHNode*)nodes[i])->left, ((BVHNode*)nodes[i])->right, ((BVHNode*)nodes[i])->flag );
-	//		delete (BVHNode*)nodes[i];
-	//	}
-	//	printf("delete nodes");
-	//}
-
-
-//	__device__ inline bool CreateBVHNode(Shape** shapes, int n, Shape** nodes, curandState* local_rand_state, Float time0, Float time1) {
-//		// flag={-1,0,1,2}; 
-//		// -1(ʾͨShapeûҺ)
-//		// 0(ʾBVHNodeҺΪ)
-//		// 1(ʾBVHNodeֻ)
-//		// 2(ʾBVHNodeֻҺ)
-//		Shape** temp = shapes;
-//		Shape** stack = new Shape * [n]; // ջ
-//		int* numShapesBeginStack = new int[n]; // ջ
-//		int* numShapesEndStack = new int[n]; // ջ
-//		int top = -1;
-//		int size = -1;
-//		BVHNode* root = (BVHNode*)nodes[0];
-//		nodes[++size] = root;
-//		//root->flag = 0;
-//		stack[++top] = root;
-//		numShapesBeginStack[top] = 0;
-//		numShapesEndStack[top] = n - 1;
-//		// ֵ
-//		int axis = int(3 * curand_uniform(local_rand_state));
-//		if (axis == 0) {
-//			Qsort(temp, n, sizeof(Shape*), BoxCompareOnAxisX);
-//		}
-//		else if (axis == 1) {
-//			Qsort(temp, n, sizeof(Shape*), BoxCompareOnAxisY);
-//		}
-//		else {
-//			Qsort(temp, n, sizeof(Shape*), BoxCompareOnAxisZ);
-//		}
-//#ifdef BVH_DEBUG_INFO
-//		printf("Stacking...\n");
-//#endif // BVH_DEBUG_INFO
-//		while (top != -1) {
-//#ifdef BVH_DEBUG_INFO
-//			printf("Top:%d, ", top);
-//#endif // BVH_DEBUG_INFO
-//			int tempN = numShapesEndStack[top] - numShapesBeginStack[top] + 1;
-//			int tempBegin = numShapesBeginStack[top];
-//			int tempEnd = numShapesEndStack[top];
-//#ifdef BVH_DEBUG_INFO
-//			printf("begin:%d, end:%d, ", tempBegin, tempEnd);
-//#endif // BVH_DEBUG_INFO
-//			// ֵ
-//
-//			if (tempN == 1) { // Ҷӽڵ
-//				stack[top]->left = tempBegin;
-//				stack[top]->right = tempBegin;
-//				stack[top]->flag = 3;
-//				//temp[tempBegin]->flag = -1;
-//#ifdef BVH_DEBUG_INFO
-//				printf("left[begin:%d, end:%d], right[begin:%d, end:%d], ", tempBegin, tempBegin, tempBegin, tempBegin);
-//				printf("stack leaf node(n==1)\n");
-//#endif // BVH_DEBUG_INFO
-//			}
-//			else if (tempN == 2) { // Ҷӽڵ
-//				stack[top]->left = tempBegin;
-//				stack[top]->right = tempBegin + 1;
-//				stack[top]->flag = 3;
-//				//temp[tempBegin]->flag = -1;
-//				//temp[tempBegin + 1]->flag = -1;
-//#ifdef BVH_DEBUG_INFO
-//				printf("left[begin:%d, end:%d], right[begin:%d, end:%d], ", tempBegin, tempBegin, tempBegin + 1, tempBegin + 1);
-//				printf("stack leaf node(n==2)\n");
-//#endif // BVH_DEBUG_INFO
-//			}
-//			else { // мڵ
-//
-//				if (stack[top]->flag == 0) {
-//					BVHNode* node = (BVHNode*)nodes[++size];
-//					stack[top]->left = size;
-//					stack[top]->flag = 1;
-//					stack[++top] = node;
-//					numShapesBeginStack[top] = tempBegin;
-//					numShapesEndStack[top] = tempBegin + tempN / 2 - 1;
-//#ifdef BVH_DEBUG_INFO
-//					printf("left[begin:%d, end:%d], ", tempBegin, tempBegin + tempN / 2 - 1);
-//					printf("stack left node\n");
-//#endif // BVH_DEBUG_INFO
-//					axis = int(3 * curand_uniform(local_rand_state));
-//					if (axis == 0) {
-//						Qsort(temp + numShapesBeginStack[top], numShapesEndStack[top] - numShapesBeginStack[top] + 1, sizeof(Shape*), BoxCompareOnAxisX);
-//					}
-//					else if (axis == 1) {
-//						Qsort(temp + numShapesBeginStack[top], numShapesEndStack[top] - numShapesBeginStack[top] + 1, sizeof(Shape*), BoxCompareOnAxisY);
-//					}
-//					else {
-//						Qsort(temp + numShapesBeginStack[top], numShapesEndStack[top] - numShapesBeginStack[top] + 1, sizeof(Shape*), BoxCompareOnAxisZ);
-//					}
-//				}
-//				else if (stack[top]->flag == 1) {
-//					BVHNode* node = (BVHNode*)nodes[++size];
-//					nodes[++size] = node;
-//					stack[top]->right = size;
-//					stack[top]->flag = 2;
-//					stack[++top] = node;
-//					numShapesBeginStack[top] = tempBegin + tempN / 2;
-//					numShapesEndStack[top] = tempEnd;
-//#ifdef BVH_DEBUG_INFO
-//					printf("right[begin:%d, end:%d], ", tempBegin + tempN / 2, tempEnd);
-//					printf("stack right node\n");
-//#endif // BVH_DEBUG_INFO
-//				}
-//			}
-//			while (top >= 0 && stack[top]->flag >= 2) {
-//				Bounds3f leftBox, rightBox;
-//				// Ҷڵ
-//				if (stack[top]->flag == 3 && stack[top]->left >= 0 && stack[top]->right >= 0) {
-//					if (shapes[stack[top]->left]->BoundingBox(leftBox) && shapes[stack[top]->right]->BoundingBox(rightBox)) {
-//						stack[top]->box = Union(leftBox, rightBox);
-//					}
-//					else {
-//						stack[top]->box = Bounds3f();
-//					}
-//				}
-//				else if (stack[top]->flag == 2 && stack[top]->left >= 0 && stack[top]->right >= 0) {
-//					if (nodes[stack[top]->left]->BoundingBox(leftBox) && nodes[stack[top]->right]->BoundingBox(rightBox)) {
-//						stack[top]->box = Union(leftBox, rightBox);
-//					}
-//					else {
-//						stack[top]->box = Bounds3f();
-//					}
-//				}
-//				else {
-//					stack[top]->box = Bounds3f();
-//#ifdef BVH_DEBUG_INFO
-//					printf("The Bounding Box is max\n");
-//#endif // BVH_DEBUG_INFO
-//				}
-//#ifdef BVH_DEBUG_INFO
-//				Bounds3f tempBox;
-//				stack[top]->BoundingBox(tempBox);
-//				printf("-------------------------------------------------\n");
-//				printf("The %dth Shape Bounding Box is:[%f, %f, %f]\n", top, stack[top]->box.pMin.x, stack[top]->box.pMin.y, stack[top]->box.pMin.z);
-//				printf("The %dth Shape Left Bounding Box is:[%f, %f, %f]\n", top, tempBox.pMin.x, tempBox.pMin.y, tempBox.pMin.z);
-//				printf("The %dth Shape Left Index is:[%d]\n", top, stack[top]->left);
-//				printf("The %dth Shape Right Index is:[%d]\n", top, stack[top]->right);
-//				printf("-------------------------------------------------\n");
-//#endif // BVH_DEBUG_INFO
-//
-//				top--;
-//			}
-//
-//		}
-//
-//#ifdef BVH_DEBUG_INFO
-//		// 
-//		printf("stack complete! top:%d\n", top);
-//		stack[++top] = root;
-//		Shape* lastPop = nullptr;
-//		int i = 0;
-//		while (top > -1) {
-//			while (stack[top]->left) {
-//				stack[++top] = nodes[stack[top]->left];
-//			}
-//			while (top > -1) {
-//				if (lastPop == nodes[stack[top]->right] || stack[top]->right > 0) {
-//					Bounds3f box;
-//					stack[top]->BoundingBox(box);
-//					printf("The %dth Shape Bounding Box is:[%f, %f, %f] and have boys:%d\n", top + 1, box.pMin.x, box.pMin.y, box.pMin.z, ((BVHNode*)stack[top])->numShapes);
-//					i++;
-//					lastPop = stack[top];
-//					top--;
-//				}
-//				else if (stack[top]->right > 0) {
-//					stack[++top] = nodes[stack[top]->right];
-//					break;
-//				}
-//			}
-//		}
-//		printf("Count %d\n", i);
-//#endif // BVH_DEBUG_INFO
-//#ifdef BVH_DEBUG_INFO
-//		for (int i = 0; i < size; i++) {
-//			Bounds3f box;
-//			nodes[i]->BoundingBox(box);
-//			printf("--------------------------------------------------------------------\n");
-//			printf("The %dth Shape Flag is:[ %d ]\n", i + 1, nodes[i]->flag);
-//			printf("The %dth Shape Bounding Box is:[%f, %f, %f] and [%f, %f, %f]\n", i + 1, box.pMin.x, box.pMin.y, box.pMin.z, box.pMax.x, box.pMax.y, box.pMax.z);
-//			printf("The %dth Shape Left and Right node index is:[ %d ] and [ %d ]\n", i + 1, nodes[i]->left, nodes[i]->right);
-//		}
-//#endif // BVH_DEBUG_INFO
-//		root->numNodes = size;
-//		delete* stack;
-//		delete[]numShapesBeginStack;
-//		delete[]numShapesEndStack;
-//
-//		return true;
-//	}
-}
+	/// <summary>
+	/// ѽڵ㿽豸˲ҵ BVHAccel ϡrebuilt ʱ֮󣩰 primitiveIndices ռҶͼԪ
+	/// refit ֻıΧУҶõͼԪ䡣options.compressNodes ʱÿζѹֻϴѹڵ㣻
+	/// ˶ģĽڵΧҪʱֵѹoptions.triangleBlocks ʱÿζ´Σƶ
+	/// </summary>
+	inline void SceneBVH::Upload(Level& level, bool rebuilt) {
+		LinearBVH& bvh = *level.bvh;
+		if (options.triangleBlocks) {
+			// Ҷŵǰ棬ҪռҶͼԪ֮ǰrefit ʱ˳Ѿźãٱ
+			level.triangles.Build(bvh, GatherTriangles(level));
+			int numBlocks = int(level.triangles.blocks.size()), numLeaves = int(level.triangles.leaves.size());
+			if (level.numTriangleBlocks != numBlocks || level.numTriangleLeaves != numLeaves) {
+				cudaFree(level.d_triangleBlocks);
+				cudaFree(level.d_triangleLeaves);
+				level.d_triangleBlocks = nullptr;
+				level.d_triangleLeaves = nullptr;
+				if (numLeaves > 0) {
+					cudaMalloc((void**)&level.d_triangleBlocks, numBlocks * sizeof(TriangleBlock<TRIANGLE_BLOCK_WIDTH>));
+					cudaMalloc((void**)&level.d_triangleLeaves, numLeaves * sizeof(TriangleLeaf));
+				}
+				level.numTriangleBlocks = numBlocks;
+				level.numTriangleLeaves = numLeaves;
+			}
+			if (numLeaves > 0) {
+				cudaMemcpy(level.d_triangleBlocks, level.triangles.blocks.data(), numBlocks * sizeof(TriangleBlock<TRIANGLE_BLOCK_WIDTH>), cudaMemcpyHostToDevice);
+				cudaMemcpy(level.d_triangleLeaves, level.triangles.leaves.data(), numLeaves * sizeof(TriangleLeaf), cudaMemcpyHostToDevice);
+			}
+		}
+		if (rebuilt) {
+			int n = int(bvh.primitiveIndices.size());
+			if (level.numLeafShapes != n) {
+				cudaFree(level.d_leafShapes);
+				cudaMalloc((void**)&level.d_leafShapes, n * sizeof(Shape*));
+				level.numLeafShapes = n;
+			}
+			int* d_indices;
+			cudaMalloc((void**)&d_indices, n * sizeof(int));
+			cudaMemcpy(d_indices, bvh.primitiveIndices.data(), n * sizeof(int), cudaMemcpyHostToDevice);
+			PermuteShapes << <(n + 255) / 256, 256 >> > (level.shapes, n, d_indices, level.d_leafShapes);
+			cudaDeviceSynchronize();
+			cudaFree(d_indices);
+		}
+		bool compress = options.compressNodes && bvh.motionBounds.empty();
+		if (compress) level.compressed.Compress(bvh);
+		if (level.numNodes != bvh.NumNodes()) {
+			cudaFree(level.d_nodeStorage);
+			cudaFree(level.d_motionBounds);
+			level.d_nodes = nullptr;
+			level.d_compressedNodes = nullptr;
+			if (compress) {
+				cudaMalloc(&level.d_nodeStorage, level.compressed.NodeBytes() + sizeof(CompressedBVHNode));
+				level.d_compressedNodes = (CompressedBVHNode*)level.d_nodeStorage + 1;
+			}
+			else {
+				cudaMalloc(&level.d_nodeStorage, bvh.NodeBytes() + sizeof(LinearBVHNode));
+				level.d_nodes = (LinearBVHNode*)level.d_nodeStorage + 1;
+			}
+			level.d_motionBounds = nullptr;
+			if (!bvh.motionBounds.empty()) {
+				cudaMalloc((void**)&level.d_motionBounds, bvh.MotionBoundsBytes());
+			}
+			level.numNodes = bvh.NumNodes();
+		}
+		if (compress) {
+			cudaMemcpy(level.d_compressedNodes, level.compressed.nodes.data(), level.compressed.NodeBytes(), cudaMemcpyHostToDevice);
+		}
+		else {
+			cudaMemcpy(level.d_nodes, bvh.nodes.data(), bvh.NodeBytes(), cudaMemcpyHostToDevice);
+		}
+		if (level.d_motionBounds) {
+			cudaMemcpy(level.d_motionBounds, bvh.motionBounds.data(), bvh.MotionBoundsBytes(), cudaMemcpyHostToDevice);
+		}
+		AttachBVHNodes << <1, 1 >> > (level.accel, level.d_leafShapes, level.d_nodes, level.d_compressedNodes, bvh.nodes[0].bounds, level.numNodes,
+			level.d_motionBounds, options.shutterOpen, options.shutterClose, level.d_triangleBlocks, level.d_triangleLeaves);
+		cudaDeviceSynchronize();
+	}
 
+	inline int SceneBVH::Refit() {
+		clock_t start = clock();
+		int rebuilt = 0, unchanged = 0;
+		for (Level& level : levels) {
+			// ֹ BLAS  refitSBVH Ҷ refit ɣÿ֡ refit Ƶؽ
+			int n = level.numShapes;
+			bool rebuild = false, changed;
+			if (options.motionBlur) {
+				std::vector<Bounds3f> bounds0, bounds1;
+				GatherMotionBounds(level, bounds0, bounds1);
+				uint64_t hash = HashBytes(bounds1.data(), n * sizeof(Bounds3f), HashBytes(bounds0.data(), n * sizeof(Bounds3f)));
+				changed = hash != level.boundsHash;
+				level.boundsHash = hash;
+				if (changed) rebuild = level.bvh->UpdateMotion(bounds0, bounds1);
+			}
+			else {
+				std::vector<Bounds3f> bounds = GatherBounds(level);
+				uint64_t hash = HashBytes(bounds.data(), n * sizeof(Bounds3f));
+				changed = hash != level.boundsHash;
+				level.boundsHash = hash;
+				if (changed) rebuild = level.bvh->Update(bounds);
+			}
+			if (!changed) {
+				unchanged++;
+				// ԭİΧƶưΧеĶԳᷭתʱϣ䣬ڵ㲻ø£
+				// ǶĿҪµĶ´
+				if (options.triangleBlocks && level.triangles.numTriangles > 0) Upload(level, false);
+				continue;
+			}
+			Upload(level, rebuild);
+			if (rebuild) rebuilt++;
+		}
+		printf("Refit %d BVHs (%d rebuilt, %d unchanged) in %.3fs\n", int(levels.size()), rebuilt, unchanged, double(clock() - start) / CLOCKS_PER_SEC);
+		return rebuilt;
+	}
 
+	inline void SceneBVH::Free() {
+		for (Level& level : levels) {
+			cudaFree(level.d_leafShapes);
+			cudaFree(level.d_nodeStorage);
+			cudaFree(level.d_motionBounds);
+			cudaFree(level.d_triangleBlocks);
+			cudaFree(level.d_triangleLeaves);
+		}
+		levels.clear();
+	}
+#endif // __CUDACC__
+}
 
 #endif // QZRT_CORE_BVH_H
-
@@ -11,22 +11,31 @@ namespace raytracer {
 		curandState* rand_state;
 		__device__ ConstantMedium() {}
 		__device__ ConstantMedium(Shape* shape, Float dens, Material* a, curandState* rand_state, const  Transform& _trans = Transform()) : density(dens), boundary(shape) {
-			transform = _trans;
+			SetTransform(_trans);
 			material = a;
 			invDensity = 1.f / density;
 			this->rand_state = rand_state;
 		}
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
+
+	private:
+		/// <summary>
+		/// ڱ߽ڰܶһɢľ룬ɢʱߵĲ
+		/// ÿεöһͬһֻܵһΣ׶ͨ PrimitiveHit::t ݲ
+		/// </summary>
+		__device__ bool SampleDistance(const Ray& ray, Float& t) const;
 	};
-	__device__ inline bool ConstantMedium::Hit(const Ray& ray, HitRecord& rec) const {
-		Transform invTrans = Inverse(transform);
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)), ray.tMax, ray.tMin);
+	__device__ inline bool ConstantMedium::SampleDistance(const Ray& ray, Float& t) const {
+		Float length = ray.d.Length();
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d / length), ray.tMax, ray.tMin);
 
-		HitRecord rec1, rec2;
+		HitRecord rec;
 		if (boundary->Hit(tansRay, rec)) {
 			Float t0 = rec.t0;
 			Float t1 = rec.t1;
@@ -36,18 +45,42 @@ namespace raytracer {
 			Float distance_inside_boundary = (t1 - t0) * tansRay.d.Length();
 			Float hit_distance = -invDensity * logf(curand_uniform(rand_state));
 			if (hit_distance < distance_inside_boundary) {
-				rec.t = t0 + hit_distance / tansRay.d.Length();
-				rec.p = transform(tansRay(rec.t));
-				rec.normal = transform(Normal3f(1, 0, 0));
-				rec.mat = material;
-				rec.u = 0;
-				rec.v = 0;
+				// λķ任ռĵλ򣬳ԭĳȾߵĲ
+				t = (t0 + hit_distance / tansRay.d.Length()) / length;
 				return true;
 			}
 		}
 		return false;
 	}
 
+	__device__ inline bool ConstantMedium::Hit(const Ray& ray, HitRecord& rec) const {
+		PrimitiveHit hit;
+		if (!SampleDistance(ray, hit.t)) return false;
+		return ComputeSurfaceInteraction(ray, hit, rec);
+	}
+
+	__device__ inline bool ConstantMedium::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float t;
+		if (!SampleDistance(ray, t) || t >= ray.tMax) return false;
+		hit.t = t;
+		hit.shape = this;
+		return true;
+	}
+
+	/// <summary>
+	/// õһ׶β t ؽ㣬ٲɢͲȽϵľһ
+	/// </summary>
+	__device__ inline bool ConstantMedium::ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const {
+		rec.t = hit.t * ray.d.Length();
+		rec.t0 = rec.t1 = rec.t;
+		rec.p = ray(hit.t);
+		rec.normal = ObjectToWorld(Normal3f(1, 0, 0));
+		rec.mat = material;
+		rec.u = 0;
+		rec.v = 0;
+		return true;
+	}
+
 	__device__ inline bool ConstantMedium::BoundingBox(Bounds3f& box) const {
 		return boundary->BoundingBox(box);
 	}
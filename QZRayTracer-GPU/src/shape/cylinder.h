@@ -14,7 +14,7 @@ namespace raytracer {
 		__device__ Cylinder() :center(Point3f(0, 0, 0)), radius(1.0), invRadius(1.0), zMin(0), zMax(0) {}
 		__device__ Cylinder(Point3f center, Float radius, Float bottom, Float top, Material* mat, const  Transform& _trans = Transform())
 			:center(center), zMin(Min(bottom, top)), zMax(Max(bottom, top)), radius(radius){
-			transform = _trans;
+			SetTransform(_trans);
 			material = mat;
 			Float halfHeight = (zMax - zMin) * .5f;
 			this->zMin = center.y - halfHeight;
@@ -29,9 +29,7 @@ namespace raytracer {
 	};
 
 	__device__ inline bool Cylinder::Hit(const Ray& ray, HitRecord& rec) const {
-		Transform invTrans = Inverse(transform);
-
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)));
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(Normalize(ray.d)));
 		Float dx = tansRay.d.x;
 		Float dz = tansRay.d.z;
 		Float cox = tansRay.o.x - center.x;
@@ -165,8 +163,8 @@ namespace raytracer {
 		}
 
 		rec.t = tShapeHit;
-		rec.p = transform(pHit);
-		rec.normal = Normalize(transform(normal));
+		rec.p = ObjectToWorld(pHit);
+		rec.normal = Normalize(ObjectToWorld(normal));
 		rec.mat = material;
 
 		Vector3f unit_p = Normalize(pHit - center);
@@ -184,7 +182,7 @@ namespace raytracer {
 	}
 
 	__device__ inline bool Cylinder::BoundingBox(Bounds3f& box) const {
-		box = transform(Bounds3f(Point3f(center.x - radius, zMin, center.z - radius), Point3f(center.x + radius, zMax, center.z + radius)));
+		box = ObjectToWorld(Bounds3f(Point3f(center.x - radius, zMin, center.z - radius), Point3f(center.x + radius, zMax, center.z + radius)));
 		return true;
 	}
 	// Shape* CreateCylinderShape(Point3f center, Float radius, Float zMin, Float zMax, Material* material);
@@ -13,25 +13,31 @@ namespace raytracer {
 		Float invOverTime;
 		Float radius;
 		Float invRadius;
-		Material* material;
+		Bounds3f box; // ˶̵ռΧУʱ
 		__device__ DSphere() :center0(Point3f(0, 0, 0)), center1(Point3f(0, 0, 0)), radius(1.0f), invRadius(1.0f) { material = nullptr; invOverTime = 0; }
 		__device__ DSphere(Point3f center0, Point3f center1, Float t0, Float t1, Float radius) : center0(center0), center1(center1), time0(t0), time1(t1), radius(radius), invRadius(1.0f) { material = nullptr; invOverTime = 1.0f / (time1 - time0);}
-		__device__ DSphere(Point3f center0, Point3f center1, Float t0, Float t1, Float radius, Material* mat, const  Transform& _trans = Transform()) : center0(center0), center1(center1), time0(t0), time1(t1), radius(radius), material(mat) {
-			transform = _trans;
+		__device__ DSphere(Point3f center0, Point3f center1, Float t0, Float t1, Float radius, Material* mat, const  Transform& _trans = Transform()) : center0(center0), center1(center1), time0(t0), time1(t1), radius(radius) {
+			SetTransform(_trans);
+			material = mat;
 			invRadius = 1.0f / radius;
 			invOverTime = 1.0f / (time1 - time0);
 			Bounds3f box0 = Bounds3f(center0 + Vector3f(-radius, -radius, -radius), center0 + Vector3f(radius, radius, radius));
 			Bounds3f box1 = Bounds3f(center1 + Vector3f(-radius, -radius, -radius), center1 + Vector3f(radius, radius, radius));
-			this->box = transform(Union(box0, box1));
+			this->box = ObjectToWorld(Union(box0, box1));
 
 			//printf("box: %f, %f, %f | %f, %f, %f\n", box.pMin.x, box.pMin.y, box.pMin.z, box.pMax.x, box.pMax.y, box.pMax.z);
 		};
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
 
+		// ˶ʱ̵İΧвֵмʱ̵İΧ
+		__device__ virtual bool MotionBoundingBox(Float t0, Float t1, Bounds3f& box0, Bounds3f& box1) const override;
+
 		__device__ Point3f Center(Float time)const {
 			return Lerp((time - time0) * invOverTime, center0, center1);
 		}
@@ -40,9 +46,7 @@ namespace raytracer {
 	
 
 	__device__ inline bool DSphere::Hit(const Ray& ray, HitRecord& rec) const {
-		Transform invTrans = Inverse(transform);
-
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)), ray.time);
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(Normalize(ray.d)), ray.time);
 		//Point3f transCenter = 
 
 		Vector3f oc = tansRay.o - Center(tansRay.time);
@@ -61,7 +65,7 @@ namespace raytracer {
 		rec.t0 = t0;
 		rec.t1 = t1;
 		Point3f hitP = tansRay(tShapeHit);
-		rec.p = transform(hitP);
+		rec.p = ObjectToWorld(hitP);
 		rec.mat = material;
 
 
@@ -72,14 +76,44 @@ namespace raytracer {
 
 		rec.u = 1.f - (phi + Pi) * Inv2Pi;
 		rec.v = (theta + Pi * 0.5f) * InvPi;
-		rec.normal = Normalize(transform(Normal3f((hitP - Center(tansRay.time)) * invRadius)));
+		rec.normal = Normalize(ObjectToWorld(Normal3f((hitP - Center(tansRay.time)) * invRadius)));
 
 		return true;
 	}
 
+	__device__ inline bool DSphere::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float dLength = ray.d.Length();
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d / dLength), ray.time);
+		Vector3f oc = tansRay.o - Center(tansRay.time);
+		Float a = Dot(tansRay.d, tansRay.d);
+		Float b = 2.0f * Dot(oc, tansRay.d);
+		Float c = Dot(oc, oc) - radius * radius;
+		Float t0, t1;
+		if (!Quadratic(a, b, c, t0, t1)) return false;
+		if (t1 <= ShadowEpsilon) return false;
+		Float tShapeHit = t0 < ShadowEpsilon ? t1 : t0;
+		if (tShapeHit >= ray.tMax * dLength) return false;
+		hit.t = tShapeHit / dLength;
+		hit.shape = this;
+		return true;
+	}
+
+	__device__ inline bool DSphere::IntersectP(const Ray& ray) const {
+		PrimitiveHit hit;
+		return Intersect(ray, hit);
+	}
+
 	__device__ inline bool DSphere::BoundingBox(Bounds3f& box) const {
 		box = this->box;
 		return true;
 	}
+
+	__device__ inline bool DSphere::MotionBoundingBox(Float t0, Float t1, Bounds3f& box0, Bounds3f& box1) const {
+		Vector3f r = Vector3f(radius, radius, radius);
+		Point3f c0 = Center(t0), c1 = Center(t1);
+		box0 = ObjectToWorld(Bounds3f(c0 - r, c0 + r));
+		box1 = ObjectToWorld(Bounds3f(c1 - r, c1 + r));
+		return true;
+	}
 }
 #endif // QZRT_SHAPE_DSPHERE_H
\ No newline at end of file
@@ -9,6 +9,8 @@ namespace raytracer {
 		__device__ FlipNormals(Shape* p) :ptr(p) {}
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
@@ -21,6 +23,21 @@ namespace raytracer {
 		return false;
 	}
 
+	/// <summary>
+	/// ͼԪǳԼڶ׶Ĭϵ Hitת
+	/// </summary>
+	__device__ inline bool FlipNormals::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		PrimitiveHit inner;
+		if (!ptr->Intersect(ray, inner)) return false;
+		hit.t = inner.t;
+		hit.shape = this;
+		return true;
+	}
+
+	__device__ inline bool FlipNormals::IntersectP(const Ray& ray) const {
+		return ptr->IntersectP(ray);
+	}
+
 	__device__ inline bool FlipNormals::BoundingBox(Bounds3f& box) const {
 		return ptr->BoundingBox(box);
 	}
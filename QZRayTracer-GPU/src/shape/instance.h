@@ -0,0 +1,75 @@
+#ifndef QZRT_SHAPE_INSTANCE_H
+#define QZRT_SHAPE_INSTANCE_H
+#include "../core/shape.h"
+
+namespace raytracer {
+	/// <summary>
+	///  BVH еʵһռ BLASͨ CreateMeshBVH  BVHAccelԼֻ任
+	/// ͬһڷŶʱκ BLAS ֻһݣ BVH ÿʵֻһͼԪ
+	/// 任һνռ䣬BLAS ͼԪٸԱ任
+	/// </summary>
+	class Instance :public Shape {
+	public:
+		const Shape* object;
+		__device__ Instance(const Shape* object, const Transform& _trans) :object(object) {
+			flag = 2;
+			SetTransform(_trans);
+		}
+		// ͨ Shape ̳
+		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
+
+		// ͨ Shape ̳
+		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
+
+		// ͨ Shape ̳
+		__device__ virtual bool MotionBoundingBox(Float t0, Float t1, Bounds3f& box0, Bounds3f& box1) const override;
+	};
+	__device__ inline bool Instance::Hit(const Ray& ray, HitRecord& rec) const {
+		// 򲻵λռߵĲͬtMax ֱ
+		Ray objectRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d), ray.time, ray.tMax, ray.tMin);
+		if (!object->Hit(objectRay, rec)) return false;
+		rec.p = ObjectToWorld(rec.p);
+		rec.normal = Normalize(ObjectToWorld(rec.normal));
+		return true;
+	}
+
+	/// <summary>
+	/// ռߵĲͬBLAS  t û㣬ֻͼԪʵ
+	/// </summary>
+	__device__ inline bool Instance::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		if (!object->Intersect(Ray(WorldToObject(ray.o), WorldToObject(ray.d), ray.time, ray.tMax, ray.tMin), hit)) return false;
+		hit.instance = this;
+		return true;
+	}
+
+	__device__ inline bool Instance::ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const {
+		Ray objectRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d), ray.time, ray.tMax, ray.tMin);
+		if (!hit.shape->ComputeSurfaceInteraction(objectRay, hit, rec)) return false;
+		rec.p = ObjectToWorld(rec.p);
+		rec.normal = Normalize(ObjectToWorld(rec.normal));
+		return true;
+	}
+
+	__device__ inline bool Instance::IntersectP(const Ray& ray) const {
+		return object->IntersectP(Ray(WorldToObject(ray.o), WorldToObject(ray.d), ray.time, ray.tMax, ray.tMin));
+	}
+
+	__device__ inline bool Instance::BoundingBox(Bounds3f& box) const {
+		Bounds3f objectBox;
+		if (!object->BoundingBox(objectBox)) return false;
+		box = ObjectToWorld(objectBox);
+		return true;
+	}
+
+	__device__ inline bool Instance::MotionBoundingBox(Float t0, Float t1, Bounds3f& box0, Bounds3f& box1) const {
+		Bounds3f objectBox0, objectBox1;
+		if (!object->MotionBoundingBox(t0, t1, objectBox0, objectBox1)) return false;
+		box0 = ObjectToWorld(objectBox0);
+		box1 = ObjectToWorld(objectBox1);
+		return true;
+	}
+}
+#endif // QZRT_SHAPE_INSTANCE_H
@@ -13,6 +13,8 @@ namespace raytracer {
 
         // ͨ Shape ̳
         __device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+        __device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+        __device__ virtual bool IntersectP(const Ray& ray) const override;
 
 
         // ͨ Shape ̳
@@ -20,20 +22,33 @@ namespace raytracer {
     };
 
     __device__ inline bool ShapeList::Hit(const Ray& ray, HitRecord& rec) const {
-        HitRecord tempRec;
+        PrimitiveHit hit;
+        if (!Intersect(ray, hit)) return false;
+        return hit.ComputeSurfaceInteraction(ray, rec);
+    }
+
+    __device__ inline bool ShapeList::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+        // ״صĶߵĲֱӱȽϲ tMax
+        Ray r = ray;
         bool hitAnything = false;
-        Float closestSoFar = ray.tMax;
         for (int i = 0; i < numShapes; i++) {
-            if (shapes[i]->Hit(ray, tempRec) && tempRec.t < closestSoFar) {
+            PrimitiveHit candidate;
+            if (shapes[i]->Intersect(r, candidate)) {
                 hitAnything = true;
-                closestSoFar = tempRec.t;
-                rec = tempRec;
+                r.tMax = candidate.t;
+                hit = candidate;
             }
         }
-        //printf("closestSoFar:%f\n", closestSoFar);
         return hitAnything;
     }
 
+    __device__ inline bool ShapeList::IntersectP(const Ray& ray) const {
+        for (int i = 0; i < numShapes; i++) {
+            if (shapes[i]->IntersectP(ray)) return true;
+        }
+        return false;
+    }
+
     __device__ inline bool ShapeList::BoundingBox(Bounds3f& box) const {
         return true;
     }
@@ -12,27 +12,27 @@ namespace raytracer {
 		__device__ Sphere() :center(Point3f(0, 0, 0)), radius(1.0f), invRadius(1.0f) { material = nullptr; }
 		__device__ Sphere(Point3f center, Float radius) : center(center), radius(radius), invRadius(1.0f) { material = nullptr; }
 		__device__ Sphere(Point3f center, Float radius, Material* mat, const  Transform& _trans = Transform()) :center(center), radius(radius) {
-			transform = _trans;
+			SetTransform(_trans);
 			invRadius = 1.0f / radius;
 			material = mat;
 		};
 		__device__ Sphere(Material* mat, const  Transform& _trans = Transform()) :center(center), radius(radius) {
 			center = Point3f(0, 1, 0);
 			radius = 1.f;
-			transform = _trans;
+			SetTransform(_trans);
 			invRadius = 1.0f / radius;
 			material = mat;
 		};
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
 	};
 	__device__ inline bool Sphere::Hit(const Ray& ray, HitRecord& rec) const {
-		Transform invTrans = Inverse(transform);
-
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)));
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(Normalize(ray.d)));
 		Vector3f oc = tansRay.o - center;
 		Float a = Dot(tansRay.d, tansRay.d);
 		Float b = 2.0f * Dot(oc, tansRay.d);
@@ -64,15 +64,39 @@ namespace raytracer {
 		rec.u = 1.f - (phi + Pi) * Inv2Pi;
 		rec.v = (theta + Pi * 0.5f) * InvPi;
 
-		rec.p = transform(hitP);
-		rec.normal = Normalize(transform(Normal3f((hitP - center) * invRadius)) * dir);
+		rec.p = ObjectToWorld(hitP);
+		rec.normal = Normalize(ObjectToWorld(Normal3f((hitP - center) * invRadius)) * dir);
 		rec.mat = material;
 
 
 		return true;
 	}
+	/// <summary>
+	///  Hit һھֲռõλķֲ t ߲ |d| 
+	/// </summary>
+	__device__ inline bool Sphere::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float dLength = ray.d.Length();
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d / dLength));
+		Vector3f oc = tansRay.o - center;
+		Float a = Dot(tansRay.d, tansRay.d);
+		Float b = 2.0f * Dot(oc, tansRay.d);
+		Float c = Dot(oc, oc) - radius * radius;
+		Float t0, t1;
+		if (!Quadratic(a, b, c, t0, t1)) return false;
+		if (t1 <= ShadowEpsilon) return false;
+		Float tShapeHit = t0 < ShadowEpsilon ? t1 : t0;
+		if (tShapeHit >= ray.tMax * dLength) return false;
+		hit.t = tShapeHit / dLength;
+		hit.shape = this;
+		return true;
+	}
+
+	__device__ inline bool Sphere::IntersectP(const Ray& ray) const {
+		PrimitiveHit hit;
+		return Intersect(ray, hit);
+	}
 	__device__ inline bool Sphere::BoundingBox(Bounds3f& box) const {
-		box = transform(Bounds3f(center + Vector3f(-radius, -radius, -radius), center + Vector3f(radius, radius, radius)));
+		box = ObjectToWorld(Bounds3f(center + Vector3f(-radius, -radius, -radius), center + Vector3f(radius, radius, radius)));
 		return true;
 	}
 	// Shape* CreateSphereShape(Point3f center, Float radius, Material* material);
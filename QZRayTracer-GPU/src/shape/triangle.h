@@ -1,6 +1,7 @@
 #ifndef QZRT_SHAPE_TRANGLE_H
 #define QZRT_SHAPE_TRANGLE_H
 #include "../core/shape.h"
+#include "../accel/triangle_block.h"
 
 namespace raytracer {
 
@@ -16,8 +17,9 @@ namespace raytracer {
 		Normal3f n0, n1, n2;
 		__device__ Triangle(const TriangleMesh* mesh, const int triNumber, Material* mat, const  Transform& _trans = Transform())
 			: mesh(mesh), faceIndex(triNumber) {
+			flag = 1;
 			material = mat;
-			transform = _trans;
+			SetTransform(_trans);
 
 			
 			p0 = Point3f(mesh->v[mesh->faceIndices[faceIndex * mesh->faceOffset] - 1]);
@@ -70,80 +72,49 @@ namespace raytracer {
 		}
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
+		__device__ virtual bool ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const override;
+
+		/// <summary>
+		/// ֻཻԣʱֲռ t ꣬ HitRecord
+		/// ׶󽻵 Intersect ڵѯ
+		/// </summary>
+		__device__ bool Intersect(const Ray& ray, Float& tHit, Float b[3]) const;
+
+		/// <summary>
+		/// ɾֲռ t д HitRecord
+		/// </summary>
+		__device__ void ComputeHitRecord(const Ray& ray, Float t, const Float b[3], HitRecord& rec) const;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
 	};
-	__device__ inline bool Triangle::Hit(const Ray& ray, HitRecord& rec) const {
-		Transform invTrans = Inverse(transform);
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)), ray.time, ray.tMax, ray.tMin);
-
-
-		// תϵ
-		Point3f p0t = p0 - Vector3f(tansRay.o);
-		Point3f p1t = p1 - Vector3f(tansRay.o);
-		Point3f p2t = p2 - Vector3f(tansRay.o);
-
-		int kz = MaxDimension(Abs(tansRay.d));
-		int kx = kz + 1; if (kx == 3) kx = 0;
-		int ky = kx + 1; if (ky == 3) ky = 0;
-		Vector3f d = Permute(tansRay.d, kx, ky, kz);
-		p0t = Permute(p0t, kx, ky, kz);
-		p1t = Permute(p1t, kx, ky, kz);
-		p2t = Permute(p2t, kx, ky, kz);
-
-		Float Sx = -d.x / d.z;
-		Float Sy = -d.y / d.z;
-		Float Sz = 1.f / d.z;
-		p0t.x += Sx * p0t.z;
-		p0t.y += Sy * p0t.z;
-		p1t.x += Sx * p1t.z;
-		p1t.y += Sy * p1t.z;
-		p2t.x += Sx * p2t.z;
-		p2t.y += Sy * p2t.z;
-
-		// жǷཻ
-		Float e0 = p1t.x * p2t.y - p1t.y * p2t.x;
-		Float e1 = p2t.x * p0t.y - p2t.y * p0t.x;
-		Float e2 = p0t.x * p1t.y - p0t.y * p1t.x;
-
-		if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0)) {
-			//printf("Hit1!\n");
-			return false;
-		}
-		Float det = e0 + e1 + e2;
-		if (abs(det) < ShadowEpsilon) {
-			//printf("Hit2!\n");
-			return false;
-		}
-		
-		//  t (ͨԭֵ)
-		p0t.z *= Sz;
-		p1t.z *= Sz;
-		p2t.z *= Sz;
-		Float tScaled = e0 * p0t.z + e1 * p1t.z + e2 * p2t.z;
-		if (det < 0 && (tScaled >= tansRay.tMin || tScaled < tansRay.tMax * det)) {
-			//printf("Hit3!\n");
-			return false;
-		}
-		else if (det > 0 && (tScaled <= tansRay.tMin || tScaled > tansRay.tMax * det)) {
-			//printf("Hit4!\n");
-			return false;
-		}
-
-		Float invDet = 1 / det;
-		Float t = tScaled * invDet;
-		//Float erro = transform(Vector3f(ShadowEpsilon, ShadowEpsilon, ShadowEpsilon)).LengthSquared();
+	__device__ inline bool Triangle::Intersect(const Ray& ray, Float& tHit, Float b[3]) const {
+		// ֲõλķtMax ҲҪ㵽λĲϣ÷̵ tMax ʱȷ޳
+		Float dLength = ray.d.Length();
+		Ray tansRay = Ray(ray.o, ray.d / dLength, ray.time, ray.tMax * dLength, ray.tMin);
+		tansRay.o = WorldToObject(tansRay.o);
+		tansRay.d = WorldToObject(tansRay.d);
+
+		// ˮ󽻺 BVH Ҷͬһݼ㣬 triangle_block.h
+		if (!IntersectTriangleWatertight(WatertightRay(tansRay), p0, p1, p2, tansRay.tMax, tHit, b)) return false;
+		// ཻѾ WatertightRay  t ųﲻþֲռĽʹϵĵȽϣ
+		// BLAS ûб任λĹĽǡþڹϣᱻཻȫ
+		return true;
+	}
 
-		if (t < ShadowEpsilon * 100) return false;
-		Float b0 = e0 * invDet;
-		Float b1 = e1 * invDet;
-		Float b2 = e2 * invDet;
+	__device__ inline bool Triangle::Hit(const Ray& ray, HitRecord& rec) const {
+		Float t, b[3];
+		if (!Intersect(ray, t, b)) return false;
+		ComputeHitRecord(ray, t, b, rec);
+		return true;
+	}
 
-		// Interpolate $(u,v)$ parametric coordinates and hit point
+	__device__ inline void Triangle::ComputeHitRecord(const Ray& ray, Float t, const Float b[3], HitRecord& rec) const {
+		Float b0 = b[0], b1 = b[1], b2 = b[2];
 		Point3f pHit = b0 * p0 + b1 * p1 + b2 * p2;
-		Point3f tempHit = ray(t);
-		if ((pHit - tempHit).LengthSquared() < ShadowEpsilon)return false;
+		Vector3f d = WorldToObject(Normalize(ray.d));
 		Float u = b0 * uvw0.x + b1 * uvw1.x + b2 * uvw2.x;
 		Float v = b0 * uvw0.y + b1 * uvw1.y + b2 * uvw2.y;
 
@@ -151,24 +122,59 @@ namespace raytracer {
 		//Normal3f normal = Normal3f(Cross(dp02, dp12));
 
 		Normal3f pNormal = b0 * n0 + b1 * n1 + b2 * n2;
-		if (Dot(tansRay.d, pNormal) > 0) {
+		if (Dot(d, pNormal) > 0) {
 			//printf("reverse normal!\n");
 			pNormal = -pNormal;
 		}
 		
 		rec.mat = material;
-		rec.p = transform(pHit);
+		rec.p = ObjectToWorld(pHit);
 		rec.t = t;
 		rec.t0 = t;
 		rec.t1 = t;
 		rec.u = u; 
 		rec.v = v;
-		rec.normal = Normalize(transform(pNormal));
+		rec.normal = Normalize(ObjectToWorld(pNormal));
+	}
 
+	/// <summary>
+	/// BVH Ҷõ BVH ռĶͲλĹߣڱϺ;ֲռĲԿܲһ㡣
+	/// ֲռⲻʱýƽϵ꣬΢ʱص
+	/// </summary>
+	__device__ inline bool Triangle::ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const {
+		if (Hit(ray, rec)) return true;
+		Point3f p = WorldToObject(ray(hit.t));
+		Vector3f n = Cross(p1 - p0, p2 - p0);
+		Float area = Dot(n, n);
+		Float b[3];
+		b[0] = area > 0 ? Max(Dot(Cross(p1 - p, p2 - p), n) / area, Float(0)) : Float(1) / 3;
+		b[1] = area > 0 ? Max(Dot(Cross(p2 - p, p0 - p), n) / area, Float(0)) : Float(1) / 3;
+		b[2] = Max(1 - b[0] - b[1], Float(0));
+		Float sum = b[0] + b[1] + b[2];
+		for (int i = 0; i < 3; i++) b[i] /= sum;
+		ComputeHitRecord(ray, hit.t * ray.d.Length(), b, rec); // Hit  t صλ緽
+		return true;
+	}
+	/// <summary>
+	/// ֲ t ŵı任²ֱӻ㣬ռĽͶӰ
+	/// </summary>
+	__device__ inline bool Triangle::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float tLocal, b[3];
+		if (!Intersect(ray, tLocal, b)) return false;
+		Point3f pHit = b[0] * p0 + b[1] * p1 + b[2] * p2;
+		pHit = ObjectToWorld(pHit);
+		Float t = Dot(pHit - ray.o, ray.d) / Dot(ray.d, ray.d);
+		if (t >= ray.tMax) return false;
+		hit.t = t;
+		hit.shape = this;
 		return true;
 	}
+	__device__ inline bool Triangle::IntersectP(const Ray& ray) const {
+		Float t, b[3];
+		return Intersect(ray, t, b);
+	}
 	__device__ inline bool Triangle::BoundingBox(Bounds3f& box) const {
-		box = transform(Union(Bounds3f(p0, p1), Bounds3f(p1, p2)));
+		box = ObjectToWorld(Union(Bounds3f(p0, p1), Bounds3f(p1, p2)));
 		return true;
 	}
 
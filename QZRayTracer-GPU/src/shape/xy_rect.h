@@ -8,7 +8,7 @@ namespace raytracer {
 		Float x0, x1, y0, y1, k;
 		__device__ XYRect() { }
 		__device__ XYRect(Float _x0, Float _x1, Float _y0, Float _y1, Float _k, Material* mat, const  Transform& _trans = Transform()) : k(_k) {
-			transform = _trans;
+			SetTransform(_trans);
 			if (_x0 < _x1) {
 				x0 = _x0;
 				x1 = _x1;
@@ -29,6 +29,8 @@ namespace raytracer {
 		}
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
@@ -36,9 +38,7 @@ namespace raytracer {
 	__device__ inline bool XYRect::Hit(const Ray& ray, HitRecord& rec) const {
 		//printf("Hiting XYRECT----------------------------\n");
 
-		Transform invTrans = Inverse(transform);
-
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)));
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(Normalize(ray.d)));
 
 		Float t = (k - tansRay.o.z) / tansRay.d.z;
 
@@ -56,18 +56,35 @@ namespace raytracer {
 		rec.t = t;
 		rec.t0 = t;
 		rec.t1 = t;
-		rec.p = transform(Point3f(hitP.x, hitP.y, k));
+		rec.p = ObjectToWorld(Point3f(hitP.x, hitP.y, k));
 		Normal3f normal = Normal3f(0, 0, 1);
 		if (tansRay.o.z < k) {
 			normal = -normal;
 		}
-		rec.normal = Normalize(transform(normal));
+		rec.normal = Normalize(ObjectToWorld(normal));
 		rec.mat = material;
 		return true;
 	}
 
+	__device__ inline bool XYRect::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float dLength = ray.d.Length();
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d / dLength));
+		Float t = (k - tansRay.o.z) / tansRay.d.z;
+		if (t >= ray.tMax * dLength || t <= ShadowEpsilon) return false;
+		Point3f hitP = tansRay(t);
+		if (hitP.x < x0 || hitP.x > x1 || hitP.y < y0 || hitP.y > y1) return false;
+		hit.t = t / dLength;
+		hit.shape = this;
+		return true;
+	}
+
+	__device__ inline bool XYRect::IntersectP(const Ray& ray) const {
+		PrimitiveHit hit;
+		return Intersect(ray, hit);
+	}
+
 	__device__ inline bool XYRect::BoundingBox(Bounds3f& box) const {
-		box = transform(Bounds3f(Point3f(x0, y0, k - 0.001f), Point3f(x1, y1, k + 0.001f)));
+		box = ObjectToWorld(Bounds3f(Point3f(x0, y0, k - 0.001f), Point3f(x1, y1, k + 0.001f)));
 		return true;
 	}
 }
@@ -8,7 +8,7 @@ namespace raytracer {
 		Float x0, x1, z0, z1, k;
 		__device__ XZRect() {}
 		__device__ XZRect(Float _x0, Float _x1, Float _z0, Float _z1, Float _k, Material* mat, const  Transform& _trans = Transform()) : k(_k) {
-			transform = _trans;
+			SetTransform(_trans);
 			if (_x0 < _x1) {
 				x0 = _x0;
 				x1 = _x1;
@@ -28,7 +28,7 @@ namespace raytracer {
 			material = mat;
 		}
 		__device__ XZRect(Material* mat, const  Transform& _trans = Transform()) {
-			transform = _trans;
+			SetTransform(_trans);
 			x0 = -1.f;
 			x1 = 1.f;
 			z0 = -1.f;
@@ -38,14 +38,14 @@ namespace raytracer {
 		}
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
 	};
 	__device__ inline bool XZRect::Hit(const Ray& ray, HitRecord& rec) const {
-		Transform invTrans = Inverse(transform);
-
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)));
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(Normalize(ray.d)));
 		Float t = (k - tansRay.o.y) / tansRay.d.y;
 
 		if (t > tansRay.tMax || t <= ShadowEpsilon) {
@@ -62,19 +62,36 @@ namespace raytracer {
 		rec.t = t;
 		rec.t0 = t;
 		rec.t1 = t;
-		rec.p = transform(Point3f(hitP.x, k, hitP.z));
+		rec.p = ObjectToWorld(Point3f(hitP.x, k, hitP.z));
 		Normal3f normal = Normal3f(0, 1, 0);
 		if (ray.o.y < k) {
 			normal = -normal;
 			//printf("Flip Normal\n");
 		}
-		rec.normal = Normalize(transform(normal));
+		rec.normal = Normalize(ObjectToWorld(normal));
 		rec.mat = material;
 		return true;
 	}
 
+	__device__ inline bool XZRect::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float dLength = ray.d.Length();
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d / dLength));
+		Float t = (k - tansRay.o.y) / tansRay.d.y;
+		if (t >= ray.tMax * dLength || t <= ShadowEpsilon) return false;
+		Point3f hitP = tansRay(t);
+		if (hitP.x < x0 || hitP.x > x1 || hitP.z < z0 || hitP.z > z1) return false;
+		hit.t = t / dLength;
+		hit.shape = this;
+		return true;
+	}
+
+	__device__ inline bool XZRect::IntersectP(const Ray& ray) const {
+		PrimitiveHit hit;
+		return Intersect(ray, hit);
+	}
+
 	__device__ inline bool XZRect::BoundingBox(Bounds3f& box) const {
-		box = transform(Bounds3f(Point3f(x0, k - 0.001f, z0), Point3f(x1, k + 0.001f, z1)));
+		box = ObjectToWorld(Bounds3f(Point3f(x0, k - 0.001f, z0), Point3f(x1, k + 0.001f, z1)));
 		return true;
 	}
 }
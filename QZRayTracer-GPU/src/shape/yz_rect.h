@@ -8,7 +8,7 @@ namespace raytracer {
 		Float y0, y1, z0, z1, k;
 		__device__ YZRect() {}
 		__device__ YZRect(Float _y0, Float _y1, Float _z0, Float _z1, Float _k, Material* mat, const  Transform& _trans = Transform()) : k(_k) {
-			transform = _trans;
+			SetTransform(_trans);
 			if (_y0 < _y1) {
 				y0 = _y0;
 				y1 = _y1;
@@ -29,14 +29,14 @@ namespace raytracer {
 		}
 		// ͨ Shape ̳
 		__device__ virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		__device__ virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		__device__ virtual bool IntersectP(const Ray& ray) const override;
 
 		// ͨ Shape ̳
 		__device__ virtual bool BoundingBox(Bounds3f& box) const override;
 	};
 	__device__ inline bool YZRect::Hit(const Ray& ray, HitRecord& rec) const {
-		Transform invTrans = Inverse(transform);
-
-		Ray tansRay = Ray(invTrans(ray.o), invTrans(Normalize(ray.d)));
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(Normalize(ray.d)));
 		Float t = (k - tansRay.o.x) / tansRay.d.x;
 
 		if (t > tansRay.tMax || t <= ShadowEpsilon) {
@@ -53,20 +53,37 @@ namespace raytracer {
 		rec.t = t;
 		rec.t0 = t;
 		rec.t1 = t;
-		rec.p = transform(hitP);
-		rec.p = transform(Point3f(k, hitP.y, hitP.z));
+		rec.p = ObjectToWorld(hitP);
+		rec.p = ObjectToWorld(Point3f(k, hitP.y, hitP.z));
 		Normal3f normal = Normal3f(1, 0, 0);
 		if (tansRay.o.x < k) {
 			normal = -normal;
 		}
 		//printf("t:%f,rayo:%f,%f,%f,k:%f,normal:%f,%f,%f\n", t, ray.o.x, ray.o.y, ray.o.z, k, normal.x, normal.y, normal.z);
-		rec.normal = Normalize(transform(normal));
+		rec.normal = Normalize(ObjectToWorld(normal));
 		rec.mat = material;
 		return true;
 	}
 
+	__device__ inline bool YZRect::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		Float dLength = ray.d.Length();
+		Ray tansRay = Ray(WorldToObject(ray.o), WorldToObject(ray.d / dLength));
+		Float t = (k - tansRay.o.x) / tansRay.d.x;
+		if (t >= ray.tMax * dLength || t <= ShadowEpsilon) return false;
+		Point3f hitP = tansRay(t);
+		if (hitP.y < y0 || hitP.y > y1 || hitP.z < z0 || hitP.z > z1) return false;
+		hit.t = t / dLength;
+		hit.shape = this;
+		return true;
+	}
+
+	__device__ inline bool YZRect::IntersectP(const Ray& ray) const {
+		PrimitiveHit hit;
+		return Intersect(ray, hit);
+	}
+
 	__device__ inline bool YZRect::BoundingBox(Bounds3f& box) const {
-		box = transform(Bounds3f(Point3f(k - 0.001f, y0, z0), Point3f(k + 0.001f, y1, z1)));
+		box = ObjectToWorld(Bounds3f(Point3f(k - 0.001f, y0, z0), Point3f(k + 0.001f, y1, z1)));
 		return true;
 	}
 }
@@ -2,6 +2,7 @@
 #include "src/core/QZRayTracer.h"
 #include "src/core/api.h"
 #include "src/scene/example.h"
+#include <chrono>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -10,23 +11,36 @@
 using namespace raytracer;
 using namespace std;
 
-#define MAXBOUNDTIME 10
 #define ELEGANT // 用来在控制台展示进度
+//#define OCCLUSION_BENCHMARK // 渲染前比较阴影光线用 Hit 和 IntersectP 判断遮挡的速度
+//#define DISPATCH_BENCHMARK // 渲染前比较虚函数和 TaggedScene 按类型分派渲染整幅图的速度
+//#define PACKET_BENCHMARK // 渲染前比较主光线逐条求交和 8 条一包求交的速度
+//#define INTEGRATOR_BENCHMARK // 渲染前比较递归的 Color 和迭代的 ColorIterative 渲染整幅图的速度
+//#define TERMINATION_BENCHMARK // 渲染前比较固定深度和俄罗斯轮盘赌结束路径的平均路径长度和达到相同噪声的用时
+
 /// <summary>
 /// 着色器
 /// </summary>
 /// <param name="ray">光线</param>
 /// <param name="world">渲染的对象</param>
 /// <param name="depth">光线弹射次数</param>
+/// <param name="sampler">当前样本的随机数发生器</param>
+/// <param name="termination">路径的最大深度和轮盘赌设置</param>
+/// <param name="throughput">到 ray 为止衰减的乘积，用来决定轮盘赌的概率</param>
 /// <returns></returns>
-Point3f Color(const Ray& ray, shared_ptr<Shape> world, int depth) {
+Point3f Color(const Ray& ray, shared_ptr<Shape> world, int depth, Sampler& sampler, const PathTermination& termination,
+	Point3f throughput = Point3f(1, 1, 1)) {
 	HitRecord rec;
 
 	if (world->Hit(ray, rec)) {
 		Ray wo;
 		Point3f attenuation;
-		if (depth < MAXBOUNDTIME && rec.mat->Scatter(ray, rec, attenuation, wo)) {
-			return attenuation * Color(wo, world, depth + 1);
+		sampler.SetBounce(depth + 1);
+		if (depth < termination.maxDepth && rec.mat->Scatter(ray, rec, attenuation, wo, sampler)) {
+			throughput = throughput * attenuation;
+			Float survival = termination.Survive(depth + 1, throughput, sampler);
+			if (survival == 0) return Point3f();
+			return attenuation / survival * Color(wo, world, depth + 1, sampler, termination, throughput / survival);
 		}
 		else {
 			return Point3f();
@@ -34,72 +48,495 @@ Point3f Color(const Ray& ray, shared_ptr<Shape> world, int depth) {
 	}
 	else {
 		// 没击中就画个背景
-		Vector3f dir = Normalize(ray.d);
-		Float t = 0.5 * (dir.y + 1.0);
-		return Lerp(t, Point3f(1.0, 1.0, 1.0), Point3f(0.8, 0.6, 0.6));
+		return Background(ray);
+	}
+}
+
+/// <summary>
+/// 从已经求过交的光线继续追踪一条路径，hit 为 false 时 rec 无效。
+/// 和 Color 弹射的次数、随机数的消耗顺序都一样，但是用循环代替递归，衰减累乘在 throughput 里，
+/// 场景只按引用访问，HitRecord 里的材质是裸指针，整条路径没有堆分配，也不增减引用计数
+/// </summary>
+/// <param name="ray">光线</param>
+/// <param name="hit">ray 是否击中</param>
+/// <param name="rec">ray 的交点，之后每次弹射复用</param>
+/// <param name="world">渲染的对象</param>
+/// <param name="sampler">当前样本的随机数发生器</param>
+/// <param name="termination">路径的最大深度和轮盘赌设置</param>
+/// <param name="pathLength">不为空时写入这条路径一共求交的光线数，包括主光线</param>
+/// <returns></returns>
+Point3f TracePath(Ray ray, bool hit, HitRecord& rec, const Shape& world, Sampler& sampler, const PathTermination& termination,
+	int* pathLength = nullptr) {
+	Point3f throughput(1, 1, 1);
+	int depth = 0;
+	for (; hit; depth++) {
+		Ray wo;
+		Point3f attenuation;
+		sampler.SetBounce(depth + 1);
+		if (depth >= termination.maxDepth || !rec.mat->Scatter(ray, rec, attenuation, wo, sampler)) break;
+		throughput = throughput * attenuation;
+		Float survival = termination.Survive(depth + 1, throughput, sampler);
+		if (survival == 0) break;
+		throughput /= survival;
+		ray = wo;
+		hit = world.Hit(ray, rec);
 	}
+	if (pathLength) *pathLength = depth + 1;
+	// 循环中途结束时路径被吸收或者被轮盘赌结束，没有贡献
+	return hit ? Point3f() : throughput * Background(ray);
 }
 
+/// <summary>
+/// 迭代的着色器，见 TracePath
+/// </summary>
+Point3f ColorIterative(const Ray& ray, const Shape& world, Sampler& sampler, const PathTermination& termination,
+	int* pathLength = nullptr) {
+	HitRecord rec;
+	bool hit = world.Hit(ray, rec);
+	return TracePath(ray, hit, rec, world, sampler, termination, pathLength);
+}
 
-void Renderer(RendererSet& set) {
-	// 参数设置
-	Camera camera = set.camera;
+/// <summary>
+/// 和 Color 相同的着色器，求交和散射都由 TaggedScene 按类型分派，不经过虚函数，
+/// 随机数的消耗顺序也相同，两者渲染出的图像一致
+/// </summary>
+Point3f Color(const Ray& ray, const TaggedScene& scene, int depth, Sampler& sampler, const PathTermination& termination,
+	Point3f throughput = Point3f(1, 1, 1)) {
+	TaggedHit hit;
+
+	if (scene.Intersect(ray, hit)) {
+		Ray wo;
+		Point3f attenuation;
+		sampler.SetBounce(depth + 1);
+		if (depth < termination.maxDepth && scene.Scatter(ray, hit, attenuation, wo, sampler)) {
+			throughput = throughput * attenuation;
+			Float survival = termination.Survive(depth + 1, throughput, sampler);
+			if (survival == 0) return Point3f();
+			return attenuation / survival * Color(wo, scene, depth + 1, sampler, termination, throughput / survival);
+		}
+		else {
+			return Point3f();
+		}
+	}
+	else {
+		return Background(ray);
+	}
+}
+
+
+/// <summary>
+/// 把像素的平均颜色做 gamma 矫正后写入帧缓冲
+/// </summary>
+void WritePixel(unsigned char* data, int pixelIndex, Point3f color) {
+	color = Point3f(pow(color.x, Gamma), pow(color.y, Gamma), pow(color.z, Gamma)); // gamma矫正
+	int ir = int(255.99 * color[0]);
+	int ig = int(255.99 * color[1]);
+	int ib = int(255.99 * color[2]);
+
+	int shadingPoint = pixelIndex * 3;
+	data[shadingPoint] = ir;
+	data[shadingPoint + 1] = ig;
+	data[shadingPoint + 2] = ib;
+}
+
+
+/// <summary>
+/// 渲染图像中的一块，每个像素只会被一个块写入，所以写帧缓冲不需要加锁
+/// </summary>
+/// <param name="set">渲染设置</param>
+/// <param name="tile">要渲染的块</param>
+/// <param name="data">帧缓冲</param>
+/// <param name="tagged">不为空时用按类型分派的场景代替 set.shapes，否则按 set.integrator 选择 Color 或 ColorIterative</param>
+void RenderTile(const RendererSet& set, const Tile& tile, unsigned char* data, const TaggedScene* tagged = nullptr) {
+	const Camera& camera = set.camera;
 	int spp = set.spp;
 	int depth = 0;
+	int width = set.width, height = set.height;
+	Float invSpp = 1.0 / Float(spp);
+
+	// 包含所有Shape的场景
+	std::shared_ptr<Shape> world = set.shapes;
+
+	for (auto sy = tile.y0; sy < tile.y1; sy++) {
+		for (auto sx = tile.x0; sx < tile.x1; sx++) {
+			int pixelIndex = sy * width + sx;
+			Point3f color;
+			// 采样计算
+			for (auto s = 0; s < spp; s++) {
+				// 随机数只由 (种子, 像素, 样本, 弹射次数, 维度) 决定，结果与线程数和块的处理顺序无关
+				Sampler sampler(set.seed, pixelIndex, s);
+				Float u = Float(sx + sampler.Get1D()) / Float(width);
+				Float v = Float(height - sy - 1 + sampler.Get1D()) / Float(height);
+				Ray ray = camera.GenerateRay(u, v, sampler);
+				if (tagged) color += Color(ray, *tagged, depth, sampler, set.termination);
+				else if (set.integrator == IntegratorType::Recursive) color += Color(ray, world, depth, sampler, set.termination);
+				else color += ColorIterative(ray, *world, sampler, set.termination);
+			}
+			WritePixel(data, pixelIndex, color * invSpp);
+		}
+	}
+}
+
+
+/// <summary>
+/// 和 RenderTile 使用 ColorIterative 时相同的渲染，主光线按 4x2 的像素块 8 条一包求交，之后的弹射仍然逐条追踪。
+/// 同一个样本下的 8 条主光线几乎平行，遍历时大多命中同样的节点。
+/// 每个像素的采样和累加顺序不变，渲染结果和 RenderTile 一致
+/// </summary>
+void RenderTilePackets(const RendererSet& set, const Tile& tile, unsigned char* data, const Accelerator& accel) {
+	const int packetWidth = 4, packetHeight = RayPacket8::Size / packetWidth;
+	const Camera& camera = set.camera;
+	int spp = set.spp;
+	int width = set.width, height = set.height;
+	Float invSpp = 1.0 / Float(spp);
+
+	for (auto by = tile.y0; by < tile.y1; by += packetHeight) {
+		for (auto bx = tile.x0; bx < tile.x1; bx += packetWidth) {
+			Point3f colors[RayPacket8::Size];
+			for (auto s = 0; s < spp; s++) {
+				RayPacket8 packet;
+				Sampler samplers[RayPacket8::Size];
+				for (int lane = 0; lane < RayPacket8::Size; lane++) {
+					int sx = bx + lane % packetWidth, sy = by + lane / packetWidth;
+					if (sx >= tile.x1 || sy >= tile.y1) continue;
+					int pixelIndex = sy * width + sx;
+					Sampler& sampler = samplers[lane];
+					sampler = Sampler(set.seed, pixelIndex, s);
+					Float u = Float(sx + sampler.Get1D()) / Float(width);
+					Float v = Float(height - sy - 1 + sampler.Get1D()) / Float(height);
+					packet.Set(lane, camera.GenerateRay(u, v, sampler));
+				}
+				HitPacket8 hits;
+				accel.IntersectPacket(packet, hits);
+				for (int lane = 0; lane < RayPacket8::Size; lane++) {
+					if (!(packet.activeMask & (1 << lane))) continue;
+					const Ray& ray = packet.rays[lane];
+					HitRecord rec;
+					bool hit = hits.hitMask & (1 << lane);
+					if (hit) hits.hits[lane].shape->ComputeSurfaceInteraction(ray, hits.hits[lane], rec);
+					colors[lane] += TracePath(ray, hit, rec, accel, samplers[lane], set.termination);
+				}
+			}
+			for (int lane = 0; lane < RayPacket8::Size; lane++) {
+				int sx = bx + lane % packetWidth, sy = by + lane / packetWidth;
+				if (sx < tile.x1 && sy < tile.y1) WritePixel(data, sy * width + sx, colors[lane] * invSpp);
+			}
+		}
+	}
+}
+
+
+/// <summary>
+/// 用波前积分器渲染一块，integrator 每个线程一个，路径池在块之间复用
+/// </summary>
+void RenderTileWavefront(const RendererSet& set, const Tile& tile, unsigned char* data, WavefrontIntegrator& integrator) {
+	int width = set.width;
+	int tileWidth = tile.x1 - tile.x0;
+	std::vector<Point3f> colors;
+	integrator.Render(tile, colors);
+	for (auto sy = tile.y0; sy < tile.y1; sy++) {
+		for (auto sx = tile.x0; sx < tile.x1; sx++) {
+			WritePixel(data, sy * width + sx, colors[(sy - tile.y0) * tileWidth + sx - tile.x0]);
+		}
+	}
+}
+
+
+/// <summary>
+/// 阴影光线的基准测试：每个像素发一条主光线，从交点朝法线一侧的随机方向发出 nShadowRays 条阴影光线，
+/// 一半不限长度（能否看到天空），一半只到 aoRadius（环境光遮蔽），分别用 Hit 和 IntersectP 判断是否被遮挡。
+/// 两种方式的遮挡结果应当完全一样
+/// </summary>
+void BenchmarkOcclusion(const RendererSet& set, int nShadowRays = 4, Float aoRadius = 1) {
+	const Camera& camera = set.camera;
+	int width = set.width, height = set.height;
+	const Shape* world = set.shapes.get();
+	std::vector<Ray> shadowRays;
+	for (int sy = 0; sy < height; sy++) {
+		for (int sx = 0; sx < width; sx++) {
+			int pixelIndex = sy * width + sx;
+			Sampler sampler(set.seed, pixelIndex, 0);
+			Ray ray = camera.GenerateRay(Float(sx + 0.5) / Float(width), Float(height - sy - 0.5) / Float(height), sampler);
+			HitRecord rec;
+			if (!world->Hit(ray, rec)) continue;
+			for (int i = 0; i < nShadowRays; i++) {
+				sampler.SetBounce(i + 1);
+				Vector3f dir = Vector3f(rec.normal) + Vector3f(RandomInUnitSphere(sampler));
+				shadowRays.push_back(Ray(rec.p, dir, i % 2 ? aoRadius / dir.Length() : Infinity));
+			}
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	int occludedHit = 0;
+	for (const Ray& ray : shadowRays) {
+		HitRecord rec;
+		if (world->Hit(ray, rec)) occludedHit++;
+	}
+	auto hitTime = std::chrono::steady_clock::now();
+	int occludedP = 0;
+	for (const Ray& ray : shadowRays) {
+		if (world->IntersectP(ray)) occludedP++;
+	}
+	auto intersectPTime = std::chrono::steady_clock::now();
+	Float hitSeconds = std::chrono::duration<Float>(hitTime - start).count();
+	Float intersectPSeconds = std::chrono::duration<Float>(intersectPTime - hitTime).count();
+	cout << "Occlusion benchmark: " << shadowRays.size() << " shadow rays, " << occludedHit << " occluded by Hit, "
+		<< occludedP << " occluded by IntersectP" << endl;
+	cout << "Hit " << shadowRays.size() / hitSeconds * 1e-6 << " Mrays/s, IntersectP " << shadowRays.size() / intersectPSeconds * 1e-6
+		<< " Mrays/s, speedup " << hitSeconds / intersectPSeconds << "x" << endl;
+}
+
+
+/// <summary>
+/// 分派方式的基准测试：同一个场景分别用虚函数和 TaggedScene 渲染整幅图，比较用时，并检查两幅图是否一致
+/// </summary>
+void BenchmarkDispatch(const RendererSet& set) {
+	int width = set.width, height = set.height;
+	int nThreads = set.threads > 0 ? set.threads : NumSystemCores();
+	std::vector<unsigned char> virtualImage(width * height * 3), taggedImage(width * height * 3);
+
+	auto start = std::chrono::steady_clock::now();
+	TaggedScene tagged(set.shapes);
+	auto buildTime = std::chrono::steady_clock::now();
+	TileScheduler virtualScheduler(width, height, set.tileSize, nThreads);
+	ParallelForTiles(virtualScheduler, [&](const Tile& tile, int) {
+		RenderTile(set, tile, virtualImage.data());
+	});
+	auto virtualTime = std::chrono::steady_clock::now();
+	TileScheduler taggedScheduler(width, height, set.tileSize, nThreads);
+	ParallelForTiles(taggedScheduler, [&](const Tile& tile, int) {
+		RenderTile(set, tile, taggedImage.data(), &tagged);
+	});
+	auto taggedTime = std::chrono::steady_clock::now();
+
+	Float virtualSeconds = std::chrono::duration<Float>(virtualTime - buildTime).count();
+	Float taggedSeconds = std::chrono::duration<Float>(taggedTime - virtualTime).count();
+	tagged.ReportStats();
+	cout << "Dispatch benchmark: virtual " << virtualSeconds << "s, tagged " << taggedSeconds << "s (+"
+		<< std::chrono::duration<Float>(buildTime - start).count() * 1000 << "ms to build), speedup "
+		<< virtualSeconds / taggedSeconds << "x, images " << (virtualImage == taggedImage ? "identical" : "differ") << endl;
+}
+
+
+/// <summary>
+/// 光线包的基准测试：每个像素一条主光线，按 4x2 的像素块打包，分别用 Intersect 逐条求交和 IntersectPacket 一包求交，
+/// 比较吞吐量，并检查两种方式每条光线的交点距离和图元是否完全一样
+/// </summary>
+void BenchmarkPackets(const RendererSet& set) {
+	const Accelerator* accel = dynamic_cast<const Accelerator*>(set.shapes.get());
+	if (!accel) {
+		cout << "Packet benchmark: the scene is not an Accelerator" << endl;
+		return;
+	}
+	const int packetWidth = 4, packetHeight = RayPacket8::Size / packetWidth;
+	const Camera& camera = set.camera;
+	int width = set.width, height = set.height;
+	std::vector<RayPacket8> packets;
+	for (int by = 0; by < height; by += packetHeight) {
+		for (int bx = 0; bx < width; bx += packetWidth) {
+			RayPacket8 packet;
+			for (int lane = 0; lane < RayPacket8::Size; lane++) {
+				int sx = bx + lane % packetWidth, sy = by + lane / packetWidth;
+				if (sx >= width || sy >= height) continue;
+				Sampler sampler(set.seed, sy * width + sx, 0);
+				packet.Set(lane, camera.GenerateRay(Float(sx + 0.5) / Float(width), Float(height - sy - 0.5) / Float(height), sampler));
+			}
+			packets.push_back(packet);
+		}
+	}
+
+	std::vector<HitPacket8> singleHits(packets.size()), packetHits(packets.size());
+	int nRays = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < packets.size(); i++) {
+		for (int lane = 0; lane < RayPacket8::Size; lane++) {
+			if (!(packets[i].activeMask & (1 << lane))) continue;
+			nRays++;
+			if (accel->Intersect(packets[i].rays[lane], singleHits[i].hits[lane])) singleHits[i].hitMask |= 1 << lane;
+		}
+	}
+	auto singleTime = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < packets.size(); i++) {
+		accel->IntersectPacket(packets[i], packetHits[i]);
+	}
+	auto packetTime = std::chrono::steady_clock::now();
+
+	int mismatches = 0;
+	for (size_t i = 0; i < packets.size(); i++) {
+		for (int lane = 0; lane < RayPacket8::Size; lane++) {
+			int bit = 1 << lane;
+			if ((singleHits[i].hitMask & bit) != (packetHits[i].hitMask & bit)) mismatches++;
+			else if ((singleHits[i].hitMask & bit) && (singleHits[i].hits[lane].t != packetHits[i].hits[lane].t ||
+				singleHits[i].hits[lane].shape != packetHits[i].hits[lane].shape)) mismatches++;
+		}
+	}
+	Float singleSeconds = std::chrono::duration<Float>(singleTime - start).count();
+	Float packetSeconds = std::chrono::duration<Float>(packetTime - singleTime).count();
+	cout << "Packet benchmark: " << nRays << " primary rays in " << packets.size() << " packets, single "
+		<< nRays / singleSeconds * 1e-6 << " Mrays/s, packet " << nRays / packetSeconds * 1e-6 << " Mrays/s, speedup "
+		<< singleSeconds / packetSeconds << "x, " << mismatches << " mismatches" << endl;
+}
+
+
+/// <summary>
+/// 积分器的基准测试：同一个场景交替用递归的 Color 和迭代的 ColorIterative 渲染整幅图（都不用光线包），
+/// 各取 nRounds 次里最快的一次比较。两者只有衰减连乘的顺序不同，图像最多差一个色阶
+/// </summary>
+void BenchmarkIntegrators(const RendererSet& set, int nRounds = 3) {
+	int width = set.width, height = set.height;
+	int nThreads = set.threads > 0 ? set.threads : NumSystemCores();
+	RendererSet recursiveSet = set, iterativeSet = set;
+	recursiveSet.integrator = IntegratorType::Recursive;
+	iterativeSet.integrator = IntegratorType::Iterative;
+	std::vector<unsigned char> recursiveImage(width * height * 3), iterativeImage(width * height * 3);
+
+	auto render = [&](const RendererSet& s, std::vector<unsigned char>& image) {
+		auto start = std::chrono::steady_clock::now();
+		TileScheduler scheduler(width, height, s.tileSize, nThreads);
+		ParallelForTiles(scheduler, [&](const Tile& tile, int) {
+			RenderTile(s, tile, image.data());
+		});
+		return std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	};
+	Float recursiveSeconds = Infinity, iterativeSeconds = Infinity;
+	for (int i = 0; i < nRounds; i++) {
+		recursiveSeconds = std::min(recursiveSeconds, render(recursiveSet, recursiveImage));
+		iterativeSeconds = std::min(iterativeSeconds, render(iterativeSet, iterativeImage));
+	}
+
+	int maxDifference = 0;
+	for (size_t i = 0; i < recursiveImage.size(); i++) {
+		maxDifference = std::max(maxDifference, std::abs(int(recursiveImage[i]) - int(iterativeImage[i])));
+	}
+	cout << "Integrator benchmark: " << nThreads << " threads, recursive " << recursiveSeconds << "s, iterative "
+		<< iterativeSeconds << "s, speedup " << recursiveSeconds / iterativeSeconds << "x, max pixel difference " << maxDifference << endl;
+}
+
+
+/// <summary>
+/// 路径结束方式的基准测试：同一个场景分别用固定深度（只在 maxDepth 截断）和俄罗斯轮盘赌渲染整幅图，最大深度相同，
+/// 两者收敛到同一幅图。统计平均路径长度、用时，以及每个像素估计值的方差（按亮度，即三个通道的平均），
+/// 噪声的方差和样本数成反比，所以达到相同噪声的用时正比于 用时 × 方差
+/// </summary>
+void BenchmarkTermination(const RendererSet& set) {
+	int width = set.width, height = set.height;
+	int nThreads = set.threads > 0 ? set.threads : NumSystemCores();
+	const Shape& world = *set.shapes;
+	PathTermination fixedDepth = set.termination, roulette = set.termination;
+	fixedDepth.russianRoulette = false;
+	roulette.russianRoulette = true;
+
+	auto run = [&](const PathTermination& termination, const char* name) {
+		std::vector<Float> means(width * height), variances(width * height);
+		TileScheduler scheduler(width, height, set.tileSize, nThreads);
+		std::vector<uint64_t> rays(scheduler.NumThreads(), 0);
+		auto start = std::chrono::steady_clock::now();
+		ParallelForTiles(scheduler, [&](const Tile& tile, int threadIndex) {
+			for (auto sy = tile.y0; sy < tile.y1; sy++) {
+				for (auto sx = tile.x0; sx < tile.x1; sx++) {
+					int pixelIndex = sy * width + sx;
+					Float sum = 0, sumSquares = 0;
+					for (auto s = 0; s < set.spp; s++) {
+						Sampler sampler(set.seed, pixelIndex, s);
+						Float u = Float(sx + sampler.Get1D()) / Float(width);
+						Float v = Float(height - sy - 1 + sampler.Get1D()) / Float(height);
+						int pathLength;
+						Point3f color = ColorIterative(set.camera.GenerateRay(u, v, sampler), world, sampler, termination, &pathLength);
+						Float y = (color.x + color.y + color.z) / 3;
+						sum += y;
+						sumSquares += y * y;
+						rays[threadIndex] += pathLength;
+					}
+					Float mean = sum / set.spp;
+					means[pixelIndex] = mean;
+					// 单个样本的方差除以样本数是像素估计值的方差
+					variances[pixelIndex] = std::max(Float(0), sumSquares / set.spp - mean * mean) / set.spp;
+				}
+			}
+		});
+		Float seconds = std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+		uint64_t totalRays = 0;
+		for (uint64_t n : rays) totalRays += n;
+		Float meanValue = 0, meanVariance = 0;
+		for (int i = 0; i < width * height; i++) {
+			meanValue += means[i];
+			meanVariance += variances[i];
+		}
+		meanValue /= width * height;
+		meanVariance /= width * height;
+		cout << "Termination benchmark: " << name << " mean path length " << Float(totalRays) / (Float(width) * height * set.spp)
+			<< ", " << seconds << "s, mean luminance " << meanValue << ", mean pixel variance " << meanVariance << endl;
+		return seconds * meanVariance;
+	};
+	Float fixedCost = run(fixedDepth, "fixed depth");
+	Float rouletteCost = run(roulette, "russian roulette");
+	cout << "Termination benchmark: max depth " << set.termination.maxDepth << ", roulette from depth " << roulette.rrStartDepth
+		<< ", survival in [" << roulette.minSurvival << ", " << roulette.maxSurvival << "], time to equal noise "
+		<< fixedCost / rouletteCost << "x faster" << endl;
+}
+
+
+void Renderer(RendererSet& set) {
+	// 参数设置
 	int width = set.width, height = set.height, channel = 3;
 	const char* savePath = set.savePath;
-	Float invSpp = 1.0 / Float(spp);
+	int nThreads = set.threads > 0 ? set.threads : NumSystemCores();
 
 	auto* data = (unsigned char*)malloc(width * height * channel);
+	std::unique_ptr<TaggedScene> tagged;
+	if (set.taggedDispatch) tagged.reset(new TaggedScene(set.shapes));
 
-	// 包含所有Shape的场景
-	std::shared_ptr<Shape> world = set.shapes;
+	TileScheduler scheduler(width, height, set.tileSize, nThreads);
+	cout << "Rendering " << scheduler.NumTiles() << " tiles with " << scheduler.NumThreads() << " threads" << endl;
+	std::vector<std::unique_ptr<WavefrontIntegrator>> wavefront;
+	if (set.integrator == IntegratorType::Wavefront) {
+		for (int i = 0; i < scheduler.NumThreads(); i++) wavefront.emplace_back(new WavefrontIntegrator(set));
+	}
 
 #ifdef ELEGANT
-	ProgressBar bar(height);
+	ProgressBar bar(scheduler.NumTiles());
 	bar.set_todo_char(" ");
 	bar.set_done_char("█");
 	bar.set_opening_bracket_char("Rendering:[");
 	bar.set_closing_bracket_char("]");
+	std::mutex barMutex;
 #endif // ELEGANT
-	for (auto sy = height - 1; sy >= 0; sy--) {
-		for (auto sx = 0; sx < width; sx++) {
-			Point3f color;
-			// 采样计算
-			for (auto s = 0; s < spp; s++) {
-				Float u = Float(sx + randomNum(seeds)) / Float(width);
-				Float v = Float(height - sy - 1 + randomNum(seeds)) / Float(height);
-				Ray ray = camera.GenerateRay(u, v);
-				color += Color(ray, world, depth);
-			}
-			color *= invSpp; // 求平均值
-			color = Point3f(pow(color.x, Gamma), pow(color.y, Gamma), pow(color.z, Gamma)); // gamma矫正
-			int ir = int(255.99 * color[0]);
-			int ig = int(255.99 * color[1]);
-			int ib = int(255.99 * color[2]);
-
-			int shadingPoint = (sy * width + sx) * 3;
-			data[shadingPoint] = ir;
-			data[shadingPoint + 1] = ig;
-			data[shadingPoint + 2] = ib;
-		}
-
+	// 按类型分派的场景没有光线包接口，只在迭代积分器的虚函数路径上用
+	const Accelerator* accel = set.packetTracing && !tagged && set.integrator == IntegratorType::Iterative ?
+		dynamic_cast<const Accelerator*>(set.shapes.get()) : nullptr;
+	ParallelForTiles(scheduler, [&](const Tile& tile, int threadIndex) {
+		if (!wavefront.empty()) RenderTileWavefront(set, tile, data, *wavefront[threadIndex]);
+		else if (accel) RenderTilePackets(set, tile, data, *accel);
+		else RenderTile(set, tile, data, tagged.get());
 #ifdef ELEGANT
+		std::lock_guard<std::mutex> lock(barMutex);
 		bar.update();
-#endif // ELEGANT		
-	}
+#endif // ELEGANT
+	});
 
 	// 写入图像
 	stbi_write_png(savePath, width, height, channel, data, 0);
 	stbi_image_free(data);
 	cout << endl;
+	if (scheduler.NumThreads() > 1) {
+		cout << "Tiles stolen between threads: " << scheduler.NumStolen() << endl;
+	}
+	if (auto bvh = std::dynamic_pointer_cast<Accelerator>(set.shapes)) {
+		bvh->ReportStats();
+	}
+	if (tagged) tagged->ReportStats();
+	if (!wavefront.empty()) {
+		WavefrontStats stats;
+		for (auto& integrator : wavefront) stats += integrator->Stats();
+		stats.Report();
+	}
 }
 
 
 int main() {
-	// 记录用时
-	clock_t start, end;
-	start = clock();
+	// 记录用时，多线程下 clock() 统计的是所有线程的CPU时间，这里用挂钟时间
+	auto start = std::chrono::steady_clock::now();
 	seeds.seed(time(0));
 
 	std::cout << "        wWw  wWw(o)__(o)\\\\  //     .-.     ))           _oo  \\\\  //       \\\\\\  ///   \\/       .-.    wW  Ww\\\\\\  ///   \\/    " << std::endl;
@@ -111,6 +548,21 @@ int main() {
 	std::cout << "-'   ''  `-..-'   (              `-...-'   )          `--.._)      -'   ''(_/  \\_) `-.(_.'  `-...(_.'      (_/  \\_) `-.(_.' " << std::endl << std::endl;
 
 	RendererSet renderSet = ShapeTestCylinderScene();
+#ifdef OCCLUSION_BENCHMARK
+	BenchmarkOcclusion(renderSet);
+#endif // OCCLUSION_BENCHMARK
+#ifdef DISPATCH_BENCHMARK
+	BenchmarkDispatch(renderSet);
+#endif // DISPATCH_BENCHMARK
+#ifdef PACKET_BENCHMARK
+	BenchmarkPackets(renderSet);
+#endif // PACKET_BENCHMARK
+#ifdef INTEGRATOR_BENCHMARK
+	BenchmarkIntegrators(renderSet);
+#endif // INTEGRATOR_BENCHMARK
+#ifdef TERMINATION_BENCHMARK
+	BenchmarkTermination(renderSet);
+#endif // TERMINATION_BENCHMARK
 	
 	
 	Renderer(renderSet);
@@ -123,8 +575,8 @@ int main() {
 		tempPath.str("");
 	}*/
 
-	end = clock();   //结束时间
-	cout << "\n\nRenderer time is " << Float(end - start) / CLOCKS_PER_SEC << "s" << endl;  //输出时间（单位：ms）
+	auto end = std::chrono::steady_clock::now();   //结束时间
+	cout << "\n\nRenderer time is " << std::chrono::duration<Float>(end - start).count() << "s" << endl;  //输出时间（单位：s）
 
 }
 
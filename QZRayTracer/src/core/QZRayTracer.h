@@ -33,6 +33,8 @@ namespace raytracer {
 	template <typename T>
 	class Normal3;
 	class Ray;
+	template <typename T>
+	class Bounds3;
 	class Shape;
 	class ShapeList;
 	class Material;
@@ -68,8 +70,9 @@ namespace raytracer {
 	static QZRT_CONSTEXPR Float Rad2Degree = 57.29577951308232087680;
 	static QZRT_CONSTEXPR Float Degree2Rad = 0.01745329251994329577;
 	static QZRT_CONSTEXPR Float Gamma = 1.0 / 2.2;
-	static std::default_random_engine seeds;
-	static std::uniform_real_distribution<Float> randomNum(0, 1); // ұ
+	//  parallel.cpp Уÿ߳һݣֻڹȾʱ Sampler ṩ
+	extern thread_local std::default_random_engine seeds;
+	extern thread_local std::uniform_real_distribution<Float> randomNum; // ұ
 	// Global Inline Functions
 
 	// Global Inline Functions
@@ -6,11 +6,17 @@
 #include "geometry.h"
 #include "shape.h"
 #include "material.h"
+#include "sampler.h"
 #include "camera.h"
 #include "paramset.h"
+#include "parallel.h"
+#include "wavefront.h"
 #include "../shape/sphere.h"
 #include "../shape/shapeList.h"
 #include "../shape/cylinder.h"
+#include "../shape/bvh.h"
+#include "../shape/wide_bvh.h"
+#include "../shape/tagged_scene.h"
 #include "../material/lambertian.h"
 #include "../material/metal.h"
 #include "../material/dielectric.h"
@@ -3,6 +3,7 @@
 
 #include "QZRayTracer.h"
 #include "geometry.h"
+#include "sampler.h"
 
 namespace raytracer{
 	class Camera {
@@ -74,8 +75,8 @@ namespace raytracer{
 			vertical = 2 * halfHeight * v * focusDis;
 		}
 
-		Ray GenerateRay(Float s, Float t) {
-			Point3f randomLoc = lensRadius * RandomInUnitDisk();
+		Ray GenerateRay(Float s, Float t, Sampler& sampler) const {
+			Point3f randomLoc = lensRadius * RandomInUnitDisk(sampler);
 			Vector3f offset = u * randomLoc.x + v * randomLoc.y;
 			return Ray(origin + offset, lowerLeftCorner + s * horizontal + t * vertical - Vector3f(origin) - offset);
 		}
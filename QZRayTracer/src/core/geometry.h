@@ -971,34 +971,118 @@ namespace raytracer {
     };
 
 
-    /// <summary>
-    /// һλڲһ
-    /// </summary>
-    /// <returns></returns>
-    inline Point3<Float> RandomInUnitSphere() {
-        Vector3f p;
-        // 
-        // std::uniform_real_distribution<Float> randomNum(0, 1); // ұ
-        do {
-            p = 2.0 * Vector3f(randomNum(seeds), randomNum(seeds), randomNum(seeds)) - Vector3f(1, 1, 1);
-        } while (Dot(p, p) >= 1.0);
+    template <typename T>
+    class Bounds3 {
+    public:
+        // Bounds3 Public Methods
+        Bounds3() {
+            T minNum = std::numeric_limits<T>::lowest();
+            T maxNum = std::numeric_limits<T>::max();
+            pMin = Point3<T>(maxNum, maxNum, maxNum);
+            pMax = Point3<T>(minNum, minNum, minNum);
+        }
+        explicit Bounds3(const Point3<T>& p) : pMin(p), pMax(p) {}
+        Bounds3(const Point3<T>& p1, const Point3<T>& p2)
+            : pMin(std::min(p1.x, p2.x), std::min(p1.y, p2.y),
+                std::min(p1.z, p2.z)),
+            pMax(std::max(p1.x, p2.x), std::max(p1.y, p2.y),
+                std::max(p1.z, p2.z)) {
+        }
+        const Point3<T>& operator[](int i) const {
+            DCHECK(i == 0 || i == 1);
+            return (i == 0) ? pMin : pMax;
+        }
+        Point3<T>& operator[](int i) {
+            DCHECK(i == 0 || i == 1);
+            return (i == 0) ? pMin : pMax;
+        }
+        Vector3<T> Diagonal() const { return pMax - pMin; }
+        T SurfaceArea() const {
+            Vector3<T> d = Diagonal();
+            return 2 * (d.x * d.y + d.x * d.z + d.y * d.z);
+        }
+        int MaximumExtent() const {
+            Vector3<T> d = Diagonal();
+            if (d.x > d.y && d.x > d.z)
+                return 0;
+            else if (d.y > d.z)
+                return 1;
+            else
+                return 2;
+        }
+        Vector3<T> Offset(const Point3<T>& p) const {
+            Vector3<T> o = p - pMin;
+            if (pMax.x > pMin.x) o.x /= pMax.x - pMin.x;
+            if (pMax.y > pMin.y) o.y /= pMax.y - pMin.y;
+            if (pMax.z > pMin.z) o.z /= pMax.z - pMin.z;
+            return o;
+        }
+        bool IntersectP(const Ray& ray, Float* hitt0 = nullptr, Float* hitt1 = nullptr) const;
+        // Ԥù߷ĵͷţBVHʱÿӲ
+        inline bool IntersectP(const Ray& ray, const Vector3f& invDir, const int dirIsNeg[3]) const;
+
+        // Bounds3 Public Data
+        Point3<T> pMin, pMax;
+    };
 
+    typedef Bounds3<Float> Bounds3f;
+    typedef Bounds3<int> Bounds3i;
 
-        return Point3<Float>(p);
+    template <typename T>
+    Bounds3<T> Union(const Bounds3<T>& b, const Point3<T>& p) {
+        Bounds3<T> ret;
+        ret.pMin = Min(b.pMin, p);
+        ret.pMax = Max(b.pMax, p);
+        return ret;
     }
 
-    /// <summary>
-    /// һλԲڲһ
-    /// </summary>
-    /// <returns></returns>
-    inline Point3<Float> RandomInUnitDisk() {
-        Vector3f p;
-        do {
-            p = 2.0 * Vector3f(randomNum(seeds), randomNum(seeds), 0) - Vector3f(1, 1, 0);
-        } while (Dot(p, p) >= 1.0);
+    template <typename T>
+    Bounds3<T> Union(const Bounds3<T>& b1, const Bounds3<T>& b2) {
+        Bounds3<T> ret;
+        ret.pMin = Min(b1.pMin, b2.pMin);
+        ret.pMax = Max(b1.pMax, b2.pMax);
+        return ret;
+    }
+
+    template <typename T>
+    inline bool Bounds3<T>::IntersectP(const Ray& ray, Float* hitt0, Float* hitt1) const {
+        Float t0 = 0, t1 = ray.tMax;
+        for (int i = 0; i < 3; ++i) {
+            // Update interval for _i_th bounding box slab
+            Float invRayDir = 1 / ray.d[i];
+            Float tNear = (pMin[i] - ray.o[i]) * invRayDir;
+            Float tFar = (pMax[i] - ray.o[i]) * invRayDir;
 
+            // Update parametric interval from slab intersection $t$ values
+            if (tNear > tFar) std::swap(tNear, tFar);
+            t0 = tNear > t0 ? tNear : t0;
+            t1 = tFar < t1 ? tFar : t1;
+            if (t0 > t1) return false;
+        }
+        if (hitt0) *hitt0 = t0;
+        if (hitt1) *hitt1 = t1;
+        return true;
+    }
 
-        return Point3<Float>(p);
+    template <typename T>
+    inline bool Bounds3<T>::IntersectP(const Ray& ray, const Vector3f& invDir, const int dirIsNeg[3]) const {
+        const Bounds3f& bounds = *this;
+        // Check for ray intersection against $x$ and $y$ slabs
+        Float tMin = (bounds[dirIsNeg[0]].x - ray.o.x) * invDir.x;
+        Float tMax = (bounds[1 - dirIsNeg[0]].x - ray.o.x) * invDir.x;
+        Float tyMin = (bounds[dirIsNeg[1]].y - ray.o.y) * invDir.y;
+        Float tyMax = (bounds[1 - dirIsNeg[1]].y - ray.o.y) * invDir.y;
+        if (tMin > tyMax || tyMin > tMax) return false;
+        if (tyMin > tMin) tMin = tyMin;
+        if (tyMax < tMax) tMax = tyMax;
+
+        // Check for ray intersection against $z$ slab
+        Float tzMin = (bounds[dirIsNeg[2]].z - ray.o.z) * invDir.z;
+        Float tzMax = (bounds[1 - dirIsNeg[2]].z - ray.o.z) * invDir.z;
+        if (tMin > tzMax || tzMin > tMax) return false;
+        if (tzMin > tMin) tMin = tzMin;
+        if (tzMax < tMax) tMax = tzMax;
+        return (tMin < ray.tMax) && (tMax > 0);
     }
 
     // Global Constants
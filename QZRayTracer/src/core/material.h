@@ -3,6 +3,7 @@
 #include "QZRayTracer.h"
 #include "geometry.h"
 #include "shape.h"
+#include "sampler.h"
 namespace raytracer {
 	class Material {
 	public:
@@ -14,8 +15,9 @@ namespace raytracer {
 		/// <param name="rec">еļ¼</param>
 		/// <param name="attenuation">˥̶</param>
 		/// <param name="wo"></param>
+		/// <param name="sampler">ǰ·</param>
 		/// <returns></returns>
-		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo)const = 0;
+		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo, Sampler& sampler)const = 0;
 
 		
 	};
@@ -0,0 +1,94 @@
+#include "parallel.h"
+#include <algorithm>
+
+namespace raytracer {
+	// õ棬ÿ̸߳һݣȾʱʹ״̬ Sampler
+	thread_local std::default_random_engine seeds;
+	thread_local std::uniform_real_distribution<Float> randomNum(0, 1);
+
+	int NumSystemCores() {
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	TileScheduler::TileScheduler(int width, int height, int tileSize, int nThreads) : stolen(0) {
+		int nTilesX = (width + tileSize - 1) / tileSize;
+		int nTilesY = (height + tileSize - 1) / tileSize;
+		std::vector<std::pair<uint32_t, Tile>> ordered;
+		ordered.reserve(nTilesX * nTilesY);
+		for (int ty = 0; ty < nTilesY; ty++) {
+			for (int tx = 0; tx < nTilesX; tx++) {
+				Tile tile;
+				tile.x0 = tx * tileSize;
+				tile.y0 = ty * tileSize;
+				tile.x1 = std::min(tile.x0 + tileSize, width);
+				tile.y1 = std::min(tile.y0 + tileSize, height);
+				ordered.push_back(std::make_pair(EncodeMorton2(tx, ty), tile));
+			}
+		}
+		//  Morton ڵĿڴͳռҲ
+		std::stable_sort(ordered.begin(), ordered.end(),
+			[](const std::pair<uint32_t, Tile>& a, const std::pair<uint32_t, Tile>& b) { return a.first < b.first; });
+		tiles.reserve(ordered.size());
+		for (const auto& item : ordered) tiles.push_back(item.second);
+
+		// ÿ̷ֵ߳һĿ
+		nThreads = std::max(1, std::min(nThreads, NumTiles()));
+		for (int i = 0; i < nThreads; i++) {
+			queues.emplace_back(new WorkQueue());
+			int begin = int(int64_t(NumTiles()) * i / nThreads);
+			int end = int(int64_t(NumTiles()) * (i + 1) / nThreads);
+			for (int t = begin; t < end; t++) queues[i]->tiles.push_back(t);
+		}
+	}
+
+	bool TileScheduler::PopFront(int queueIndex, int& tileIndex) {
+		WorkQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tiles.empty()) return false;
+		tileIndex = queue.tiles.front();
+		queue.tiles.pop_front();
+		return true;
+	}
+
+	bool TileScheduler::PopBack(int queueIndex, int& tileIndex) {
+		WorkQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tiles.empty()) return false;
+		tileIndex = queue.tiles.back();
+		queue.tiles.pop_back();
+		return true;
+	}
+
+	bool TileScheduler::Next(int threadIndex, Tile& tile) {
+		int tileIndex;
+		if (PopFront(threadIndex, tileIndex)) {
+			tile = tiles[tileIndex];
+			return true;
+		}
+		// Լˣ̵߳β͵ȡβԷڴĿԶ
+		for (int i = 1; i < NumThreads(); i++) {
+			int victim = (threadIndex + i) % NumThreads();
+			if (PopBack(victim, tileIndex)) {
+				stolen++;
+				tile = tiles[tileIndex];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ParallelForTiles(TileScheduler& scheduler, const std::function<void(const Tile&, int)>& func) {
+		auto worker = [&](int threadIndex) {
+			Tile tile;
+			while (scheduler.Next(threadIndex, tile)) {
+				func(tile, threadIndex);
+			}
+		};
+		std::vector<std::thread> threads;
+		for (int i = 1; i < scheduler.NumThreads(); i++) {
+			threads.push_back(std::thread(worker, i));
+		}
+		worker(0);
+		for (auto& thread : threads) thread.join();
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef QZRT_CORE_PARALLEL_H
+#define QZRT_CORE_PARALLEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "QZRayTracer.h"
+
+namespace raytracer {
+	/// <summary>
+	/// ͼϵһ[x0, x1) x [y0, y1)
+	/// </summary>
+	struct Tile {
+		int x0, y0;
+		int x1, y1;
+	};
+
+	/// <summary>
+	///  16 λıؽ Morton 
+	/// </summary>
+	inline uint32_t EncodeMorton2(uint32_t x, uint32_t y) {
+		auto spread = [](uint32_t v) {
+			v &= 0x0000ffff;
+			v = (v | (v << 8)) & 0x00ff00ff;
+			v = (v | (v << 4)) & 0x0f0f0f0f;
+			v = (v | (v << 2)) & 0x33333333;
+			v = (v | (v << 1)) & 0x55555555;
+			return v;
+		};
+		return (spread(y) << 1) | spread(x);
+	}
+
+	/// <summary>
+	/// ϿõӲ߳
+	/// </summary>
+	int NumSystemCores();
+
+	/// <summary>
+	/// ֿͼг tileSize x tileSize С飬 Morton ˳к
+	/// طָỵ֤̈߳һ̴߳ĿڿռڣѺã
+	/// ߳ԼĶпԺ̶߳еβ͵ȡwork stealing
+	/// </summary>
+	class TileScheduler {
+	public:
+		TileScheduler(int width, int height, int tileSize, int nThreads);
+
+		/// <summary>
+		/// ȡһҪȾĿ
+		/// </summary>
+		/// <param name="threadIndex">ǰ̱߳</param>
+		/// <param name="tile">ȡĿ</param>
+		/// <returns>п鶼ʱ false</returns>
+		bool Next(int threadIndex, Tile& tile);
+
+		int NumTiles() const { return int(tiles.size()); }
+		int NumThreads() const { return int(queues.size()); }
+		// ͵ȡĿڹ۲츺Ƿ
+		int NumStolen() const { return stolen.load(); }
+
+	private:
+		struct WorkQueue {
+			std::mutex mutex;
+			std::deque<int> tiles;
+		};
+		bool PopFront(int queueIndex, int& tileIndex);
+		bool PopBack(int queueIndex, int& tileIndex);
+
+		std::vector<Tile> tiles; // Morton ˳
+		std::vector<std::unique_ptr<WorkQueue>> queues;
+		std::atomic<int> stolen;
+	};
+
+	/// <summary>
+	///  scheduler.NumThreads() ̴߳п飬func(tile, threadIndex)
+	/// ڹ߳бã߳ҲΪ 0 ̲߳Ⱦ
+	/// </summary>
+	void ParallelForTiles(TileScheduler& scheduler, const std::function<void(const Tile&, int)>& func);
+}
+
+#endif // QZRT_CORE_PARALLEL_H
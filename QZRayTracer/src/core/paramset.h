@@ -4,6 +4,7 @@
 #include "geometry.h"
 #include "shape.h"
 #include "camera.h"
+#include "sampler.h"
 namespace raytracer {
 	class ParamSet {
     public:
@@ -15,20 +16,71 @@ namespace raytracer {
 
     };
 
+    /// <summary>
+    /// Recursive ݹ׷· ColorIterative ѭ۳˥ֻó ColorIterative
+    /// Wavefront ǰһ·ֽ׶δ WavefrontIntegrator
+    /// </summary>
+    enum class IntegratorType { Recursive, Iterative, Wavefront };
+
+    /// <summary>
+    /// ·ʲôʱ൯ maxDepth Σ rrStartDepth ֮˹̶ģ
+    /// ˥˻ĸʣ [minSurvival, maxSurvival] ֮䣬
+    /// ·ʲԳ maxDepth Ľض֮ƫġ
+    /// ·ܿ챻·桢ߵ maxDepth
+    /// ̶ĬϹرգʾ·ƽֻΣ̶ʡµ󽻲ӵķ
+    /// աӹĳԴ maxDepth TERMINATION_BENCHMARK Ƚ
+    /// </summary>
+    struct PathTermination {
+        int maxDepth = 10;
+        bool russianRoulette = false;
+        int rrStartDepth = 5;
+        Float minSurvival = 0.05; // ޱ·Ȩع󣬳
+        Float maxSurvival = 0.95; // ˥ӽ 1 ·Ҳ
+
+        /// <summary>
+        /// · bounces Ρ˥˻Ϊ throughput ̶֮ġ
+        /// ʱؼĸʣ̶ʱΪ 1߰˥ʱ 0
+        /// </summary>
+        Float Survive(int bounces, const Point3f& throughput, Sampler& sampler) const {
+            if (!russianRoulette || bounces < rrStartDepth) return 1;
+            Float survival = std::min(std::max(std::max(throughput.x, std::max(throughput.y, throughput.z)), minSurvival), maxSurvival);
+            return sampler.Get1D() < survival ? survival : 0;
+        }
+    };
+
+    /// <summary>
+    /// ûκʱıݹ顢Ͳǰ
+    /// </summary>
+    inline Point3f Background(const Ray& ray) {
+        Vector3f dir = Normalize(ray.d);
+        Float t = 0.5 * (dir.y + 1.0);
+        return Lerp(t, Point3f(1.0, 1.0, 1.0), Point3f(0.8, 0.6, 0.6));
+    }
+
     struct RendererSet {
-        RendererSet(Camera cam, Float resWidth, Float resHeight, int spp, const char* savePath, std::shared_ptr<Shape> shapes) {
+        RendererSet(Camera cam, Float resWidth, Float resHeight, int spp, const char* savePath, std::shared_ptr<Shape> shapes,
+            int threads = 0, unsigned int seed = 2022) {
             camera = cam;
             width = resWidth;
             height = resHeight;
             this->spp = spp;
             this->savePath = savePath;
             this->shapes = shapes;
+            this->threads = threads;
+            this->seed = seed;
         }
         Camera camera;
         Float width, height;
         int spp;
         const char* savePath;
         std::shared_ptr<Shape> shapes;
+        int threads; // Ⱦ߳<= 0 ʱʹȫģ1 Ϊ߳
+        int tileSize = 16; // ֿȾʱı߳
+        unsigned int seed; // زӣ̶߳뵥̵߳Ľһ
+        bool taggedDispatch = false; //  TaggedScene ͷ󽻺ɢ䣬麯
+        bool packetTracing = true; // ߰ 4x2 ؿ 8 һ BVHIterative ҳ Accelerator ʱЧ
+        IntegratorType integrator = IntegratorType::Iterative; // Wavefront ʱ taggedDispatch  packetTracing
+        PathTermination termination;
     };
 
 }
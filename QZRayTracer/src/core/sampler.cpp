@@ -0,0 +1,4 @@
+#include "sampler.h"
+namespace raytracer {
+
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef QZRT_CORE_SAMPLER_H
+#define QZRT_CORE_SAMPLER_H
+
+#include <cstdint>
+#include "QZRayTracer.h"
+#include "geometry.h"
+
+namespace raytracer {
+	/// <summary>
+	/// PCG ϣJarzynski & Olano, "Hash Functions for GPU Rendering"
+	/// </summary>
+	inline uint32_t PCGHash(uint32_t v) {
+		uint32_t state = v * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	/// <summary>
+	/// ״̬ļÿ (, , , , ά)
+	/// ֱӹϣõκι״̬˶߳ȾʱҪ
+	/// ҽ߳Ĵ˳޹ء
+	/// </summary>
+	class Sampler {
+	public:
+		Sampler() : Sampler(0, 0, 0) {}
+		Sampler(uint32_t seed, uint32_t pixelIndex, uint32_t sampleIndex)
+			: seed(seed), pixelIndex(pixelIndex), sampleIndex(sampleIndex) {
+			SetBounce(0);
+		}
+
+		/// <summary>
+		/// л bounce ε䣬άȼ 0 ʼ
+		/// </summary>
+		void SetBounce(uint32_t bounce) {
+			this->bounce = bounce;
+			dimension = 0;
+			key = PCGHash(seed ^ PCGHash(pixelIndex ^ PCGHash(sampleIndex ^ PCGHash(bounce))));
+		}
+
+		/// <summary>
+		/// [0, 1) ľ
+		/// </summary>
+		Float Get1D() {
+			uint32_t bits = PCGHash(key ^ PCGHash(dimension++));
+			return Float(bits >> 8) * Float(1.0 / 16777216.0);
+		}
+
+		uint32_t Bounce() const { return bounce; }
+
+	private:
+		uint32_t seed, pixelIndex, sampleIndex;
+		uint32_t bounce;
+		uint32_t dimension;
+		uint32_t key; // (seed, pixel, sample, bounce) Ĺϣάٹϣһμ
+	};
+
+	/// <summary>
+	/// һλڲһ
+	/// </summary>
+	/// <returns></returns>
+	inline Point3<Float> RandomInUnitSphere(Sampler& sampler) {
+		Vector3f p;
+		do {
+			p = 2.0 * Vector3f(sampler.Get1D(), sampler.Get1D(), sampler.Get1D()) - Vector3f(1, 1, 1);
+		} while (Dot(p, p) >= 1.0);
+
+
+		return Point3<Float>(p);
+	}
+
+	/// <summary>
+	/// һλԲڲһ
+	/// </summary>
+	/// <returns></returns>
+	inline Point3<Float> RandomInUnitDisk(Sampler& sampler) {
+		Vector3f p;
+		do {
+			p = 2.0 * Vector3f(sampler.Get1D(), sampler.Get1D(), 0) - Vector3f(1, 1, 0);
+		} while (Dot(p, p) >= 1.0);
+
+
+		return Point3<Float>(p);
+	}
+}
+
+#endif // QZRT_CORE_SAMPLER_H
@@ -11,12 +11,50 @@ namespace raytracer {
 		Float t; // time
 		Point3f p; // е
 		Normal3f normal; // 
-		std::shared_ptr<Material> mat; // 
+		const Material* mat; // ʣֻòУ״ shared_ptr<Material> УʱҪü
+	};
+
+	class Shape;
+	/// <summary>
+	/// ׶󽻵һ׶εĽĹ߲ͻеͼԪ
+	/// ֻĽ shape->ComputeSurfaceInteraction д HitRecord
+	/// </summary>
+	struct PrimitiveHit {
+		Float t;
+		const Shape* shape = nullptr;
 	};
 
 	class Shape {
 	public:
 		virtual bool Hit(const Ray& ray, HitRecord& rec)const = 0;
+		/// <summary>
+		/// һ׶Σֻ (ShadowEpsilon, ray.tMax) ֮ľͼԪ㽻㡢ߺͲʡ
+		/// ֻڻʱд hitۺ tMax ҸġĬ˻ HitͼԪԼ
+		/// </summary>
+		virtual bool Intersect(const Ray& ray, PrimitiveHit& hit)const {
+			HitRecord rec;
+			if (!Hit(ray, rec) || rec.t >= ray.tMax) return false;
+			hit.t = rec.t;
+			hit.shape = this;
+			return true;
+		}
+		/// <summary>
+		/// ڶ׶ΣΪ Intersect ҵĽд HitRecordÿֻͼԪһΡ
+		/// Ĭµ Hitõľǵһ׶εǸ
+		/// </summary>
+		virtual void ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& /*hit*/, HitRecord& rec)const {
+			Hit(ray, rec);
+		}
+		/// <summary>
+		/// ڵѯ(ShadowEpsilon, ray.tMax) ֮ûн㣬ҵһͷأ㽻㡢ߺͲʡ
+		/// ӰߡڱֻҪĬ˻ Hit״дֻİ汾
+		/// </summary>
+		virtual bool IntersectP(const Ray& ray)const {
+			HitRecord rec;
+			return Hit(ray, rec) && rec.t < ray.tMax;
+		}
+		// ռµİΧУBVH ʱʹ
+		virtual bool BoundingBox(Bounds3f& box)const = 0;
 	};
 
 }
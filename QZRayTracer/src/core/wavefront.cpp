@@ -0,0 +1,221 @@
+#include "wavefront.h"
+#include "material.h"
+#include <algorithm>
+#include <chrono>
+
+namespace raytracer {
+	/// <summary>
+	///  10 λıؽ 30 λ Morton 
+	/// </summary>
+	static inline uint32_t EncodeMorton3(uint32_t x, uint32_t y, uint32_t z) {
+		auto spread = [](uint32_t v) {
+			v &= 0x000003ff;
+			v = (v | (v << 16)) & 0x030000ff;
+			v = (v | (v << 8)) & 0x0300f00f;
+			v = (v | (v << 4)) & 0x030c30c3;
+			v = (v | (v << 2)) & 0x09249249;
+			return v;
+		};
+		return (spread(z) << 2) | (spread(y) << 1) | spread(x);
+	}
+
+	WavefrontStats& WavefrontStats::operator+=(const WavefrontStats& s) {
+		generateTime += s.generateTime;
+		intersectTime += s.intersectTime;
+		sortTime += s.sortTime;
+		shadeTime += s.shadeTime;
+		paths += s.paths;
+		rays += s.rays;
+		waves += s.waves;
+		return *this;
+	}
+
+	void WavefrontStats::Report() const {
+		if (waves == 0) return;
+		std::cout << "Wavefront: " << paths << " paths, " << rays << " rays in " << waves << " waves ("
+			<< Float(rays) / waves << " rays per wave, " << Float(rays) / paths << " rays per path)" << std::endl;
+		std::cout << "Wavefront: generate " << generateTime << "s, intersect " << intersectTime << "s, sort "
+			<< sortTime << "s, shade " << shadeTime << "s" << std::endl;
+	}
+
+	WavefrontIntegrator::WavefrontIntegrator(const RendererSet& set, int poolSize)
+		: set(set), world(set.shapes.get()), accel(dynamic_cast<const Accelerator*>(set.shapes.get())),
+		termination(set.termination), poolSize(std::max(RayPacket8::Size, poolSize)), nextSample(0), numSamples(0) {
+		rays.resize(this->poolSize);
+		throughput.resize(this->poolSize);
+		samplers.resize(this->poolSize);
+		pixels.resize(this->poolSize);
+		depths.resize(this->poolSize);
+		records.resize(this->poolSize);
+		sortKeys.resize(this->poolSize);
+		freeSlots.reserve(this->poolSize);
+		rayQueue.reserve(this->poolSize);
+		hitQueue.reserve(this->poolSize);
+		nextQueue.reserve(this->poolSize);
+		sortBuffer.reserve(this->poolSize);
+	}
+
+	void WavefrontIntegrator::Render(const Tile& tile, std::vector<Point3f>& colors) {
+		int nPixels = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+		colors.assign(nPixels, Point3f());
+		nextSample = 0;
+		numSamples = nPixels * set.spp;
+		freeSlots.clear();
+		for (int slot = poolSize - 1; slot >= 0; slot--) freeSlots.push_back(slot);
+		rayQueue.clear();
+
+		while (true) {
+			Generate(tile);
+			if (rayQueue.empty()) break;
+			stats.waves++;
+			Intersect(colors);
+			if (sortMaterials) SortByMaterial();
+			Shade();
+			if (sortRays) SortRays();
+			rayQueue.swap(nextQueue);
+		}
+
+		Float invSpp = 1.0 / Float(set.spp);
+		for (Point3f& color : colors) color *= invSpp;
+	}
+
+	void WavefrontIntegrator::Generate(const Tile& tile) {
+		auto start = std::chrono::steady_clock::now();
+		//  (, ) Уͬһɵڵأźӹߺ
+		int tileWidth = tile.x1 - tile.x0;
+		int nPixels = tileWidth * (tile.y1 - tile.y0);
+		int width = set.width, height = set.height;
+		while (!freeSlots.empty() && nextSample < numSamples) {
+			int slot = freeSlots.back();
+			freeSlots.pop_back();
+			int pixel = nextSample % nPixels, s = nextSample / nPixels;
+			nextSample++;
+			int sx = tile.x0 + pixel % tileWidth, sy = tile.y0 + pixel / tileWidth;
+			Sampler& sampler = samplers[slot];
+			sampler = Sampler(set.seed, sy * width + sx, s);
+			Float u = Float(sx + sampler.Get1D()) / Float(width);
+			Float v = Float(height - sy - 1 + sampler.Get1D()) / Float(height);
+			rays[slot] = set.camera.GenerateRay(u, v, sampler);
+			throughput[slot] = Point3f(1, 1, 1);
+			pixels[slot] = pixel;
+			depths[slot] = 0;
+			rayQueue.push_back(slot);
+			stats.paths++;
+		}
+		stats.generateTime += std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void WavefrontIntegrator::Intersect(std::vector<Point3f>& colors) {
+		auto start = std::chrono::steady_clock::now();
+		hitQueue.clear();
+		// ûе·ϱ黹λ
+		auto miss = [&](int slot) {
+			Point3f background = Background(rays[slot]);
+			colors[pixels[slot]] += throughput[slot] * background;
+			freeSlots.push_back(slot);
+		};
+		for (size_t i = 0; i < rayQueue.size(); i += RayPacket8::Size) {
+			int n = std::min(RayPacket8::Size, int(rayQueue.size() - i));
+			if (accel) {
+				RayPacket8 packet;
+				for (int lane = 0; lane < n; lane++) packet.Set(lane, rays[rayQueue[i + lane]]);
+				HitPacket8 hits;
+				accel->IntersectPacket(packet, hits);
+				for (int lane = 0; lane < n; lane++) {
+					int slot = rayQueue[i + lane];
+					if (hits.hitMask & (1 << lane)) {
+						hits.hits[lane].shape->ComputeSurfaceInteraction(rays[slot], hits.hits[lane], records[slot]);
+						hitQueue.push_back(slot);
+					}
+					else {
+						miss(slot);
+					}
+				}
+			}
+			else {
+				for (int lane = 0; lane < n; lane++) {
+					int slot = rayQueue[i + lane];
+					if (world->Hit(rays[slot], records[slot])) hitQueue.push_back(slot);
+					else miss(slot);
+				}
+			}
+		}
+		stats.rays += rayQueue.size();
+		stats.intersectTime += std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void WavefrontIntegrator::RadixSort(std::vector<int>& queue, int keyBits) {
+		const int radixBits = 12, numBuckets = 1 << radixBits;
+		sortBuffer.resize(queue.size());
+		for (int shift = 0; shift < keyBits; shift += radixBits) {
+			int offsets[numBuckets + 1] = {};
+			for (int slot : queue) offsets[((sortKeys[slot] >> shift) & (numBuckets - 1)) + 1]++;
+			for (int i = 0; i < numBuckets; i++) offsets[i + 1] += offsets[i];
+			for (int slot : queue) sortBuffer[offsets[(sortKeys[slot] >> shift) & (numBuckets - 1)]++] = slot;
+			queue.swap(sortBuffer);
+		}
+	}
+
+	void WavefrontIntegrator::SortByMaterial() {
+		auto start = std::chrono::steady_clock::now();
+		// ʵͷ飬ͬһ Scatter ʵãͱŰһ˳䣬һ˻͹
+		for (int slot : hitQueue) {
+			const std::type_info* type = &typeid(*records[slot].mat);
+			size_t id = 0;
+			while (id < materialTypes.size() && materialTypes[id] != type) id++;
+			if (id == materialTypes.size()) materialTypes.push_back(type);
+			sortKeys[slot] = id;
+		}
+		int keyBits = 1;
+		while ((size_t(1) << keyBits) < materialTypes.size()) keyBits++;
+		RadixSort(hitQueue, keyBits);
+		stats.sortTime += std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void WavefrontIntegrator::Shade() {
+		auto start = std::chrono::steady_clock::now();
+		nextQueue.clear();
+		for (int slot : hitQueue) {
+			Ray wo;
+			Point3f attenuation;
+			Sampler& sampler = samplers[slot];
+			sampler.SetBounce(depths[slot] + 1);
+			if (depths[slot] < termination.maxDepth && records[slot].mat->Scatter(rays[slot], records[slot], attenuation, wo, sampler)) {
+				throughput[slot] = throughput[slot] * attenuation;
+				Float survival = termination.Survive(depths[slot] + 1, throughput[slot], sampler);
+				if (survival > 0) {
+					throughput[slot] /= survival;
+					rays[slot] = wo;
+					depths[slot]++;
+					nextQueue.push_back(slot);
+					continue;
+				}
+			}
+			// ա̶߱ĽΪ 0
+			freeSlots.push_back(slot);
+		}
+		stats.shadeTime += std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void WavefrontIntegrator::SortRays() {
+		if (nextQueue.size() <= RayPacket8::Size) return;
+		auto start = std::chrono::steady_clock::now();
+		// ޷λͬһĹ߷ͬBVHAccel ܰ
+		// ٰͬһΧ Morton Уÿ 7 λһ 24 λ˻
+		Bounds3f bounds;
+		for (int slot : nextQueue) bounds = Union(bounds, rays[slot].o);
+		Vector3f extent = bounds.pMax - bounds.pMin;
+		for (int slot : nextQueue) {
+			const Ray& r = rays[slot];
+			uint32_t octant = (1 / r.d.x < 0) | ((1 / r.d.y < 0) << 1) | ((1 / r.d.z < 0) << 2);
+			uint32_t q[3];
+			for (int axis = 0; axis < 3; axis++) {
+				Float offset = extent[axis] > 0 ? (r.o[axis] - bounds.pMin[axis]) / extent[axis] : 0;
+				q[axis] = uint32_t(std::min(std::max(offset * 128, Float(0)), Float(127)));
+			}
+			sortKeys[slot] = (uint64_t(octant) << 21) | EncodeMorton3(q[0], q[1], q[2]);
+		}
+		RadixSort(nextQueue, 24);
+		stats.sortTime += std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef QZRT_CORE_WAVEFRONT_H
+#define QZRT_CORE_WAVEFRONT_H
+#include <cstdint>
+#include <typeinfo>
+#include <vector>
+#include "QZRayTracer.h"
+#include "geometry.h"
+#include "shape.h"
+#include "sampler.h"
+#include "paramset.h"
+#include "parallel.h"
+#include "../shape/bvh.h"
+
+namespace raytracer {
+	/// <summary>
+	/// ǰ׶εʱÿ߳һݣȾۼ
+	/// </summary>
+	struct WavefrontStats {
+		Float generateTime = 0, intersectTime = 0, sortTime = 0, shadeTime = 0;
+		uint64_t paths = 0, rays = 0, waves = 0;
+
+		WavefrontStats& operator+=(const WavefrontStats& s);
+		void Report() const;
+	};
+
+	/// <summary>
+	/// ǰʽ·׷١Color һΰһ·ݹ׷ٵף󽻡Scatter Ͳͬʵ麯ýһ
+	/// һŽ̶С·أÿһֶԳлŵ·ִһ׶Σ
+	/// ɣѿղλµߣ 󽻣8 һ   ɫӹ  ӹߡ
+	/// ·״ֶ̬ηֿţSoA׶֮Ķֻλ±꣬·Ѳλȥһʱϡ
+	/// ÿ· Color һֻ (, , , ) ߵ·ȫͬ
+	/// ֻ˥˺صۼ˳ͬ͵ݹĽֻ롣
+	/// ûйԴֻӹߣûӰ
+	/// </summary>
+	class WavefrontIntegrator {
+	public:
+		WavefrontIntegrator(const RendererSet& set, int poolSize = 1 << 15);
+
+		/// <summary>
+		/// Ⱦһ飬colors ȴÿصƽɫû gamma 
+		/// </summary>
+		void Render(const Tile& tile, std::vector<Point3f>& colors);
+
+		const WavefrontStats& Stats() const { return stats; }
+
+		bool sortMaterials = true; // ɫǰͬһ Scatter 
+		bool sortRays = true;      // ǰ޺ Morton ӹߣڵĹߴһ
+
+	private:
+		void Generate(const Tile& tile);
+		void Intersect(std::vector<Point3f>& colors);
+		void SortByMaterial();
+		void Shade();
+		void SortRays();
+		//  sortKeys ĵ keyBits λԶĲλȶ LSD 
+		void RadixSort(std::vector<int>& queue, int keyBits);
+
+		const RendererSet& set;
+		const Shape* world;
+		const Accelerator* accel; //  Accelerator ʱ߰󽻣 Hit
+		PathTermination termination; // ·Ⱥ̶ãȡ set
+		int poolSize;
+
+		// ·أÿֶһ飬±ǲλ
+		std::vector<Ray> rays;
+		std::vector<Point3f> throughput; // ǰΪֹ˥ĳ˻
+		std::vector<Sampler> samplers;
+		std::vector<int> pixels;         // ±
+		std::vector<int> depths;
+		std::vector<HitRecord> records;
+		std::vector<uint64_t> sortKeys;
+		std::vector<const std::type_info*> materialTypes; // Ĳͣ±õͱ
+		// ׶֮䴫ݵĲλ
+		std::vector<int> freeSlots, rayQueue, hitQueue, nextQueue, sortBuffer;
+		int nextSample, numSamples; // Ѿɵ
+		WavefrontStats stats;
+	};
+}
+
+#endif // QZRT_CORE_WAVEFRONT_H
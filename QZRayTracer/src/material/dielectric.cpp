@@ -1,44 +1,6 @@
 #include "dielectric.h"
 namespace raytracer {
-    bool raytracer::Dielectric::Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo) const {
-        Vector3f outwardNormal;
-        Vector3f originNormal = Vector3f(rec.normal);
-        Vector3f reflected = Reflect(wi.d, originNormal);
-        Float niOverNo;
-        attenuation = Point3f(1.0, 1.0, 1.0);
-        Vector3f refracted;
-
-        Float reflectProb;
-        Float cosine;
-
-
-        // ҪжϹߴлǴӽ䵽ȥ֤ʹõǳķߣͬʱ
-        if (Dot(wi.d, rec.normal) > 0) {
-            outwardNormal = -originNormal;
-            niOverNo = refractionIndex;
-            cosine = refractionIndex * Dot(wi.d, originNormal) / wi.d.Length();
-        }
-        else {
-            outwardNormal = originNormal;
-            niOverNo = invRefractionIndex;
-            cosine = -Dot(wi.d, originNormal) / wi.d.Length();
-        }
-
-        // Ƕ̫Сᵼɾ淴
-        if (Refract(wi.d, outwardNormal, niOverNo, refracted)) {
-            wo = Ray(rec.p, refracted);
-            reflectProb = Schlick(cosine, refractionIndex);
-        }
-        else {
-            wo = Ray(rec.p, reflected);
-            reflectProb = 1.0;
-        }
-        if (randomNum(seeds) < reflectProb) {
-            wo = Ray(rec.p, reflected);
-        }
-        else {
-            wo = Ray(rec.p, refracted);
-        }
-        return true;
+    bool raytracer::Dielectric::Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo, Sampler& sampler) const {
+        return ScatterDielectric(refractionIndex, invRefractionIndex, wi, rec.p, rec.normal, attenuation, wo, sampler);
     }
 }
\ No newline at end of file
@@ -14,8 +14,54 @@ namespace raytracer {
 		Dielectric(Float refIdx) :refractionIndex(refIdx) { invRefractionIndex = 1.0 / refractionIndex; };
 
 		// ͨ Material ̳
-		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo) const override;
+		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo, Sampler& sampler) const override;
 	};
+
+	/// <summary>
+	/// ɢ䣬Dielectric  TaggedScene ã麯
+	/// </summary>
+	inline bool ScatterDielectric(Float refractionIndex, Float invRefractionIndex, const Ray& wi, const Point3f& p, const Normal3f& normal,
+		Point3f& attenuation, Ray& wo, Sampler& sampler) {
+		Vector3f outwardNormal;
+		Vector3f originNormal = Vector3f(normal);
+		Vector3f reflected = Reflect(wi.d, originNormal);
+		Float niOverNo;
+		attenuation = Point3f(1.0, 1.0, 1.0);
+		Vector3f refracted;
+
+		Float reflectProb;
+		Float cosine;
+
+
+		// ҪжϹߴлǴӽ䵽ȥ֤ʹõǳķߣͬʱ
+		if (Dot(wi.d, normal) > 0) {
+			outwardNormal = -originNormal;
+			niOverNo = refractionIndex;
+			cosine = refractionIndex * Dot(wi.d, originNormal) / wi.d.Length();
+		}
+		else {
+			outwardNormal = originNormal;
+			niOverNo = invRefractionIndex;
+			cosine = -Dot(wi.d, originNormal) / wi.d.Length();
+		}
+
+		// Ƕ̫Сᵼɾ淴
+		if (Refract(wi.d, outwardNormal, niOverNo, refracted)) {
+			wo = Ray(p, refracted);
+			reflectProb = Schlick(cosine, refractionIndex);
+		}
+		else {
+			wo = Ray(p, reflected);
+			reflectProb = 1.0;
+		}
+		if (sampler.Get1D() < reflectProb) {
+			wo = Ray(p, reflected);
+		}
+		else {
+			wo = Ray(p, refracted);
+		}
+		return true;
+	}
 }
 
 
@@ -13,9 +13,19 @@ namespace raytracer {
 
 
 		// ͨ Material ̳
-		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo) const override;
+		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo, Sampler& sampler) const override;
 
 	};
+
+	/// <summary>
+	/// ɢ䣬Lambertian  TaggedScene ã麯
+	/// </summary>
+	inline bool ScatterLambertian(const Point3f& albedo, const Point3f& p, const Normal3f& normal, Point3f& attenuation, Ray& wo, Sampler& sampler) {
+		Point3f target = p + Point3f(normal) + RandomInUnitSphere(sampler);
+		wo = Ray(p, target - p);
+		attenuation = albedo;
+		return true;
+	}
 }
 
 #endif // QZRT_CORE_LAMBERTIAN_H
\ No newline at end of file
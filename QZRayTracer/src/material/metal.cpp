@@ -1,9 +1,6 @@
 #include "metal.h"
 namespace raytracer {
-    bool raytracer::Metal::Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo) const {
-        Vector3f reflected = Reflect(Normalize(wi.d), Vector3f(rec.normal));
-        wo = Ray(rec.p, reflected + Vector3f(fuzz * RandomInUnitSphere()));
-        attenuation = albedo;
-        return Dot(reflected, rec.normal) > 0; // ䷽뷨߱ͬһ
+    bool raytracer::Metal::Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo, Sampler& sampler) const {
+        return ScatterMetal(albedo, fuzz, wi, rec.p, rec.normal, attenuation, wo, sampler);
     }
 }
\ No newline at end of file
@@ -10,9 +10,19 @@ namespace raytracer {
 
 		Metal(const Point3f& color, Float f = 0.0) :albedo(color), fuzz(f) {}
 		// ͨ Material ̳
-		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo) const override;
+		virtual bool Scatter(const Ray& wi, const HitRecord& rec, Point3f& attenuation, Ray& wo, Sampler& sampler) const override;
 		
 	};
+
+	/// <summary>
+	/// ɢ䣬Metal  TaggedScene ã麯
+	/// </summary>
+	inline bool ScatterMetal(const Point3f& albedo, Float fuzz, const Ray& wi, const Point3f& p, const Normal3f& normal, Point3f& attenuation, Ray& wo, Sampler& sampler) {
+		Vector3f reflected = Reflect(Normalize(wi.d), Vector3f(normal));
+		wo = Ray(p, reflected + Vector3f(fuzz * RandomInUnitSphere(sampler)));
+		attenuation = albedo;
+		return Dot(reflected, normal) > 0; // ䷽뷨߱ͬһ
+	}
 }
 
 #endif // QZRT_CORE_METAL_H
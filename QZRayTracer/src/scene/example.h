@@ -73,7 +73,7 @@ namespace raytracer {
 		shapes.push_back(CreateSphereShape(Point3f(0, 1, 0), 1.0, std::make_shared<Dielectric>(1.5)));
 		shapes.push_back(CreateSphereShape(Point3f(-4, 1, 0), 1.0, std::make_shared<Lambertian>(Point3f(0.4, 0.2, 0.1))));
 		shapes.push_back(CreateSphereShape(Point3f(4, 1, 0), 1.0, std::make_shared<Metal>(Point3f(0.7, 0.6, 0.5), 0.0)));
-		std::shared_ptr<Shape> shapeList = std::make_shared<ShapeList>(shapes);
+		std::shared_ptr<Shape> shapeList = CreateBVHAccel(shapes);
 		
 		return RendererSet(cam, screenWidth, screenHeight, spp, savePath, shapeList);
 	}
@@ -212,7 +212,7 @@ namespace raytracer {
 
 		}
 
-		std::shared_ptr<Shape> shapeList = std::make_shared<ShapeList>(shapes);
+		std::shared_ptr<Shape> shapeList = CreateBVHAccel(shapes);
 
 		return RendererSet(cam, screenWidth, screenHeight, spp, savePath, shapeList);
 	}
@@ -0,0 +1,480 @@
+#include "bvh.h"
+#include "wide_bvh.h"
+#include <algorithm>
+#include <chrono>
+
+namespace raytracer {
+	struct BVHPrimitiveInfo {
+		BVHPrimitiveInfo() {}
+		BVHPrimitiveInfo(int primitiveNumber, const Bounds3f& bounds)
+			: primitiveNumber(primitiveNumber), bounds(bounds), centroid(.5f * bounds.pMin + .5f * bounds.pMax) {}
+		int primitiveNumber;
+		Bounds3f bounds;
+		Point3f centroid;
+	};
+
+	struct BVHBuildNode {
+		void InitLeaf(int first, int n, const Bounds3f& b) {
+			firstPrimOffset = first;
+			nPrimitives = n;
+			bounds = b;
+			children[0] = children[1] = nullptr;
+		}
+		void InitInterior(int axis, BVHBuildNode* c0, BVHBuildNode* c1) {
+			children[0] = c0;
+			children[1] = c1;
+			bounds = Union(c0->bounds, c1->bounds);
+			splitAxis = axis;
+			nPrimitives = 0;
+		}
+		Bounds3f bounds;
+		BVHBuildNode* children[2];
+		int splitAxis, firstPrimOffset, nPrimitives;
+	};
+
+	BVHAccel::BVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode)
+		: maxPrimsInNode(std::min(255, std::max(1, maxPrimsInNode))), leafNodes(0), maxDepth(0), sahCost(0), buildTime(0) {
+#ifdef BVH_STATS
+		rayCount = 0;
+		nodeVisits = 0;
+		primitiveTests = 0;
+		packetCount = 0;
+		packetNodeVisits = 0;
+		packetActiveLanes = 0;
+		incoherentPackets = 0;
+#endif // BVH_STATS
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<BVHPrimitiveInfo> primitiveInfo;
+		std::vector<int> inputIndices;
+		for (size_t i = 0; i < shapes.size(); i++) {
+			Bounds3f bounds;
+			if (shapes[i]->BoundingBox(bounds)) {
+				primitiveInfo.push_back(BVHPrimitiveInfo(int(primitives.size()), bounds));
+				primitives.push_back(shapes[i]);
+				inputIndices.push_back(int(i));
+			}
+			else {
+				unbounded.push_back(shapes[i]);
+				unboundedIndices.push_back(int(i));
+			}
+		}
+		if (primitives.empty()) return;
+
+		// ڵ 2n - 1Ԥÿռ䱣֤ڵָ벻ʧЧ
+		std::vector<BVHBuildNode> buildNodes;
+		buildNodes.reserve(2 * primitives.size());
+		std::vector<std::shared_ptr<Shape>> orderedPrims;
+		orderedPrims.reserve(primitives.size());
+		BVHBuildNode* root = RecursiveBuild(primitiveInfo, 0, int(primitives.size()), 1, buildNodes, orderedPrims);
+		primitives.swap(orderedPrims);
+		for (int& index : primitiveIndices) index = inputIndices[index];
+
+		nodes.resize(buildNodes.size());
+		int offset = 0;
+		FlattenBVHTree(root, &offset);
+
+		//  SAH ۣڲڵıȡ 1/8
+		Float rootArea = root->bounds.SurfaceArea();
+		for (const auto& node : buildNodes) {
+			Float area = rootArea > 0 ? node.bounds.SurfaceArea() / rootArea : 1;
+			sahCost += area * (node.nPrimitives > 0 ? node.nPrimitives : .125f);
+			if (node.nPrimitives > 0) leafNodes++;
+		}
+
+		buildTime = std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/// <summary>
+	/// С log2(n) Сn ͼԪλʱ
+	/// </summary>
+	static inline int Log2Ceil(int n) {
+		int log2 = 0;
+		while ((1 << log2) < n) log2++;
+		return log2;
+	}
+
+	BVHBuildNode* BVHAccel::RecursiveBuild(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end, int depth,
+		std::vector<BVHBuildNode>& buildNodes, std::vector<std::shared_ptr<Shape>>& orderedPrims) {
+		buildNodes.push_back(BVHBuildNode());
+		BVHBuildNode* node = &buildNodes.back();
+		maxDepth = std::max(maxDepth, depth);
+
+		Bounds3f bounds;
+		for (int i = start; i < end; i++) bounds = Union(bounds, primitiveInfo[i].bounds);
+
+		auto createLeaf = [&]() {
+			int firstPrimOffset = int(orderedPrims.size());
+			for (int i = start; i < end; i++) {
+				orderedPrims.push_back(primitives[primitiveInfo[i].primitiveNumber]);
+				primitiveIndices.push_back(primitiveInfo[i].primitiveNumber);
+			}
+			node->InitLeaf(firstPrimOffset, end - start, bounds);
+			return node;
+		};
+
+		int nPrimitives = end - start;
+		if (nPrimitives == 1) return createLeaf();
+
+		// ͼԪĵİΧѡᣬȫغʱûٷ
+		Bounds3f centroidBounds;
+		for (int i = start; i < end; i++) centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
+		int dim = centroidBounds.MaximumExtent();
+		if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) return createLeaf();
+
+		int mid = (start + end) / 2;
+		if (nPrimitives <= 2) {
+			std::nth_element(&primitiveInfo[start], &primitiveInfo[mid], &primitiveInfo[end - 1] + 1,
+				[dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) { return a.centroid[dim] < b.centroid[dim]; });
+		}
+		else {
+			// ͶӰ nBuckets ͰֻͰı߽ SAH
+			const int nBuckets = 12;
+			struct BucketInfo {
+				int count = 0;
+				Bounds3f bounds;
+			};
+			BucketInfo buckets[nBuckets];
+			auto bucketIndex = [&](const BVHPrimitiveInfo& pi) {
+				int b = int(nBuckets * centroidBounds.Offset(pi.centroid)[dim]);
+				return std::min(b, nBuckets - 1);
+			};
+			for (int i = start; i < end; i++) {
+				int b = bucketIndex(primitiveInfo[i]);
+				buckets[b].count++;
+				buckets[b].bounds = Union(buckets[b].bounds, primitiveInfo[i].bounds);
+			}
+
+			// ҡɨһ飬õÿλ
+			Float cost[nBuckets - 1];
+			Bounds3f b0, b1;
+			int count0 = 0, count1 = 0;
+			Float leftArea[nBuckets - 1];
+			int leftCount[nBuckets - 1];
+			for (int i = 0; i < nBuckets - 1; i++) {
+				b0 = Union(b0, buckets[i].bounds);
+				count0 += buckets[i].count;
+				leftArea[i] = count0 > 0 ? b0.SurfaceArea() : 0;
+				leftCount[i] = count0;
+			}
+			for (int i = nBuckets - 1; i > 0; i--) {
+				b1 = Union(b1, buckets[i].bounds);
+				count1 += buckets[i].count;
+				Float rightArea = count1 > 0 ? b1.SurfaceArea() : 0;
+				cost[i - 1] = .125f + (leftCount[i - 1] * leftArea[i - 1] + count1 * rightArea) / bounds.SurfaceArea();
+			}
+
+			Float minCost = cost[0];
+			int minCostSplitBucket = 0;
+			for (int i = 1; i < nBuckets - 1; i++) {
+				if (cost[i] < minCost) {
+					minCost = cost[i];
+					minCostSplitBucket = i;
+				}
+			}
+
+			// ֱֲҶӻ㣬ͼԪʱҶ
+			Float leafCost = Float(nPrimitives);
+			if (nPrimitives <= maxPrimsInNode && leafCost <= minCost) return createLeaf();
+			BVHPrimitiveInfo* pmid = std::partition(&primitiveInfo[start], &primitiveInfo[end - 1] + 1,
+				[&](const BVHPrimitiveInfo& pi) { return bucketIndex(pi) <= minCostSplitBucket; });
+			mid = int(pmid - &primitiveInfo[0]);
+			// SAH һֳֻٵͼԪʱӰλҲŲջʱλ֣
+			// ÿͼԪ룬ȾͲᳬ MAXBVHDEPTH
+			bool tooDeep = depth + 1 + Log2Ceil(std::max(mid - start, end - mid)) > MAXBVHDEPTH;
+			if (mid == start || mid == end || tooDeep) {
+				mid = (start + end) / 2;
+				std::nth_element(&primitiveInfo[start], &primitiveInfo[mid], &primitiveInfo[end - 1] + 1,
+					[dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) { return a.centroid[dim] < b.centroid[dim]; });
+			}
+		}
+
+		BVHBuildNode* left = RecursiveBuild(primitiveInfo, start, mid, depth + 1, buildNodes, orderedPrims);
+		BVHBuildNode* right = RecursiveBuild(primitiveInfo, mid, end, depth + 1, buildNodes, orderedPrims);
+		node->InitInterior(dim, left, right);
+		return node;
+	}
+
+	int BVHAccel::FlattenBVHTree(BVHBuildNode* node, int* offset) {
+		LinearBVHNode* linearNode = &nodes[*offset];
+		linearNode->bounds = node->bounds;
+		int myOffset = (*offset)++;
+		if (node->nPrimitives > 0) {
+			linearNode->primitivesOffset = node->firstPrimOffset;
+			linearNode->nPrimitives = uint16_t(node->nPrimitives);
+		}
+		else {
+			linearNode->axis = uint8_t(node->splitAxis);
+			linearNode->nPrimitives = 0;
+			FlattenBVHTree(node->children[0], offset);
+			linearNode->secondChildOffset = FlattenBVHTree(node->children[1], offset);
+		}
+		return myOffset;
+	}
+
+	bool BVHAccel::Hit(const Ray& ray, HitRecord& rec) const {
+		PrimitiveHit hit;
+		if (!Intersect(ray, hit)) return false;
+		hit.shape->ComputeSurfaceInteraction(ray, hit, rec);
+		return true;
+	}
+
+	bool BVHAccel::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		// һݹߣҵĽʱ tMaxӰߵĹ
+		Ray r = ray;
+		uint64_t visits = 0, tests = 0;
+		int hitIndex = -1;
+		bool hitAnything = !nodes.empty() && IntersectSubtree(0, r, hit, hitIndex, visits, tests);
+		for (size_t i = 0; i < unbounded.size(); i++) {
+			tests++;
+			if (IntersectPrimitive(*unbounded[i], unboundedIndices[i], r, hit, hitIndex)) hitAnything = true;
+		}
+#ifdef BVH_STATS
+		// ÿֻۼһΣԭӲ
+		rayCount.fetch_add(1, std::memory_order_relaxed);
+		nodeVisits.fetch_add(visits, std::memory_order_relaxed);
+		primitiveTests.fetch_add(tests, std::memory_order_relaxed);
+#endif // BVH_STATS
+		return hitAnything;
+	}
+
+	/// <summary>
+	/// ҵ tMax ȡ hit.t һͬͼԪͱ߽ǡ hit.t ϵĽڵԻᱻԣ
+	/// ʱ￿ǰͼԪ ShapeList ˳ҵĽһ£ŵԲĶ棩
+	/// </summary>
+	inline bool BVHAccel::IntersectPrimitive(const Shape& shape, int index, Ray& r, PrimitiveHit& hit, int& hitIndex) const {
+		PrimitiveHit candidate;
+		if (!shape.Intersect(r, candidate)) return false;
+		if (hitIndex >= 0 && candidate.t == hit.t && index > hitIndex) return false;
+		hit = candidate;
+		hitIndex = index;
+		r.tMax = std::nextafter(hit.t, Infinity);
+		return true;
+	}
+
+	bool BVHAccel::IntersectSubtree(int root, Ray& r, PrimitiveHit& hit, int& hitIndex, uint64_t& visits, uint64_t& tests) const {
+		bool hitAnything = false;
+		Vector3f invDir(1 / r.d.x, 1 / r.d.y, 1 / r.d.z);
+		int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+		int toVisitOffset = 0, currentNodeIndex = root;
+		int nodesToVisit[MAXBVHDEPTH];
+		while (true) {
+			const LinearBVHNode* node = &nodes[currentNodeIndex];
+			visits++;
+			if (node->bounds.IntersectP(r, invDir, dirIsNeg)) {
+				if (node->nPrimitives > 0) {
+					for (int i = 0; i < node->nPrimitives; i++) {
+						tests++;
+						int offset = node->primitivesOffset + i;
+						if (IntersectPrimitive(*primitives[offset], primitiveIndices[offset], r, hit, hitIndex)) hitAnything = true;
+					}
+					if (toVisitOffset == 0) break;
+					currentNodeIndex = nodesToVisit[--toVisitOffset];
+				}
+				else {
+					// ػḺʱҺӣȷ
+					if (dirIsNeg[node->axis]) {
+						nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+						currentNodeIndex = node->secondChildOffset;
+					}
+					else {
+						nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+						currentNodeIndex = currentNodeIndex + 1;
+					}
+				}
+			}
+			else {
+				if (toVisitOffset == 0) break;
+				currentNodeIndex = nodesToVisit[--toVisitOffset];
+			}
+		}
+		return hitAnything;
+	}
+
+	void BVHAccel::IntersectPacket(const RayPacket8& packet, HitPacket8& hits) const {
+		PacketRays8 soa(packet);
+		if (!soa.coherent || nodes.empty()) {
+#ifdef BVH_STATS
+			if (!soa.coherent) {
+				packetCount.fetch_add(1, std::memory_order_relaxed);
+				incoherentPackets.fetch_add(1, std::memory_order_relaxed);
+			}
+#endif // BVH_STATS
+			Accelerator::IntersectPacket(packet, hits);
+			return;
+		}
+
+		// ÿ߸һݣҵĽʱͬʱԼ tMax  SoA  tMax
+		Ray r[RayPacket8::Size];
+		int nRays = 0;
+		for (int lane = 0; lane < RayPacket8::Size; lane++) {
+			if (!(packet.activeMask & (1 << lane))) continue;
+			r[lane] = packet.rays[lane];
+			nRays++;
+		}
+		int hitIndex[RayPacket8::Size] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+		uint64_t visits = 0, tests = 0, packetVisits = 0, activeLanes = 0;
+		// ջͽڵһ𱣴游ڵ룬ûиڵĹҲк
+		struct StackEntry {
+			int index, mask;
+		};
+		StackEntry nodesToVisit[MAXBVHDEPTH];
+		int toVisitOffset = 0;
+		StackEntry current = { 0, packet.activeMask };
+		while (true) {
+			const LinearBVHNode* node = &nodes[current.index];
+			packetVisits++;
+			int mask = IntersectPacketBox(node->bounds, soa, current.mask);
+			int nLanes = 0;
+			for (int lane = 0; lane < RayPacket8::Size; lane++) nLanes += (mask >> lane) & 1;
+			activeLanes += nLanes;
+			if (nLanes == 1) {
+				// ѾɢʣµһߵΪ 7 λ SIMD 
+				int lane = 0;
+				while (!(mask & (1 << lane))) lane++;
+				if (IntersectSubtree(current.index, r[lane], hits.hits[lane], hitIndex[lane], visits, tests)) {
+					hits.hitMask |= 1 << lane;
+					soa.tMax[lane] = r[lane].tMax;
+				}
+			}
+			else if (nLanes > 1) {
+				if (node->nPrimitives > 0) {
+					for (int lane = 0; lane < RayPacket8::Size; lane++) {
+						if (!(mask & (1 << lane))) continue;
+						for (int i = 0; i < node->nPrimitives; i++) {
+							tests++;
+							int offset = node->primitivesOffset + i;
+							if (IntersectPrimitive(*primitives[offset], primitiveIndices[offset], r[lane], hits.hits[lane], hitIndex[lane])) {
+								hits.hitMask |= 1 << lane;
+							}
+						}
+						soa.tMax[lane] = r[lane].tMax;
+					}
+				}
+				else {
+					// й߷ͬ˳͵߱һ
+					if (soa.dirIsNeg[node->axis]) {
+						nodesToVisit[toVisitOffset++] = { current.index + 1, mask };
+						current = { node->secondChildOffset, mask };
+					}
+					else {
+						nodesToVisit[toVisitOffset++] = { node->secondChildOffset, mask };
+						current = { current.index + 1, mask };
+					}
+					continue;
+				}
+			}
+			if (toVisitOffset == 0) break;
+			current = nodesToVisit[--toVisitOffset];
+		}
+		for (int lane = 0; lane < RayPacket8::Size; lane++) {
+			if (!(packet.activeMask & (1 << lane))) continue;
+			for (size_t i = 0; i < unbounded.size(); i++) {
+				tests++;
+				if (IntersectPrimitive(*unbounded[i], unboundedIndices[i], r[lane], hits.hits[lane], hitIndex[lane])) {
+					hits.hitMask |= 1 << lane;
+				}
+			}
+		}
+#ifdef BVH_STATS
+		rayCount.fetch_add(nRays, std::memory_order_relaxed);
+		nodeVisits.fetch_add(visits, std::memory_order_relaxed);
+		primitiveTests.fetch_add(tests, std::memory_order_relaxed);
+		packetCount.fetch_add(1, std::memory_order_relaxed);
+		packetNodeVisits.fetch_add(packetVisits, std::memory_order_relaxed);
+		packetActiveLanes.fetch_add(activeLanes, std::memory_order_relaxed);
+#endif // BVH_STATS
+	}
+
+	bool BVHAccel::IntersectP(const Ray& ray) const {
+		bool occluded = false;
+		uint64_t visits = 0, tests = 0;
+		if (!nodes.empty()) {
+			Vector3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+			int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+			int toVisitOffset = 0, currentNodeIndex = 0;
+			int nodesToVisit[MAXBVHDEPTH];
+			while (!occluded) {
+				const LinearBVHNode* node = &nodes[currentNodeIndex];
+				visits++;
+				if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
+					if (node->nPrimitives > 0) {
+						for (int i = 0; i < node->nPrimitives && !occluded; i++) {
+							tests++;
+							occluded = primitives[node->primitivesOffset + i]->IntersectP(ray);
+						}
+						if (toVisitOffset == 0) break;
+						currentNodeIndex = nodesToVisit[--toVisitOffset];
+					}
+					else {
+						if (dirIsNeg[node->axis]) {
+							nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+							currentNodeIndex = node->secondChildOffset;
+						}
+						else {
+							nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+							currentNodeIndex = currentNodeIndex + 1;
+						}
+					}
+				}
+				else {
+					if (toVisitOffset == 0) break;
+					currentNodeIndex = nodesToVisit[--toVisitOffset];
+				}
+			}
+		}
+		for (size_t i = 0; i < unbounded.size() && !occluded; i++) {
+			tests++;
+			occluded = unbounded[i]->IntersectP(ray);
+		}
+#ifdef BVH_STATS
+		rayCount.fetch_add(1, std::memory_order_relaxed);
+		nodeVisits.fetch_add(visits, std::memory_order_relaxed);
+		primitiveTests.fetch_add(tests, std::memory_order_relaxed);
+#endif // BVH_STATS
+		return occluded;
+	}
+
+	bool BVHAccel::BoundingBox(Bounds3f& box) const {
+		if (nodes.empty() || !unbounded.empty()) return false;
+		box = nodes[0].bounds;
+		return true;
+	}
+
+	void BVHAccel::ReportStats() const {
+		std::cout << "BVH: " << primitives.size() << " primitives, " << nodes.size() << " nodes, "
+			<< leafNodes << " leaves, max depth " << maxDepth << ", SAH cost " << sahCost
+			<< ", build time " << buildTime * 1000 << "ms" << std::endl;
+		if (!unbounded.empty()) {
+			std::cout << "BVH: " << unbounded.size() << " unbounded shapes tested linearly" << std::endl;
+		}
+#ifdef BVH_STATS
+		uint64_t rays = rayCount.load();
+		if (rays > 0) {
+			std::cout << "BVH: " << rays << " rays, " << Float(nodeVisits.load()) / rays << " nodes visited and "
+				<< Float(primitiveTests.load()) / rays << " primitive tests per ray" << std::endl;
+		}
+		uint64_t packets = packetCount.load();
+		if (packets > 0) {
+			std::cout << "BVH: " << packets << " ray packets, " << Float(packetNodeVisits.load()) / packets
+				<< " nodes visited per packet with " << Float(packetActiveLanes.load()) / packetNodeVisits.load()
+				<< " of " << RayPacket8::Size << " rays hitting each node, " << incoherentPackets.load()
+				<< " incoherent packets traced ray by ray" << std::endl;
+		}
+#endif // BVH_STATS
+	}
+
+	void Accelerator::IntersectPacket(const RayPacket8& packet, HitPacket8& hits) const {
+		for (int lane = 0; lane < RayPacket8::Size; lane++) {
+			if ((packet.activeMask & (1 << lane)) && Intersect(packet.rays[lane], hits.hits[lane])) {
+				hits.hitMask |= 1 << lane;
+			}
+		}
+	}
+
+	std::shared_ptr<Shape> CreateBVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode, int width) {
+		if (width == 8) return std::make_shared<WideBVHAccel<8>>(shapes, maxPrimsInNode);
+		if (width == 4) return std::make_shared<WideBVHAccel<4>>(shapes, maxPrimsInNode);
+		return std::make_shared<BVHAccel>(shapes, maxPrimsInNode);
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef QZRT_SHAPE_BVH_H
+#define QZRT_SHAPE_BVH_H
+#include <atomic>
+#include <cstdint>
+#include "../core/QZRayTracer.h"
+#include "../core/shape.h"
+#include "ray_packet.h"
+
+//#define BVH_STATS // ͳƱʱʵĽڵ󽻴ʱ
+#define MAXBVHDEPTH 64 // ջĴСʱ֤Ȳ
+#define BVH_WIDTH 2 // CreateBVHAccel Ĭϵķ֧2 Ϊ BVH48 Ϊ SIMD 󽻵Ŀ BVH
+
+namespace raytracer {
+	struct BVHBuildNode;
+	struct BVHPrimitiveInfo;
+
+	/// <summary>
+	/// չƽ BVH ڵ㣬˳ţӽڸڵ棬
+	/// ֻҪ¼Һӵ±
+	/// </summary>
+	struct LinearBVHNode {
+		Bounds3f bounds;
+		union {
+			int primitivesOffset;   // Ҷӽڵ
+			int secondChildOffset;  // ڲڵ
+		};
+		uint16_t nPrimitives;  // 0 ʾڲڵ
+		uint8_t axis;          // ڲڵĻ
+		uint8_t pad[1];
+	};
+
+	/// <summary>
+	/// ٽṹĹӿڣȾͳϢ
+	/// </summary>
+	class Accelerator :public Shape {
+	public:
+		/// <summary>
+		/// Ϣ BVH_STATS ʱͳ
+		/// </summary>
+		virtual void ReportStats() const = 0;
+		/// <summary>
+		/// һ 8 Ľ㣬ÿߵĽ͵ Intersect ͬ
+		/// Ĭ IntersectBVHAccel дɰ
+		/// </summary>
+		virtual void IntersectPacket(const RayPacket8& packet, HitPacket8& hits) const;
+	};
+
+	/// <summary>
+	/// ΰΧмٽṹ÷Ͱ SAHʽѡλá
+	/// ɺչƽ飬ʱһ̶Сջ߷
+	/// ȷʽĺӣҵ tMax ޳ԶĽڵ㡣
+	/// ûаΧе״BoundingBox  false󽻡
+	/// </summary>
+	class BVHAccel :public Accelerator {
+	public:
+		BVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode = 4);
+		// ͨ Shape ̳
+		virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		// ʱֻ벢 tMaxͼԪ Hit ټһνϢ
+		virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		// ˳ Hit ͬһͼԪڵͷأҪ tMaxҲ HitRecord
+		virtual bool IntersectP(const Ray& ray) const override;
+		virtual bool BoundingBox(Bounds3f& box) const override;
+
+		virtual void ReportStats() const override;
+		/// <summary>
+		/// ߰һջÿڵ SIMD һβ԰лڵĹߣ
+		/// еߣҶֻеĹ󽻣ûйе
+		/// Ųһµİ˻ߵֻʣһеĽڵʱߵ
+		/// </summary>
+		virtual void IntersectPacket(const RayPacket8& packet, HitPacket8& hits) const override;
+
+	private:
+		template <int N> friend class WideBVHAccel; //  BVH ɶϲ
+		friend class TaggedScene; // öͼԪɰʹŵ
+
+		BVHBuildNode* RecursiveBuild(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end, int depth,
+			std::vector<BVHBuildNode>& buildNodes, std::vector<std::shared_ptr<Shape>>& orderedPrims);
+		int FlattenBVHTree(BVHBuildNode* node, int* offset);
+		//  root ڵ㿪ʼߵıIntersect Ӹʼֻ߰ʣһʱʼ
+		bool IntersectSubtree(int root, Ray& r, PrimitiveHit& hit, int& hitIndex, uint64_t& visits, uint64_t& tests) const;
+		// һͼԪ󽻣߾ͬǰʱ hit  hitIndex
+		bool IntersectPrimitive(const Shape& shape, int index, Ray& r, PrimitiveHit& hit, int& hitIndex) const;
+
+		const int maxPrimsInNode;
+		std::vector<std::shared_ptr<Shape>> primitives;
+		std::vector<std::shared_ptr<Shape>> unbounded;
+		std::vector<int> primitiveIndices, unboundedIndices; // ͼԪڹʱ shapes ±
+		std::vector<LinearBVHNode> nodes;
+
+		// Ϣ
+		int leafNodes, maxDepth;
+		Float sahCost, buildTime;
+#ifdef BVH_STATS
+		mutable std::atomic<uint64_t> rayCount;
+		mutable std::atomic<uint64_t> nodeVisits;
+		mutable std::atomic<uint64_t> primitiveTests;
+		mutable std::atomic<uint64_t> packetCount;
+		mutable std::atomic<uint64_t> packetNodeVisits;
+		mutable std::atomic<uint64_t> packetActiveLanes; // ÿηʽڵʱڰĹ֮
+		mutable std::atomic<uint64_t> incoherentPackets;
+#endif // BVH_STATS
+	};
+
+	/// <summary>
+	/// width Ϊ 2 ʱ BVHAccelΪ 4  8 ʱ WideBVHAccelͬһ϶Ա
+	/// </summary>
+	std::shared_ptr<Shape> CreateBVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode = 4, int width = BVH_WIDTH);
+}
+
+#endif // QZRT_SHAPE_BVH_H
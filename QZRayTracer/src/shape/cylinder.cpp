@@ -2,6 +2,11 @@
 
 namespace raytracer {
 	bool Cylinder::Hit(const Ray& ray, HitRecord& rec) const {
+		if (!IntersectCylinder(center, radius, zMin, zMax, ray, rec.t, rec.p, rec.normal)) return false;
+		rec.mat = material.get();
+		return true;
+	}
+	bool IntersectCylinder(const Point3f& center, Float radius, Float zMin, Float zMax, const Ray& ray, Float& tHit, Point3f& p, Normal3f& n) {
 		Float dx = ray.d.x;
 		Float dz = ray.d.z;
 		Float cox = ray.o.x - center.x;
@@ -86,13 +91,19 @@ namespace raytracer {
 			}
 		}
 
-		rec.t = tShapeHit;
-		rec.p = pHit;
-		rec.normal = normal;
-		rec.mat = material;
+		tHit = tShapeHit;
+		p = pHit;
+		n = normal;
 
 		return true;
 	}
+	bool Cylinder::BoundingBox(Bounds3f& box) const {
+		//  Sphere::BoundingBox һŴ󼸸 ulpòͶϵĽ䵽Χ
+		Float r = std::abs(radius) * (1 + 4 * MachineEpsilon) + 4 * MachineEpsilon * std::max(std::abs(center.x), std::abs(center.z));
+		Float pad = 4 * MachineEpsilon * std::max(std::abs(zMin), std::abs(zMax));
+		box = Bounds3f(Point3f(center.x - r, zMin - pad, center.z - r), Point3f(center.x + r, zMax + pad, center.z + r));
+		return true;
+	}
 	std::shared_ptr<Shape> CreateCylinderShape(Point3f center, Float radius, Float zMin, Float zMax, std::shared_ptr<Material> material){
 		return std::make_shared<Cylinder>(center, radius, zMin, zMax, material);
 	}
@@ -21,8 +21,14 @@ namespace raytracer {
 		};
 		// ͨ Shape ̳
 		virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		virtual bool BoundingBox(Bounds3f& box) const override;
 	};
 
+	/// <summary>
+	/// Բ󽻣Cylinder::Hit  TaggedScene ãʱд롢ͷ
+	/// </summary>
+	bool IntersectCylinder(const Point3f& center, Float radius, Float zMin, Float zMax, const Ray& ray, Float& tHit, Point3f& p, Normal3f& n);
+
 	std::shared_ptr<Shape> CreateCylinderShape(Point3f center, Float radius, Float zMin, Float zMax, std::shared_ptr<Material> material);
 }
 #endif // QZRT_SHAPE_CYLINDER_H
@@ -0,0 +1,4 @@
+#include "ray_packet.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
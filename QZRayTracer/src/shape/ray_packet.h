@@ -0,0 +1,123 @@
+#ifndef QZRT_SHAPE_RAY_PACKET_H
+#define QZRT_SHAPE_RAY_PACKET_H
+#include "../core/QZRayTracer.h"
+#include "../core/geometry.h"
+#include "../core/shape.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QZRT_HAVE_SSE
+#include <immintrin.h>
+#endif
+#if defined(QZRT_HAVE_SSE) && !defined(PBRT_FLOAT_AS_DOUBLE)
+#define QZRT_PACKET_SIMD // ߰İΧв SSE/AVXFloat Ϊ double ʱ˻ر
+#endif
+
+namespace raytracer {
+	/// <summary>
+	/// һ BVH  8 ߣactiveMask ЧĹߣؿͼԵʱܲ 8 
+	/// </summary>
+	struct RayPacket8 {
+		static const int Size = 8;
+		RayPacket8() : activeMask(0) {}
+		void Set(int lane, const Ray& ray) {
+			rays[lane] = ray;
+			activeMask |= 1 << lane;
+		}
+		Ray rays[Size];
+		int activeMask;
+	};
+
+	/// <summary>
+	/// ߰󽻽hitMask ĵ i λʾ i ߻Уhits[i] ͵ Intersect õͬ
+	/// </summary>
+	struct HitPacket8 {
+		HitPacket8() : hitMask(0) {}
+		PrimitiveHit hits[RayPacket8::Size];
+		int hitMask;
+	};
+
+	/// <summary>
+	/// ߰ SoA ŵݣͬһ 8 ߵķģһ AVX SSEָ
+	/// ʱ tMax ߵ̣ЧĹ tMax Ϊ -infκΰΧжС
+	/// Ч߷ķŶͬʱ coherent Ϊ true dirIsNeg ӵķ˳
+	/// </summary>
+	struct PacketRays8 {
+		PacketRays8(const RayPacket8& packet) : coherent(true) {
+			int first = -1;
+			for (int i = 0; i < RayPacket8::Size; i++) {
+				if (!(packet.activeMask & (1 << i))) {
+					for (int axis = 0; axis < 3; axis++) o[axis][i] = invDir[axis][i] = 0;
+					tMax[i] = -Infinity;
+					continue;
+				}
+				const Ray& r = packet.rays[i];
+				for (int axis = 0; axis < 3; axis++) {
+					o[axis][i] = r.o[axis];
+					invDir[axis][i] = 1 / r.d[axis];
+				}
+				tMax[i] = r.tMax;
+				int neg[3] = { invDir[0][i] < 0, invDir[1][i] < 0, invDir[2][i] < 0 };
+				if (first < 0) {
+					first = i;
+					for (int axis = 0; axis < 3; axis++) dirIsNeg[axis] = neg[axis];
+				}
+				else if (neg[0] != dirIsNeg[0] || neg[1] != dirIsNeg[1] || neg[2] != dirIsNeg[2]) {
+					coherent = false;
+				}
+			}
+		}
+		Float o[3][RayPacket8::Size], invDir[3][RayPacket8::Size];
+		Float tMax[RayPacket8::Size];
+		int dirIsNeg[3];
+		bool coherent;
+	};
+
+	/// <summary>
+	///  mask ĹͬʱͰΧ slab ԣеĹߵλ롣
+	/// ж Bounds3::IntersectP һ£㲻뿪㡢 tMax ֮ǰ뿪 0 ֮
+	/// ֻԷһµİʹãԽԶƽй߶һ
+	/// </summary>
+	inline int IntersectPacketBox(const Bounds3f& bounds, const PacketRays8& rays, int mask) {
+		int hitMask = 0;
+#if defined(QZRT_PACKET_SIMD) && defined(__AVX__)
+		__m256 entry = _mm256_set1_ps(-INFINITY), exit = _mm256_set1_ps(INFINITY);
+		for (int axis = 0; axis < 3; axis++) {
+			__m256 o = _mm256_loadu_ps(rays.o[axis]), invDir = _mm256_loadu_ps(rays.invDir[axis]);
+			__m256 tNear = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds[rays.dirIsNeg[axis]][axis]), o), invDir);
+			__m256 tFar = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds[1 - rays.dirIsNeg[axis]][axis]), o), invDir);
+			entry = _mm256_max_ps(tNear, entry);
+			exit = _mm256_min_ps(tFar, exit);
+		}
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ),
+			_mm256_and_ps(_mm256_cmp_ps(entry, _mm256_loadu_ps(rays.tMax), _CMP_LT_OQ), _mm256_cmp_ps(exit, _mm256_setzero_ps(), _CMP_GT_OQ)));
+		hitMask = _mm256_movemask_ps(hit);
+#elif defined(QZRT_PACKET_SIMD)
+		for (int k = 0; k < RayPacket8::Size; k += 4) {
+			__m128 entry = _mm_set1_ps(-INFINITY), exit = _mm_set1_ps(INFINITY);
+			for (int axis = 0; axis < 3; axis++) {
+				__m128 o = _mm_loadu_ps(&rays.o[axis][k]), invDir = _mm_loadu_ps(&rays.invDir[axis][k]);
+				__m128 tNear = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds[rays.dirIsNeg[axis]][axis]), o), invDir);
+				__m128 tFar = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bounds[1 - rays.dirIsNeg[axis]][axis]), o), invDir);
+				entry = _mm_max_ps(tNear, entry);
+				exit = _mm_min_ps(tFar, exit);
+			}
+			__m128 hit = _mm_and_ps(_mm_cmple_ps(entry, exit),
+				_mm_and_ps(_mm_cmplt_ps(entry, _mm_loadu_ps(&rays.tMax[k])), _mm_cmpgt_ps(exit, _mm_setzero_ps())));
+			hitMask |= _mm_movemask_ps(hit) << k;
+		}
+#else
+		for (int i = 0; i < RayPacket8::Size; i++) {
+			Float entry = -Infinity, exit = Infinity;
+			for (int axis = 0; axis < 3; axis++) {
+				Float tNear = (bounds[rays.dirIsNeg[axis]][axis] - rays.o[axis][i]) * rays.invDir[axis][i];
+				Float tFar = (bounds[1 - rays.dirIsNeg[axis]][axis] - rays.o[axis][i]) * rays.invDir[axis][i];
+				if (tNear > entry) entry = tNear;
+				if (tFar < exit) exit = tFar;
+			}
+			if (entry <= exit && entry < rays.tMax[i] && exit > 0) hitMask |= 1 << i;
+		}
+#endif // QZRT_PACKET_SIMD
+		return hitMask & mask;
+	}
+}
+
+#endif // QZRT_SHAPE_RAY_PACKET_H
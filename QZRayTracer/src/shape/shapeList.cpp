@@ -2,18 +2,39 @@
 
 namespace raytracer {
     bool raytracer::ShapeList::Hit(const Ray& ray, HitRecord& rec) const {
-        HitRecord tempRec;
+        PrimitiveHit hit;
+        if (!Intersect(ray, hit)) return false;
+        hit.shape->ComputeSurfaceInteraction(ray, hit, rec);
+        return true;
+    }
+    bool ShapeList::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+        // ҵ tMax״ֻҪҸĽ
+        Ray r = ray;
         bool hitAnything = false;
-        Float closestSoFar = ray.tMax;
         for (int i = 0; i < shapes.size(); i++) {
-            if (shapes[i]->Hit(ray, tempRec) && tempRec.t < closestSoFar) {
+            if (shapes[i]->Intersect(r, hit)) {
                 hitAnything = true;
-                closestSoFar = tempRec.t;
-                rec = tempRec;
+                r.tMax = hit.t;
             }
         }
         return hitAnything;
     }
+    bool ShapeList::IntersectP(const Ray& ray) const {
+        for (size_t i = 0; i < shapes.size(); i++) {
+            if (shapes[i]->IntersectP(ray)) return true;
+        }
+        return false;
+    }
+    bool ShapeList::BoundingBox(Bounds3f& box) const {
+        if (shapes.empty()) return false;
+        box = Bounds3f();
+        for (size_t i = 0; i < shapes.size(); i++) {
+            Bounds3f shapeBox;
+            if (!shapes[i]->BoundingBox(shapeBox)) return false;
+            box = Union(box, shapeBox);
+        }
+        return true;
+    }
     std::shared_ptr<Shape> CreateShapeList(std::vector<std::shared_ptr<Shape>> shapes) {
         return std::make_shared<ShapeList>(shapes);
     }
@@ -10,6 +10,9 @@ namespace raytracer {
 		ShapeList(std::vector<std::shared_ptr<Shape>> shapes) :shapes(shapes) {}
 		// ͨ Shape ̳
 		virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		virtual bool IntersectP(const Ray& ray) const override;
+		virtual bool BoundingBox(Bounds3f& box) const override;
 		std::vector<std::shared_ptr<Shape>> shapes;
 	};
 
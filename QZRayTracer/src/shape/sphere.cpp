@@ -2,21 +2,38 @@
 namespace raytracer {
 	bool Sphere::Hit(const Ray& ray, HitRecord& rec) const
 	{
-		Vector3f oc = ray.o - center;
-		Float a = Dot(ray.d, ray.d);
-		Float b = 2.0 * Dot(oc, ray.d);
-		Float c = Dot(oc, oc) - radius * radius;
-		Float discriminant = b * b - 4 * a * c;
-		// жиȡСĸΪеҪʱ(԰tʱ)
-		Float t0, t1;
-		if (!Quadratic(a, b, c, t0, t1)) return false;
-		
-		if (t0 > ray.tMax || t1 <= ShadowEpsilon) return false;
-		Float tShapeHit = t0 < ShadowEpsilon ? t1 : t0;
-		rec.t = tShapeHit;
-		rec.p = ray(tShapeHit);
+		PrimitiveHit hit;
+		if (!Intersect(ray, hit)) return false;
+		ComputeSurfaceInteraction(ray, hit, rec);
+		return true;
+	}
+	bool Sphere::Intersect(const Ray& ray, PrimitiveHit& hit) const
+	{
+		Float tShapeHit;
+		if (!IntersectSphere(center, radius, ray, tShapeHit)) return false;
+		hit.t = tShapeHit;
+		hit.shape = this;
+		return true;
+	}
+	void Sphere::ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const
+	{
+		rec.t = hit.t;
+		rec.p = ray(hit.t);
 		rec.normal = Normal3f((rec.p - center) * invRadius);
-		rec.mat = material;
+		rec.mat = material.get();
+	}
+	bool Sphere::IntersectP(const Ray& ray) const
+	{
+		Float tShapeHit;
+		return IntersectSphere(center, radius, ray, tShapeHit);
+	}
+	bool Sphere::BoundingBox(Bounds3f& box) const
+	{
+		// Ĳø뾶תߣΧҪȡֵ
+		// 󽻵ý䵽ȷ center  r ֮һ㣬뾶Ŵ󼸸 ulp
+		// ټϺСɱľ BVH © r = 1000 ĵ棩ԵĽ
+		Float r = std::abs(radius) * (1 + 4 * MachineEpsilon) + 4 * MachineEpsilon * MaxComponent(Abs(Vector3f(center)));
+		box = Bounds3f(center - Vector3f(r, r, r), center + Vector3f(r, r, r));
 		return true;
 	}
 	std::shared_ptr<Shape> CreateSphereShape(Point3f center, Float radius, std::shared_ptr<Material> material)
@@ -16,8 +16,29 @@ namespace raytracer {
 		};
 		// ͨ Shape ̳
 		virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		virtual void ComputeSurfaceInteraction(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const override;
+		virtual bool IntersectP(const Ray& ray) const override;
+		virtual bool BoundingBox(Bounds3f& box) const override;
 	};
 
+	/// <summary>
+	/// 󽻺ģֻ (ShadowEpsilon, ray.tMax) ֮ľ롣
+	/// Sphere  TaggedScene ãͷʱѭ
+	/// </summary>
+	inline bool IntersectSphere(const Point3f& center, Float radius, const Ray& ray, Float& tHit) {
+		Vector3f oc = ray.o - center;
+		Float a = Dot(ray.d, ray.d);
+		Float b = 2.0 * Dot(oc, ray.d);
+		Float c = Dot(oc, oc) - radius * radius;
+		// жиȡСĸΪеҪʱ(԰tʱ)
+		Float t0, t1;
+		if (!Quadratic(a, b, c, t0, t1)) return false;
+		if (t0 > ray.tMax || t1 <= ShadowEpsilon) return false;
+		tHit = t0 < ShadowEpsilon ? t1 : t0;
+		return tHit < ray.tMax;
+	}
+
 	std::shared_ptr<Shape> CreateSphereShape(Point3f center, Float radius, std::shared_ptr<Material> material);
 }
 #endif // QZRT_SHAPE_SPHERE_H
\ No newline at end of file
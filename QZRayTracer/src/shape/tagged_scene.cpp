@@ -0,0 +1,207 @@
+#include "tagged_scene.h"
+#include "sphere.h"
+#include "cylinder.h"
+#include "../material/lambertian.h"
+#include "../material/metal.h"
+#include "../material/dielectric.h"
+
+namespace raytracer {
+	TaggedScene::TaggedScene(std::shared_ptr<Shape> world) {
+		auto bvh = std::dynamic_pointer_cast<BVHAccel>(world);
+		if (!bvh) {
+			unbounded.push_back(world);
+			return;
+		}
+		nodes = bvh->nodes;
+		for (LinearBVHNode& node : nodes) {
+			if (node.nPrimitives == 0) continue;
+			TaggedLeaf leaf;
+			leaf.sphereOffset = int(spheres.size());
+			leaf.cylinderOffset = int(cylinders.size());
+			leaf.shapeOffset = int(shapes.size());
+			for (int i = 0; i < node.nPrimitives; i++) {
+				AddPrimitive(bvh->primitives[node.primitivesOffset + i]);
+			}
+			leaf.nSpheres = uint16_t(spheres.size() - leaf.sphereOffset);
+			leaf.nCylinders = uint16_t(cylinders.size() - leaf.cylinderOffset);
+			leaf.nShapes = uint16_t(shapes.size() - leaf.shapeOffset);
+			node.primitivesOffset = int(leaves.size());
+			leaves.push_back(leaf);
+		}
+		unbounded = bvh->unbounded;
+	}
+
+	void TaggedScene::AddPrimitive(const std::shared_ptr<Shape>& shape) {
+		if (auto sphere = std::dynamic_pointer_cast<Sphere>(shape)) {
+			spheres.push_back({ sphere->center, sphere->radius, sphere->invRadius, AddMaterial(sphere->material) });
+		}
+		else if (auto cylinder = std::dynamic_pointer_cast<Cylinder>(shape)) {
+			cylinders.push_back({ cylinder->center, cylinder->radius, cylinder->zMin, cylinder->zMax, AddMaterial(cylinder->material) });
+		}
+		else {
+			shapes.push_back(shape);
+		}
+	}
+
+	MaterialRef TaggedScene::AddMaterial(const std::shared_ptr<Material>& material) {
+		auto found = materialRefs.find(material.get());
+		if (found != materialRefs.end()) return found->second;
+		MaterialRef ref;
+		if (auto lambertian = std::dynamic_pointer_cast<Lambertian>(material)) {
+			ref = { MaterialKind::Lambertian, int(lambertians.size()) };
+			lambertians.push_back({ lambertian->albedo });
+		}
+		else if (auto metal = std::dynamic_pointer_cast<Metal>(material)) {
+			ref = { MaterialKind::Metal, int(metals.size()) };
+			metals.push_back({ metal->albedo, metal->fuzz });
+		}
+		else if (auto dielectric = std::dynamic_pointer_cast<Dielectric>(material)) {
+			ref = { MaterialKind::Dielectric, int(dielectrics.size()) };
+			dielectrics.push_back({ dielectric->refractionIndex, dielectric->invRefractionIndex });
+		}
+		else {
+			ref = { MaterialKind::Virtual, int(materials.size()) };
+			materials.push_back(material);
+		}
+		materialRefs[material.get()] = ref;
+		return ref;
+	}
+
+	bool TaggedScene::Intersect(const Ray& ray, TaggedHit& hit) const {
+		//  BVHAccel::Intersect һֻ벢 tMaxֻͼԪ㽻
+		Ray r = ray;
+		ShapeKind hitKind = ShapeKind::Virtual;
+		int hitIndex = -1;
+		PrimitiveHit virtualHit;
+		Point3f cylinderP;
+		Normal3f cylinderNormal;
+		auto intersectLeaf = [&](const TaggedLeaf& leaf) {
+			for (int i = leaf.sphereOffset; i < leaf.sphereOffset + leaf.nSpheres; i++) {
+				Float t;
+				if (IntersectSphere(spheres[i].center, spheres[i].radius, r, t)) {
+					r.tMax = t;
+					hitKind = ShapeKind::Sphere;
+					hitIndex = i;
+				}
+			}
+			for (int i = leaf.cylinderOffset; i < leaf.cylinderOffset + leaf.nCylinders; i++) {
+				const TaggedCylinder& cylinder = cylinders[i];
+				Float t;
+				Point3f p;
+				Normal3f n;
+				if (IntersectCylinder(cylinder.center, cylinder.radius, cylinder.zMin, cylinder.zMax, r, t, p, n) && t < r.tMax) {
+					r.tMax = t;
+					hitKind = ShapeKind::Cylinder;
+					hitIndex = i;
+					cylinderP = p;
+					cylinderNormal = n;
+				}
+			}
+			for (int i = leaf.shapeOffset; i < leaf.shapeOffset + leaf.nShapes; i++) {
+				if (shapes[i]->Intersect(r, virtualHit)) {
+					r.tMax = virtualHit.t;
+					hitKind = ShapeKind::Virtual;
+					hitIndex = i;
+				}
+			}
+		};
+
+		if (!nodes.empty()) {
+			Vector3f invDir(1 / r.d.x, 1 / r.d.y, 1 / r.d.z);
+			int dirIsNeg[3] = { invDir.x < 0, invDir.y < 0, invDir.z < 0 };
+			int toVisitOffset = 0, currentNodeIndex = 0;
+			int nodesToVisit[MAXBVHDEPTH];
+			while (true) {
+				const LinearBVHNode* node = &nodes[currentNodeIndex];
+				if (node->bounds.IntersectP(r, invDir, dirIsNeg)) {
+					if (node->nPrimitives > 0) {
+						intersectLeaf(leaves[node->primitivesOffset]);
+						if (toVisitOffset == 0) break;
+						currentNodeIndex = nodesToVisit[--toVisitOffset];
+					}
+					else {
+						if (dirIsNeg[node->axis]) {
+							nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+							currentNodeIndex = node->secondChildOffset;
+						}
+						else {
+							nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+							currentNodeIndex = currentNodeIndex + 1;
+						}
+					}
+				}
+				else {
+					if (toVisitOffset == 0) break;
+					currentNodeIndex = nodesToVisit[--toVisitOffset];
+				}
+			}
+		}
+		for (size_t i = 0; i < unbounded.size(); i++) {
+			if (unbounded[i]->Intersect(r, virtualHit)) {
+				r.tMax = virtualHit.t;
+				hitKind = ShapeKind::Virtual;
+				hitIndex = i;
+			}
+		}
+		if (hitIndex < 0) return false;
+
+		hit.t = r.tMax;
+		switch (hitKind) {
+		case ShapeKind::Sphere: {
+			const TaggedSphere& sphere = spheres[hitIndex];
+			hit.p = ray(hit.t);
+			hit.normal = Normal3f((hit.p - sphere.center) * sphere.invRadius);
+			hit.material = sphere.material;
+			break;
+		}
+		case ShapeKind::Cylinder:
+			hit.p = cylinderP;
+			hit.normal = cylinderNormal;
+			hit.material = cylinders[hitIndex].material;
+			break;
+		default: {
+			HitRecord rec;
+			virtualHit.shape->ComputeSurfaceInteraction(ray, virtualHit, rec);
+			hit.p = rec.p;
+			hit.normal = rec.normal;
+			hit.material = { MaterialKind::Virtual, -1 };
+			hit.virtualMaterial = rec.mat;
+			return true;
+		}
+		}
+		hit.virtualMaterial = hit.material.kind == MaterialKind::Virtual ? materials[hit.material.index].get() : nullptr;
+		return true;
+	}
+
+	bool TaggedScene::Scatter(const Ray& wi, const TaggedHit& hit, Point3f& attenuation, Ray& wo, Sampler& sampler) const {
+		switch (hit.material.kind) {
+		case MaterialKind::Lambertian: {
+			const TaggedLambertian& m = lambertians[hit.material.index];
+			return ScatterLambertian(m.albedo, hit.p, hit.normal, attenuation, wo, sampler);
+		}
+		case MaterialKind::Metal: {
+			const TaggedMetal& m = metals[hit.material.index];
+			return ScatterMetal(m.albedo, m.fuzz, wi, hit.p, hit.normal, attenuation, wo, sampler);
+		}
+		case MaterialKind::Dielectric: {
+			const TaggedDielectric& m = dielectrics[hit.material.index];
+			return ScatterDielectric(m.refractionIndex, m.invRefractionIndex, wi, hit.p, hit.normal, attenuation, wo, sampler);
+		}
+		default: {
+			HitRecord rec;
+			rec.t = hit.t;
+			rec.p = hit.p;
+			rec.normal = hit.normal;
+			return hit.virtualMaterial->Scatter(wi, rec, attenuation, wo, sampler);
+		}
+		}
+	}
+
+	void TaggedScene::ReportStats() const {
+		std::cout << "Tagged scene: " << spheres.size() << " spheres (" << sizeof(TaggedSphere) << " bytes each, "
+			<< sizeof(Sphere) << " as Sphere), " << cylinders.size() << " cylinders, "
+			<< shapes.size() + unbounded.size() << " shapes through virtual calls" << std::endl;
+		std::cout << "Tagged scene: " << lambertians.size() << " lambertian, " << metals.size() << " metal, "
+			<< dielectrics.size() << " dielectric, " << materials.size() << " materials through virtual calls" << std::endl;
+	}
+}
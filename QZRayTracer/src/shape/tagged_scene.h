@@ -0,0 +1,104 @@
+#ifndef QZRT_SHAPE_TAGGED_SCENE_H
+#define QZRT_SHAPE_TAGGED_SCENE_H
+#include <cstdint>
+#include <map>
+#include "../core/QZRayTracer.h"
+#include "../core/material.h"
+#include "bvh.h"
+
+namespace raytracer {
+	/// <summary>
+	/// TaggedScene ʶ״ͲʣĶ鵽 Virtualԭ麯ӿ
+	/// </summary>
+	enum class ShapeKind : uint8_t { Sphere, Cylinder, Virtual };
+	enum class MaterialKind : uint8_t { Lambertian, Metal, Dielectric, Virtual };
+
+	/// <summary>
+	/// ʵͺڶӦ±꣬ shared_ptr&lt;Material&gt;ʱûü
+	/// </summary>
+	struct MaterialRef {
+		MaterialKind kind;
+		int index;
+	};
+
+	struct TaggedSphere {
+		Point3f center;
+		Float radius, invRadius;
+		MaterialRef material;
+	};
+
+	struct TaggedCylinder {
+		Point3f center;
+		Float radius, zMin, zMax;
+		MaterialRef material;
+	};
+
+	struct TaggedLambertian {
+		Point3f albedo;
+	};
+
+	struct TaggedMetal {
+		Point3f albedo;
+		Float fuzz;
+	};
+
+	struct TaggedDielectric {
+		Float refractionIndex, invRefractionIndex;
+	};
+
+	/// <summary>
+	/// ҶͼԪͷֳΣÿڸ͵
+	/// </summary>
+	struct TaggedLeaf {
+		int sphereOffset, cylinderOffset, shapeOffset;
+		uint16_t nSpheres, nCylinders, nShapes;
+	};
+
+	/// <summary>
+	/// Ϣֻһ MaterialRef shared_ptr
+	/// </summary>
+	struct TaggedHit {
+		Float t;
+		Point3f p;
+		Normal3f normal;
+		MaterialRef material;
+		const Material* virtualMaterial; // material.kind Ϊ Virtual ʱʹ
+	};
+
+	/// <summary>
+	/// ͷֿŵĳԲֲʸһ飬öٺ±ã
+	/// 󽻺ɢ switch ɣ麯ȵ󽻺ɢ
+	/// ֱȡ BVHAccelҶͬͼԪһ𣬱ʱһҶӰ󽻡
+	/// ʶ״ͲʱԭĶȻ麯Ϊݲ
+	/// </summary>
+	class TaggedScene {
+	public:
+		/// <summary>
+		/// world  BVHAccel ʱ world Ϊһ麯ͼԪ
+		/// </summary>
+		TaggedScene(std::shared_ptr<Shape> world);
+
+		bool Intersect(const Ray& ray, TaggedHit& hit) const;
+		bool Scatter(const Ray& wi, const TaggedHit& hit, Point3f& attenuation, Ray& wo, Sampler& sampler) const;
+
+		void ReportStats() const;
+
+	private:
+		void AddPrimitive(const std::shared_ptr<Shape>& shape);
+		MaterialRef AddMaterial(const std::shared_ptr<Material>& material);
+
+		std::vector<LinearBVHNode> nodes; // Ҷӵ primitivesOffset  leaves ±
+		std::vector<TaggedLeaf> leaves;
+		std::vector<TaggedSphere> spheres;
+		std::vector<TaggedCylinder> cylinders;
+		std::vector<std::shared_ptr<Shape>> shapes;    // ShapeKind::Virtual
+		std::vector<std::shared_ptr<Shape>> unbounded; // 
+		std::vector<TaggedLambertian> lambertians;
+		std::vector<TaggedMetal> metals;
+		std::vector<TaggedDielectric> dielectrics;
+		std::vector<std::shared_ptr<Material>> materials; // MaterialKind::Virtual
+		std::map<const Material*, MaterialRef> materialRefs;
+	};
+}
+
+#endif // QZRT_SHAPE_TAGGED_SCENE_H
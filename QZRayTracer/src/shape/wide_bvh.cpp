@@ -0,0 +1,4 @@
+#include "wide_bvh.h"
+namespace raytracer {
+	
+}
\ No newline at end of file
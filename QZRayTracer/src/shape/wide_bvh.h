@@ -0,0 +1,361 @@
+#ifndef QZRT_SHAPE_WIDE_BVH_H
+#define QZRT_SHAPE_WIDE_BVH_H
+#include <chrono>
+#include "bvh.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QZRT_HAVE_SSE
+#include <immintrin.h>
+#endif
+
+namespace raytracer {
+	/// <summary>
+	/// N  BVH ڵ㣬N ӵİΧа SoA ţbounds[0/1][][]
+	/// ͬһ N ӵı߽ N  floatһ SSE/AVX ָܺ͹󽻡
+	/// N = 4 ʱһڵ 128 ֽڣN = 8 ʱ 256 ֽ
+	/// </summary>
+	template <int N>
+	struct WideBVHNode {
+		float bounds[2][3][N];
+		int child[N];        // ڲӣӽڵ±ꣻҶӺӣһͼԪλ
+		int nPrimitives[N];  // 0 ʾڲӣ-1 ʾղ
+	};
+
+	/// <summary>
+	/// ԤõĹݣÿѾת float  SIMD ʹ
+	/// </summary>
+	struct WideBVHRay {
+		WideBVHRay(const Ray& r) {
+			for (int i = 0; i < 3; i++) {
+				o[i] = float(r.o[i]);
+				invDir[i] = float(1 / r.d[i]);
+				dirIsNeg[i] = invDir[i] < 0;
+			}
+		}
+		float o[3], invDir[3];
+		int dirIsNeg[3];
+	};
+
+	/// <summary>
+	/// ߺͽڵ N ͬʱ slab ԣкӵλ룬tEntry дÿӵĽ룬
+	/// ʱж Bounds3::IntersectP һ£㲻뿪㡢 tMax ֮ǰ뿪 0 ֮
+	/// SSE ÿδ 4 ӣmax/min ֵڵһ0 * inf õ NaN ʱ֮ǰ䣬ͱ汾ıȽΪͬ
+	/// </summary>
+	template <int N>
+	inline int IntersectWideNode(const WideBVHNode<N>& node, const WideBVHRay& ray, float tMax, float* tEntry) {
+		int mask = 0;
+#ifdef QZRT_HAVE_SSE
+		for (int k = 0; k < N; k += 4) {
+			__m128 entry = _mm_set1_ps(-INFINITY), exit = _mm_set1_ps(INFINITY);
+			for (int axis = 0; axis < 3; axis++) {
+				__m128 o = _mm_set1_ps(ray.o[axis]), invDir = _mm_set1_ps(ray.invDir[axis]);
+				__m128 tNear = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.bounds[ray.dirIsNeg[axis]][axis][k]), o), invDir);
+				__m128 tFar = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.bounds[1 - ray.dirIsNeg[axis]][axis][k]), o), invDir);
+				entry = _mm_max_ps(tNear, entry);
+				exit = _mm_min_ps(tFar, exit);
+			}
+			_mm_storeu_ps(tEntry + k, entry);
+			__m128 hit = _mm_and_ps(_mm_cmple_ps(entry, exit),
+				_mm_and_ps(_mm_cmplt_ps(entry, _mm_set1_ps(tMax)), _mm_cmpgt_ps(exit, _mm_setzero_ps())));
+			mask |= _mm_movemask_ps(hit) << k;
+		}
+#else
+		for (int i = 0; i < N; i++) {
+			float entry = -INFINITY, exit = INFINITY;
+			for (int axis = 0; axis < 3; axis++) {
+				float tNear = (node.bounds[ray.dirIsNeg[axis]][axis][i] - ray.o[axis]) * ray.invDir[axis];
+				float tFar = (node.bounds[1 - ray.dirIsNeg[axis]][axis][i] - ray.o[axis]) * ray.invDir[axis];
+				if (tNear > entry) entry = tNear;
+				if (tFar < exit) exit = tFar;
+			}
+			tEntry[i] = entry;
+			if (entry <= exit && entry < tMax && exit > 0) mask |= 1 << i;
+		}
+#endif // QZRT_HAVE_SSE
+		return mask;
+	}
+
+#ifdef __AVX__
+	template <>
+	inline int IntersectWideNode<8>(const WideBVHNode<8>& node, const WideBVHRay& ray, float tMax, float* tEntry) {
+		__m256 entry = _mm256_set1_ps(-INFINITY), exit = _mm256_set1_ps(INFINITY);
+		for (int axis = 0; axis < 3; axis++) {
+			__m256 o = _mm256_set1_ps(ray.o[axis]), invDir = _mm256_set1_ps(ray.invDir[axis]);
+			__m256 tNear = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[ray.dirIsNeg[axis]][axis]), o), invDir);
+			__m256 tFar = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.bounds[1 - ray.dirIsNeg[axis]][axis]), o), invDir);
+			entry = _mm256_max_ps(tNear, entry);
+			exit = _mm256_min_ps(tFar, exit);
+		}
+		_mm256_storeu_ps(tEntry, entry);
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ),
+			_mm256_and_ps(_mm256_cmp_ps(entry, _mm256_set1_ps(tMax), _CMP_LT_OQ), _mm256_cmp_ps(exit, _mm256_setzero_ps(), _CMP_GT_OQ)));
+		return _mm256_movemask_ps(hit);
+	}
+#endif // __AVX__
+
+	/// <summary>
+	///  BVHN = 4 Ϊ QBVHN = 8 Ϊ OBVH BVHAccel  SAH 
+	/// Զºϲÿչڲӣֱ N ӣҶӺͼԪ˳򱣳ֲ䡣
+	/// ʱһβԽڵȫӣеĺӰӽԶʣ
+	/// ջʱѾǰֱ
+	/// 4 ʹ SSE8 ڱ AVX/arch:AVX2  -mavx2ʱʹ AVX SSE
+	/// </summary>
+	template <int N>
+	class WideBVHAccel :public Accelerator {
+		static_assert(N == 4 || N == 8, "WideBVHAccel supports 4 or 8 children");
+	public:
+		WideBVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode = 4);
+		// ͨ Shape ̳
+		virtual bool Hit(const Ray& ray, HitRecord& rec) const override;
+		virtual bool Intersect(const Ray& ray, PrimitiveHit& hit) const override;
+		virtual bool IntersectP(const Ray& ray) const override;
+		virtual bool BoundingBox(Bounds3f& box) const override;
+
+		virtual void ReportStats() const override;
+
+	private:
+		int CollapseNode(const std::vector<LinearBVHNode>& binaryNodes, int index, int depth);
+
+		std::vector<std::shared_ptr<Shape>> primitives;
+		std::vector<std::shared_ptr<Shape>> unbounded;
+		std::vector<WideBVHNode<N>> nodes;
+		Bounds3f bounds;
+
+		// Ϣ
+		int binaryNodes, maxDepth;
+		Float binarySahCost, buildTime;
+#ifdef BVH_STATS
+		mutable std::atomic<uint64_t> rayCount;
+		mutable std::atomic<uint64_t> nodeVisits;
+		mutable std::atomic<uint64_t> primitiveTests;
+#endif // BVH_STATS
+	};
+
+	template <int N>
+	WideBVHAccel<N>::WideBVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode)
+		: binaryNodes(0), maxDepth(0), binarySahCost(0), buildTime(0) {
+#ifdef BVH_STATS
+		rayCount = 0;
+		nodeVisits = 0;
+		primitiveTests = 0;
+#endif // BVH_STATS
+		auto start = std::chrono::steady_clock::now();
+		BVHAccel binary(shapes, maxPrimsInNode);
+		primitives.swap(binary.primitives);
+		unbounded.swap(binary.unbounded);
+		binaryNodes = int(binary.nodes.size());
+		binarySahCost = binary.sahCost;
+		if (binary.nodes.empty()) return;
+		bounds = binary.nodes[0].bounds;
+		nodes.reserve(binary.nodes.size() / (N - 1) + 1);
+		CollapseNode(binary.nodes, 0, 1);
+		buildTime = std::chrono::duration<Float>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	template <int N>
+	int WideBVHAccel<N>::CollapseNode(const std::vector<LinearBVHNode>& binaryNodes, int index, int depth) {
+		maxDepth = std::max(maxDepth, depth);
+		int myOffset = int(nodes.size());
+		nodes.push_back(WideBVHNode<N>());
+
+		// Ҷʱֻһӣӿʼչڲ
+		int slots[N];
+		int nSlots = 0;
+		if (binaryNodes[index].nPrimitives > 0) {
+			slots[nSlots++] = index;
+		}
+		else {
+			slots[nSlots++] = index + 1;
+			slots[nSlots++] = binaryNodes[index].secondChildOffset;
+		}
+		while (nSlots < N) {
+			int expand = -1;
+			Float maxArea = -1;
+			for (int i = 0; i < nSlots; i++) {
+				const LinearBVHNode& node = binaryNodes[slots[i]];
+				if (node.nPrimitives > 0) continue;
+				Float area = node.bounds.SurfaceArea();
+				if (area > maxArea) {
+					maxArea = area;
+					expand = i;
+				}
+			}
+			if (expand < 0) break;
+			int node = slots[expand];
+			slots[expand] = node + 1;
+			slots[nSlots++] = binaryNodes[node].secondChildOffset;
+		}
+
+		// ղ۵İΧǷģκι߶
+		WideBVHNode<N> wideNode;
+		for (int i = 0; i < N; i++) {
+			for (int axis = 0; axis < 3; axis++) {
+				wideNode.bounds[0][axis][i] = INFINITY;
+				wideNode.bounds[1][axis][i] = -INFINITY;
+			}
+			wideNode.child[i] = 0;
+			wideNode.nPrimitives[i] = -1;
+		}
+		for (int i = 0; i < nSlots; i++) {
+			const LinearBVHNode& node = binaryNodes[slots[i]];
+			for (int axis = 0; axis < 3; axis++) {
+				wideNode.bounds[0][axis][i] = float(node.bounds.pMin[axis]);
+				wideNode.bounds[1][axis][i] = float(node.bounds.pMax[axis]);
+			}
+			if (node.nPrimitives > 0) {
+				wideNode.child[i] = node.primitivesOffset;
+				wideNode.nPrimitives[i] = node.nPrimitives;
+			}
+			else {
+				wideNode.child[i] = CollapseNode(binaryNodes, slots[i], depth + 1);
+				wideNode.nPrimitives[i] = 0;
+			}
+		}
+		nodes[myOffset] = wideNode;
+		return myOffset;
+	}
+
+	template <int N>
+	bool WideBVHAccel<N>::Hit(const Ray& ray, HitRecord& rec) const {
+		PrimitiveHit hit;
+		if (!Intersect(ray, hit)) return false;
+		hit.shape->ComputeSurfaceInteraction(ray, hit, rec);
+		return true;
+	}
+
+	template <int N>
+	bool WideBVHAccel<N>::Intersect(const Ray& ray, PrimitiveHit& hit) const {
+		bool hitAnything = false;
+		Ray r = ray;
+		uint64_t visits = 0, tests = 0;
+		if (!nodes.empty()) {
+			WideBVHRay wideRay(r);
+			// ÿڵѹ N ӡһջ MAXBVHDEPTH * (N - 1) + 1
+			struct StackEntry {
+				int index, nPrimitives;
+				float tEntry;
+			};
+			StackEntry stack[MAXBVHDEPTH * N];
+			int toVisitOffset = 0;
+			stack[toVisitOffset++] = { 0, 0, -INFINITY };
+			while (toVisitOffset > 0) {
+				const StackEntry entry = stack[--toVisitOffset];
+				// ѹջ֮ҵ˸Ľ
+				if (entry.tEntry >= r.tMax) continue;
+				if (entry.nPrimitives > 0) {
+					for (int i = 0; i < entry.nPrimitives; i++) {
+						tests++;
+						if (primitives[entry.index + i]->Intersect(r, hit)) {
+							hitAnything = true;
+							r.tMax = hit.t;
+						}
+					}
+					continue;
+				}
+
+				const WideBVHNode<N>& node = nodes[entry.index];
+				visits++;
+				float tEntry[N];
+				int mask = IntersectWideNode<N>(node, wideRay, float(r.tMax), tEntry);
+				// еĺӰԶѹջջ
+				int order[N];
+				int nHits = 0;
+				for (int i = 0; i < N; i++) {
+					if (!(mask & (1 << i))) continue;
+					int j = nHits++;
+					while (j > 0 && tEntry[order[j - 1]] < tEntry[i]) {
+						order[j] = order[j - 1];
+						j--;
+					}
+					order[j] = i;
+				}
+				for (int j = 0; j < nHits; j++) {
+					int i = order[j];
+					stack[toVisitOffset++] = { node.child[i], node.nPrimitives[i], tEntry[i] };
+				}
+			}
+		}
+		for (size_t i = 0; i < unbounded.size(); i++) {
+			tests++;
+			if (unbounded[i]->Intersect(r, hit)) {
+				hitAnything = true;
+				r.tMax = hit.t;
+			}
+		}
+#ifdef BVH_STATS
+		rayCount.fetch_add(1, std::memory_order_relaxed);
+		nodeVisits.fetch_add(visits, std::memory_order_relaxed);
+		primitiveTests.fetch_add(tests, std::memory_order_relaxed);
+#endif // BVH_STATS
+		return hitAnything;
+	}
+
+	template <int N>
+	bool WideBVHAccel<N>::IntersectP(const Ray& ray) const {
+		bool occluded = false;
+		uint64_t visits = 0, tests = 0;
+		if (!nodes.empty()) {
+			WideBVHRay wideRay(ray);
+			// ֻҪҵһ㣬еĺӲֱѹջ
+			struct StackEntry {
+				int index, nPrimitives;
+			};
+			StackEntry stack[MAXBVHDEPTH * N];
+			int toVisitOffset = 0;
+			stack[toVisitOffset++] = { 0, 0 };
+			while (toVisitOffset > 0 && !occluded) {
+				const StackEntry entry = stack[--toVisitOffset];
+				if (entry.nPrimitives > 0) {
+					for (int i = 0; i < entry.nPrimitives && !occluded; i++) {
+						tests++;
+						occluded = primitives[entry.index + i]->IntersectP(ray);
+					}
+					continue;
+				}
+
+				const WideBVHNode<N>& node = nodes[entry.index];
+				visits++;
+				float tEntry[N];
+				int mask = IntersectWideNode<N>(node, wideRay, float(ray.tMax), tEntry);
+				for (int i = 0; i < N; i++) {
+					if (mask & (1 << i)) stack[toVisitOffset++] = { node.child[i], node.nPrimitives[i] };
+				}
+			}
+		}
+		for (size_t i = 0; i < unbounded.size() && !occluded; i++) {
+			tests++;
+			occluded = unbounded[i]->IntersectP(ray);
+		}
+#ifdef BVH_STATS
+		rayCount.fetch_add(1, std::memory_order_relaxed);
+		nodeVisits.fetch_add(visits, std::memory_order_relaxed);
+		primitiveTests.fetch_add(tests, std::memory_order_relaxed);
+#endif // BVH_STATS
+		return occluded;
+	}
+
+	template <int N>
+	bool WideBVHAccel<N>::BoundingBox(Bounds3f& box) const {
+		if (nodes.empty() || !unbounded.empty()) return false;
+		box = bounds;
+		return true;
+	}
+
+	template <int N>
+	void WideBVHAccel<N>::ReportStats() const {
+		std::cout << "BVH" << N << ": " << primitives.size() << " primitives, " << nodes.size() << " nodes collapsed from "
+			<< binaryNodes << " binary nodes, max depth " << maxDepth << ", binary SAH cost " << binarySahCost
+			<< ", build time " << buildTime * 1000 << "ms" << std::endl;
+		if (!unbounded.empty()) {
+			std::cout << "BVH" << N << ": " << unbounded.size() << " unbounded shapes tested linearly" << std::endl;
+		}
+#ifdef BVH_STATS
+		uint64_t rays = rayCount.load();
+		if (rays > 0) {
+			std::cout << "BVH" << N << ": " << rays << " rays, " << Float(nodeVisits.load()) / rays << " nodes visited and "
+				<< Float(primitiveTests.load()) / rays << " primitive tests per ray" << std::endl;
+		}
+#endif // BVH_STATS
+	}
+}
+
+#endif // QZRT_SHAPE_WIDE_BVH_H